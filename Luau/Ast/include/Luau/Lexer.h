@@ -33,6 +33,17 @@ public:
         return t;
     }
 
+    // Pages allocated so far and the bytes they take up, large allocations get a page of their own
+    size_t getPageCount() const
+    {
+        return pageCount;
+    }
+
+    size_t getPageBytes() const
+    {
+        return pageBytes;
+    }
+
 private:
     struct Page
     {
@@ -43,6 +54,8 @@ private:
 
     Page* root;
     size_t offset;
+    size_t pageCount;
+    size_t pageBytes;
 };
 
 struct Lexeme
@@ -163,6 +176,12 @@ public:
     AstName getOrAdd(const char* name);
     AstName get(const char* name) const;
 
+    // Names in the table, the reserved words included
+    size_t size() const
+    {
+        return data.size();
+    }
+
 private:
     struct Entry
     {
@@ -7,6 +7,7 @@
 #include <memory>
 
 #include <stdint.h>
+#include <string.h>
 
 LUAU_FASTFLAG(DebugLuauTimeTracing)
 
@@ -62,6 +63,9 @@ uint32_t createThread(GlobalContext& context, ThreadContext* threadContext);
 void releaseThread(GlobalContext& context, ThreadContext* threadContext);
 void flushEvents(GlobalContext& context, uint32_t threadId, const std::vector<Event>& events, const std::vector<char>& data);
 
+// Opens the file events are flushed to instead of trace.json, has to be called before the first flush
+bool openTraceFile(GlobalContext& context, const char* path);
+
 struct ThreadContext
 {
     ThreadContext()
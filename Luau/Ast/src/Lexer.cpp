@@ -16,6 +16,8 @@ namespace Luau
 Allocator::Allocator()
     : root(static_cast<Page*>(operator new(sizeof(Page))))
     , offset(0)
+    , pageCount(1)
+    , pageBytes(sizeof(Page))
 {
     root->next = nullptr;
 }
@@ -23,9 +25,13 @@ Allocator::Allocator()
 Allocator::Allocator(Allocator&& rhs)
     : root(rhs.root)
     , offset(rhs.offset)
+    , pageCount(rhs.pageCount)
+    , pageBytes(rhs.pageBytes)
 {
     rhs.root = nullptr;
     rhs.offset = 0;
+    rhs.pageCount = 0;
+    rhs.pageBytes = 0;
 }
 
 Allocator::~Allocator()
@@ -61,6 +67,9 @@ void* Allocator::allocate(size_t size)
     size_t pageSize = size > sizeof(root->data) ? size : sizeof(root->data);
     void* pageData = operator new(offsetof(Page, data) + pageSize);
 
+    pageCount++;
+    pageBytes += offsetof(Page, data) + pageSize;
+
     Page* page = static_cast<Page*>(pageData);
 
     page->next = root;
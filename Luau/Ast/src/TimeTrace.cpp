@@ -3,6 +3,7 @@
 
 #include "Luau/StringUtils.h"
 
+#include <algorithm>
 #include <mutex>
 #include <string>
 
@@ -93,7 +94,12 @@ struct GlobalContext
     ~GlobalContext()
     {
         if (traceFile)
+        {
+            // Every event is followed by a comma, so the array is closed with an event that isn't
+            fprintf(traceFile, R"({"name": "process_name", "ph": "M", "pid": 0, "args": {"name": "TimeTrace"}})"
+                               "\n]\n");
             fclose(traceFile);
+        }
     }
 
     std::mutex mutex;
@@ -140,6 +146,41 @@ void releaseThread(GlobalContext& context, ThreadContext* threadContext)
         context.threads.erase(it);
 }
 
+bool openTraceFile(GlobalContext& context, const char* path)
+{
+    std::scoped_lock lock(context.mutex);
+
+    LUAU_ASSERT(!context.traceFile);
+
+    context.traceFile = fopen(path, "w");
+
+    if (!context.traceFile)
+        return false;
+
+    fprintf(context.traceFile, "[\n");
+    return true;
+}
+
+static void appendEscaped(std::string& temp, const char* value)
+{
+    temp += '"';
+
+    for (const char* ch = value; *ch; ch++)
+    {
+        if (*ch == '"' || *ch == '\\')
+        {
+            temp += '\\';
+            temp += *ch;
+        }
+        else if (uint8_t(*ch) < ' ')
+            formatAppend(temp, "\\u%04x", uint8_t(*ch));
+        else
+            temp += *ch;
+    }
+
+    temp += '"';
+}
+
 void flushEvents(GlobalContext& context, uint32_t threadId, const std::vector<Event>& events, const std::vector<char>& data)
 {
     std::scoped_lock lock(context.mutex);
@@ -221,7 +262,7 @@ void flushEvents(GlobalContext& context, uint32_t threadId, const std::vector<Ev
             break;
         case EventType::ArgValue:
             LUAU_ASSERT(unfinishedArgs);
-            formatAppend(temp, R"("%s")", rawData + ev.data.dataPos);
+            appendEscaped(temp, rawData + ev.data.dataPos);
             break;
         }
 
@@ -224,11 +224,23 @@ std::optional<std::string> readFile(const std::string& name)
 
 std::optional<std::string> readStdin()
 {
+    // Read straight into the result in large blocks; unlike fgets this also keeps embedded NUL bytes
+    constexpr size_t blockSize = 1 << 20;
+
     std::string result;
-    char buffer[4096] = {};
+    size_t size = 0;
+
+    while (true)
+    {
+        result.resize(size + blockSize);
+        size_t length = fread(&result[size], 1, blockSize, stdin);
+        size += length;
+
+        if (length < blockSize)
+            break;
+    }
 
-    while (fgets(buffer, sizeof(buffer), stdin) != nullptr)
-        result.append(buffer);
+    result.resize(size);
 
     // If eof was not reached for stdin, then a read error occurred
     if (!feof(stdin))
@@ -425,6 +437,13 @@ static std::string getExtension(const std::string& path)
     return path.substr(dot);
 }
 
+bool hasSourceExtension(const std::string& path)
+{
+    std::string ext = getExtension(path);
+
+    return ext == ".lua" || ext == ".luau";
+}
+
 std::vector<std::string> getSourceFiles(int argc, char** argv)
 {
     std::vector<std::string> files;
@@ -443,9 +462,7 @@ std::vector<std::string> getSourceFiles(int argc, char** argv)
         if (isDirectory(argv[i]))
         {
             traverseDirectory(argv[i], [&](const std::string& name) {
-                std::string ext = getExtension(name);
-
-                if (ext == ".lua" || ext == ".luau")
+                if (hasSourceExtension(name))
                     files.push_back(name);
             });
         }
@@ -24,4 +24,5 @@ std::vector<std::string_view> splitPath(std::string_view path);
 std::string joinPaths(const std::string& lhs, const std::string& rhs);
 std::optional<std::string> getParentPath(const std::string& path);
 
+bool hasSourceExtension(const std::string& path);
 std::vector<std::string> getSourceFiles(int argc, char** argv);
@@ -0,0 +1,466 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+#include "FileUtils.h"
+#include "Luau/TimeTrace.h"
+
+#include "check.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "output.hpp"
+#include "pool.hpp"
+#include "shard.hpp"
+#include "stats.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct BatchFileStats {
+    size_t input_bytes = 0;
+    size_t output_bytes = 0;
+    double ms = 0;
+    // only with heap counting on
+    size_t peak_heap = 0;
+    size_t arena_bytes = 0;
+};
+
+// the heap a file needed and the AST arena it took, for everything done on this thread while it lives
+struct FileMemory {
+    size_t arena_start = stats_enabled ? getThreadStats().allocator_bytes : 0;
+    HeapScope heap;
+
+    void finish(const BatchOptions& batch_options, const BatchFile& file, BatchFileStats& file_stats) {
+        file_stats.peak_heap = heap.end();
+        if (stats_enabled)
+            file_stats.arena_bytes = getThreadStats().allocator_bytes - arena_start;
+        if (batch_options.memory_warning > 0)
+            warnMemoryUse(file.input, file_stats.input_bytes, file_stats.peak_heap, batch_options.memory_warning);
+    }
+};
+
+struct BatchCounters {
+    std::atomic<size_t> written = 0;
+    std::atomic<size_t> unchanged = 0;
+    // only with check
+    std::atomic<size_t> formatted = 0;
+    std::atomic<size_t> not_formatted = 0;
+    std::atomic<size_t> failed = 0;
+};
+
+void warnMemoryUse(const std::string& name, size_t input_bytes, size_t peak_heap, double multiple) {
+    if (input_bytes < memory_warning_min_bytes || peak_heap <= multiple * input_bytes)
+        return;
+
+    fprintf(stderr, "warning: %s (%.1fMB) peaked at %.1fMB of heap, %.1f times its size\n", name.c_str(),
+        input_bytes / 1048576.0, peak_heap / 1048576.0, (double) peak_heap / input_bytes);
+};
+
+// in place, a symlink is written through to the file it points at instead of being replaced by a copy
+std::string resolveInPlacePath(const std::string& path) {
+    struct stat st = {};
+    if (lstat(path.c_str(), &st) != 0 || !S_ISLNK(st.st_mode))
+        return path;
+
+    // a dangling link is left as is, reading it fails anyway
+    char* target = realpath(path.c_str(), nullptr);
+    if (!target)
+        return path;
+
+    std::string resolved = target;
+    free(target);
+    return resolved;
+};
+
+std::vector<BatchFile> collectBatchFiles(const BatchOptions& batch_options) {
+    std::vector<BatchFile> files;
+
+    for (const std::string& input : batch_options.inputs) {
+        if (isDirectory(input)) {
+            traverseDirectory(input, [&](const std::string& name) {
+                if (!hasSourceExtension(name))
+                    return;
+
+                std::string relative = relativePath(input, name);
+
+                if (batch_options.in_place)
+                    files.push_back({ name, resolveInPlacePath(name), relative });
+                else
+                    files.push_back({ name, joinPaths(batch_options.out_dir, relative), relative });
+            });
+        } else if (batch_options.in_place)
+            files.push_back({ input, resolveInPlacePath(input), normalizePath(input) });
+        else {
+            std::vector<std::string_view> components = splitPath(input);
+            files.push_back({ input, joinPaths(batch_options.out_dir, std::string(components.back())), normalizePath(input) });
+        }
+    }
+
+    return files;
+};
+
+bool checkBatchOutputs(const std::vector<BatchFile>& files) {
+    // existing paths are compared by what they resolve to, so links and different spellings of one file match
+    std::unordered_map<std::string, size_t> destinations;
+    bool ok = true;
+
+    for (size_t index = 0; index < files.size(); index++) {
+        std::string key;
+        if (char* resolved = realpath(files[index].output.c_str(), nullptr)) {
+            key = resolved;
+            free(resolved);
+        } else
+            key = normalizePath(files[index].output);
+
+        auto [it, inserted] = destinations.try_emplace(key, index);
+        if (!inserted) {
+            fprintf(stderr, "Error: %s and %s would both be written to %s\n", files[it->second].input.c_str(),
+                files[index].input.c_str(), files[index].output.c_str());
+            ok = false;
+        }
+    }
+
+    return ok;
+};
+
+void processCheck(const BatchFile& file, const HandleOptions& options, const std::string& source, BatchCounters& counters) {
+    std::string error;
+    CheckResult check_result;
+    if (!checkSource(source, options, check_result, error)) {
+        fprintf(stderr, "Parse errors were encountered in %s\n%s\n", file.input.c_str(), error.c_str());
+        counters.failed++;
+    } else if (check_result.formatted)
+        counters.formatted++;
+    else {
+        fprintf(stderr, "%s:%u:%u: not formatted\n", file.input.c_str(), check_result.line, check_result.column);
+        counters.not_formatted++;
+    }
+};
+
+void processBatchFile(const BatchOptions& batch_options, const HandleOptions& options, const BatchFile& file, BatchFileStats& file_stats, BatchCounters& counters) {
+    LUAU_TIMETRACE_SCOPE("file", "batch");
+    LUAU_TIMETRACE_ARGUMENT("file", file.input.c_str());
+
+    std::optional<std::string> source;
+    {
+        LUAU_TIMETRACE_SCOPE("read", "io");
+        StatsTimer timer(StatsPhase::Read);
+        source = readFile(file.input);
+    };
+
+    if (!source) {
+        fprintf(stderr, "failed to read file %s\n", file.input.c_str());
+        counters.failed++;
+        return;
+    }
+
+    file_stats.input_bytes = source->size();
+    std::string error;
+
+    if (batch_options.check)
+        return processCheck(file, options, *source, counters);
+
+    std::string result;
+    if (!handleSource(*source, options, result, error)) {
+        fprintf(stderr, "Parse errors were encountered in %s\n%s\n", file.input.c_str(), error.c_str());
+        counters.failed++;
+        return;
+    }
+
+    file_stats.output_bytes = result.size();
+    WriteResult write_result;
+    {
+        StatsTimer timer(StatsPhase::Write);
+        write_result = writeOutput(file.output, result);
+    };
+
+    switch (write_result) {
+        case WriteResult::Written:
+            counters.written++;
+            break;
+        case WriteResult::Unchanged:
+            counters.unchanged++;
+            break;
+        case WriteResult::Failed:
+            fprintf(stderr, "failed to write file %s\n", file.output.c_str());
+            counters.failed++;
+            break;
+    }
+};
+
+// the async_io version of the pool loop in runBatch. at most max_pending files are between their
+// read and their write at once, so the read-ahead doesn't pull the whole tree into memory
+void processBatchFilesAsync(const BatchOptions& batch_options, const HandleOptions& options, const std::vector<BatchFile>& files, std::vector<BatchFileStats>& stats, BatchCounters& counters) {
+    WorkerPool pool(batch_options.jobs);
+    std::unique_ptr<BatchIo> io = createBatchIo(true, batch_options.io_threads);
+
+    std::mutex mutex;
+    std::condition_variable slot_available;
+    size_t pending = 0;
+    size_t max_pending = pool.size() * 4 + 16;
+
+    auto release = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending--;
+        slot_available.notify_one();
+    };
+
+    // existing is what the output currently holds, null when it doesn't exist
+    auto format = [&](size_t index, std::shared_ptr<std::string> source, std::shared_ptr<std::string> existing) {
+        const BatchFile& file = files[index];
+        Clock::time_point file_start = Clock::now();
+
+        LUAU_TIMETRACE_SCOPE("file", "batch");
+        LUAU_TIMETRACE_ARGUMENT("file", file.input.c_str());
+
+        std::string result;
+        std::string error;
+        FileMemory memory;
+        bool ok = handleSource(*source, options, result, error);
+        stats[index].ms = std::chrono::duration<double, std::milli>(Clock::now() - file_start).count();
+        memory.finish(batch_options, file, stats[index]);
+
+        if (!ok) {
+            fprintf(stderr, "Parse errors were encountered in %s\n%s\n", file.input.c_str(), error.c_str());
+            counters.failed++;
+            return release();
+        }
+
+        stats[index].output_bytes = result.size();
+        if (existing && *existing == result) {
+            counters.unchanged++;
+            return release();
+        }
+
+        io->write(file.output, std::move(result), [&, index](bool written) {
+            if (written)
+                counters.written++;
+            else {
+                fprintf(stderr, "failed to write file %s\n", files[index].output.c_str());
+                counters.failed++;
+            }
+            release();
+        });
+    };
+
+    for (size_t index = 0; index < files.size(); index++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slot_available.wait(lock, [&] { return pending < max_pending; });
+            pending++;
+        }
+
+        io->read(files[index].input, [&, index](std::optional<std::string> contents) {
+            const BatchFile& file = files[index];
+            if (!contents) {
+                fprintf(stderr, "failed to read file %s\n", file.input.c_str());
+                counters.failed++;
+                return release();
+            }
+
+            stats[index].input_bytes = contents->size();
+            std::shared_ptr<std::string> source = std::make_shared<std::string>(std::move(*contents));
+
+            if (batch_options.check) {
+                pool.push([&, index, source] {
+                    Clock::time_point file_start = Clock::now();
+                    LUAU_TIMETRACE_SCOPE("file", "batch");
+                    LUAU_TIMETRACE_ARGUMENT("file", files[index].input.c_str());
+                    FileMemory memory;
+                    processCheck(files[index], options, *source, counters);
+                    stats[index].ms = std::chrono::duration<double, std::milli>(Clock::now() - file_start).count();
+                    memory.finish(batch_options, files[index], stats[index]);
+                    release();
+                });
+            } else if (batch_options.in_place) {
+                pool.push([&, index, source] {
+                    format(index, source, source);
+                });
+            } else {
+                // the current output is read as well, so unchanged files are never rewritten
+                io->read(file.output, [&, index, source](std::optional<std::string> contents) {
+                    std::shared_ptr<std::string> existing;
+                    if (contents)
+                        existing = std::make_shared<std::string>(std::move(*contents));
+
+                    pool.push([&, index, source, existing] {
+                        format(index, source, existing);
+                    });
+                });
+            }
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    slot_available.wait(lock, [&] { return pending == 0; });
+};
+
+// the first stats_top_files of files ordered by first, as "name":[{path, bytes, output_bytes, ms}] (and their
+// memory with heap counting on). check formats nothing, so it has no output_bytes
+constexpr size_t stats_top_files = 10;
+
+template<typename Compare>
+void appendStatsFiles(std::string& json, const char* name, bool check, const std::vector<BatchFile>& files, const std::vector<BatchFileStats>& stats, Compare first) {
+    std::vector<size_t> order(files.size());
+    for (size_t index = 0; index < order.size(); index++)
+        order[index] = index;
+
+    size_t count = std::min(order.size(), stats_top_files);
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](size_t a, size_t b) {
+        return first(stats[a], stats[b]);
+    });
+
+    json.append(",\"").append(name).append("\":[");
+    for (size_t rank = 0; rank < count; rank++) {
+        const BatchFileStats& file_stats = stats[order[rank]];
+        char numbers[192];
+        json.append(rank == 0 ? "{\"path\":" : ",{\"path\":");
+        appendJsonString(json, files[order[rank]].relative);
+        snprintf(numbers, sizeof(numbers), ",\"bytes\":%zu", file_stats.input_bytes);
+        json.append(numbers);
+        if (!check) {
+            snprintf(numbers, sizeof(numbers), ",\"output_bytes\":%zu", file_stats.output_bytes);
+            json.append(numbers);
+        }
+        snprintf(numbers, sizeof(numbers), ",\"ms\":%.3f", file_stats.ms);
+        json.append(numbers);
+
+        if (heap_counting) {
+            snprintf(numbers, sizeof(numbers), ",\"peak_heap\":%zu,\"arena_bytes\":%zu", file_stats.peak_heap, file_stats.arena_bytes);
+            json.append(numbers);
+        }
+        json += '}';
+    }
+    json += ']';
+};
+
+void writeBatchReports(const BatchOptions& batch_options, const std::vector<BatchFile>& files, const std::vector<BatchFileStats>& stats, const BatchCounters& counters, double wall_ms) {
+    if (!batch_options.timings_path.empty()) {
+        std::string timings;
+        for (size_t index = 0; index < files.size(); index++) {
+            char numbers[96];
+            snprintf(numbers, sizeof(numbers), ",\"bytes\":%zu,\"ms\":%.3f}\n", stats[index].input_bytes, stats[index].ms);
+            timings.append("{\"path\":");
+            appendJsonString(timings, files[index].relative);
+            timings.append(numbers);
+        }
+
+        if (writeOutput(batch_options.timings_path, timings) == WriteResult::Failed)
+            fprintf(stderr, "failed to write file %s\n", batch_options.timings_path.c_str());
+    }
+
+    if (!batch_options.summary_path.empty()) {
+        size_t input_bytes = 0;
+        size_t output_bytes = 0;
+        double cpu_ms = 0;
+        for (const BatchFileStats& file_stats : stats) {
+            input_bytes += file_stats.input_bytes;
+            output_bytes += file_stats.output_bytes;
+            cpu_ms += file_stats.ms;
+        }
+
+        // check formats nothing, there's no output to count
+        char output_field[48] = "";
+        if (!batch_options.check)
+            snprintf(output_field, sizeof(output_field), ",\"output_bytes\":%zu", output_bytes);
+
+        char summary[512];
+        snprintf(summary, sizeof(summary),
+            "{\"shard\":\"%u/%u\",\"files\":%zu,\"%s\":%zu,\"%s\":%zu,\"failed\":%zu,"
+            "\"input_bytes\":%zu%s,\"wall_ms\":%.3f,\"cpu_ms\":%.3f}\n",
+            batch_options.shard_index, batch_options.shard_count, files.size(),
+            batch_options.check ? "not_formatted" : "written", batch_options.check ? counters.not_formatted.load() : counters.written.load(),
+            batch_options.check ? "formatted" : "unchanged", batch_options.check ? counters.formatted.load() : counters.unchanged.load(),
+            counters.failed.load(), input_bytes, output_field, wall_ms, cpu_ms);
+
+        if (writeOutput(batch_options.summary_path, summary) == WriteResult::Failed)
+            fprintf(stderr, "failed to write file %s\n", batch_options.summary_path.c_str());
+    }
+
+    if (batch_options.stats) {
+        char header[128];
+        snprintf(header, sizeof(header), "{\"files\":%zu,\"wall_ms\":%.3f,", files.size(), wall_ms);
+        std::string json = header;
+        appendStatsJson(json);
+
+        appendStatsFiles(json, "largest", batch_options.check, files, stats, [](const BatchFileStats& a, const BatchFileStats& b) {
+            return a.input_bytes > b.input_bytes;
+        });
+        appendStatsFiles(json, "slowest", batch_options.check, files, stats, [](const BatchFileStats& a, const BatchFileStats& b) {
+            return a.ms > b.ms;
+        });
+        if (heap_counting) {
+            appendStatsFiles(json, "most_heap", batch_options.check, files, stats, [](const BatchFileStats& a, const BatchFileStats& b) {
+                return a.peak_heap > b.peak_heap;
+            });
+        }
+
+        json.append("}\n");
+        fwrite(json.data(), 1, json.size(), stderr);
+    }
+};
+
+int runBatch(const BatchOptions& batch_options, const HandleOptions& options) {
+    Clock::time_point start = Clock::now();
+
+    std::vector<BatchFile> files = collectBatchFiles(batch_options);
+    if (!batch_options.check && !checkBatchOutputs(files))
+        return 1;
+
+    if (batch_options.shard_count > 1) {
+        ShardSpec spec;
+        spec.index = batch_options.shard_index;
+        spec.count = batch_options.shard_count;
+        if (!selectShard(files, spec, batch_options.shard_manifest))
+            return 1;
+    }
+
+    // every job only touches its own entry
+    std::vector<BatchFileStats> stats(files.size());
+    BatchCounters counters;
+
+    if (batch_options.async_io)
+        processBatchFilesAsync(batch_options, options, files, stats, counters);
+    else {
+        WorkerPool pool(batch_options.jobs);
+
+        for (size_t index = 0; index < files.size(); index++) {
+            pool.push([&, index] {
+                Clock::time_point file_start = Clock::now();
+                FileMemory memory;
+                processBatchFile(batch_options, options, files[index], stats[index], counters);
+                stats[index].ms = std::chrono::duration<double, std::milli>(Clock::now() - file_start).count();
+                memory.finish(batch_options, files[index], stats[index]);
+            });
+        }
+
+        pool.wait();
+    }
+
+    double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    writeBatchReports(batch_options, files, stats, counters, wall_ms);
+
+    size_t failed = counters.failed;
+
+    if (batch_options.check) {
+        size_t not_formatted = counters.not_formatted;
+        fprintf(stderr, "%zu files: %zu formatted, %zu not formatted, %zu failed\n", files.size(), counters.formatted.load(), not_formatted, failed);
+        return failed > 0 || not_formatted > 0 ? 1 : 0;
+    }
+
+    size_t written = counters.written;
+    size_t unchanged = counters.unchanged;
+
+    fprintf(stderr, "%zu files: %zu written, %zu unchanged, %zu failed\n", files.size(), written, unchanged, failed);
+
+    return failed > 0 ? 1 : 0;
+};
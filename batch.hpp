@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "handle.hpp"
+
+struct BatchFile {
+    std::string input;
+    std::string output;
+    // what sharding and the timings know the file as, normalized so ./a.lua and a.lua are the same file
+    std::string relative;
+};
+
+struct BatchOptions {
+    std::vector<std::string> inputs; // files and directories
+    std::string out_dir;
+    bool in_place = false;
+    // only report which files aren't formatted, nothing is written
+    bool check = false;
+    unsigned jobs = 0;
+    // queue reads ahead and writes behind the workers through io_uring (or io_threads blocking threads)
+    bool async_io = false;
+    unsigned io_threads = 4;
+
+    // only process shard_index out of shard_count (1-based)
+    unsigned shard_index = 1;
+    unsigned shard_count = 1;
+    std::string shard_manifest; // timings of a previous run to size-balance the shards with
+    std::string summary_path; // one JSON line with counts, bytes and timings of this run
+    std::string timings_path; // one JSON line per file, usable as a shard manifest
+    // prints the engine counters (stats.hpp) and the largest and slowest files as JSON to stderr
+    bool stats = false;
+    // warns about files whose peak heap is more than this many times their size, 0 never does
+    double memory_warning = 0;
+};
+
+// expands directories into their .lua/.luau files and works out where each one is written to
+// with in_place, symlinks are written through to their target
+std::vector<BatchFile> collectBatchFiles(const BatchOptions& batch_options);
+// reports every pair of files that would be written to the same path, returns false if there are any
+bool checkBatchOutputs(const std::vector<BatchFile>& files);
+
+// files smaller than this are dominated by fixed costs, they are never warned about
+constexpr size_t memory_warning_min_bytes = 64 * 1024;
+// the --memory-warning message, when peak_heap is over multiple times input_bytes
+void warnMemoryUse(const std::string& name, size_t input_bytes, size_t peak_heap, double multiple);
+
+// formats every input on a worker pool, writing to out_dir or back over the inputs
+// returns non-zero when a file failed (or, with check, isn't formatted)
+int runBatch(const BatchOptions& batch_options, const HandleOptions& options);
@@ -1,6 +1,8 @@
 #include "beautify.hpp"
 #include "Luau/Ast.h"
+#include "cache.hpp"
 #include "solve.hpp"
+#include "stats.hpp"
 
 #include <cstring>
 #include <string>
@@ -128,14 +130,13 @@ std::string beautify(AstLocal* local) {
     return local->name.value;
 };
 
-int indent;
-bool skip_first_indent;
-int skip_count;
-bool b_is_root; // aka is first beautify call
-bool b_dont_append_do;
-bool b_ignore_indent;
-bool b_dont_append_end;
-bool b_inside_group;
+thread_local int indent;
+thread_local bool skip_first_indent;
+thread_local bool b_is_root; // aka is first beautify call
+thread_local bool b_dont_append_do;
+thread_local bool b_ignore_indent;
+thread_local bool b_dont_append_end;
+thread_local bool b_inside_group;
 
 std::string getIndents(int offset) {
     std::string result = "";
@@ -146,6 +147,7 @@ std::string getIndents(int offset) {
     return result;
 };
 
+// shared by every thread, unlike the rest of the printer state
 InjectCallback* inject_callback;
 void* inject_callback_data;
 
@@ -158,194 +160,79 @@ void dontAppendDo() {
     b_dont_append_do = true;
 };
 
-bool b_ignore_types;
-bool replace_if_expressions;
-bool extra1;
-
-void replaceIfElse(std::string* out, AstExprIfElse* expr, std::string var, bool use_local = false);
-
-/*
-    obfuscators commonly employ techniques to make control flow hard to read
-    one of these is a for loop with a break at the end and no continue
-    example:
-    for i = 1, 10 do
-        // code here
-        break
-    end
-    this can be simpilfied to just
-    // code here
-
-    to detect these loops we take advantage of AstVisitors
-*/
-class DummyForLoopVisitor : public AstVisitor {
-    bool first_run = true;
-
-    public:
-    const char* var = nullptr;
-    bool success = false;
-    DummyForLoopVisitor() {}
-
-    bool visit(AstExprLocal* expr_local) override {
-        if (strcmp(var, expr_local->local->name.value) == 0)
-            success = false;
-        return true;
-    }
-    bool visit(AstStatContinue* stat_continue) override {
-        success = false;
-        return true;
-    }
-    bool visit(AstStatFor* stat_for) override {
-        if (first_run) {
-            if (stat_for->body->body.size > 0 && stat_for->body->body.data[stat_for->body->body.size - 1]->is<AstStatBreak>())
-                success = true;
-        }
-        first_run = false;
-        return true;
-    }
-};
-
-struct StatementExtractionResult {
-    const char* counter_name = nullptr;
-    // AstArray<AstStat*> list; // copy on a TempVector
+thread_local OutputSink* output_sink;
+thread_local void* output_sink_data;
 
-    struct Branch {
-        bool is_end = false;
-        double target;
-        double condition;
-    };
-    std::vector<Branch> branch_list;
+void setupOutputSink(OutputSink* sink, void* data) {
+    output_sink = sink;
+    output_sink_data = data;
 };
 
-bool testBinaryWithVariable(AstExprBinary* expr, const char* variable, double num) {
-    bool num_is_left = false;
-
-    // AstExpr* variable_expr = nullptr;
-    AstExprConstantNumber* num_expr = nullptr;
-
-    if (AstExprLocal* left_local = getRootExpr(expr->left)->as<AstExprLocal>()) {
-        if (strcmp(variable, left_local->local->name.value) != 0)
-            return false;
-        // else
-        //     variable_expr = left_local;
-    } else if (AstExprLocal* right_local = getRootExpr(expr->right)->as<AstExprLocal>()) {
-        if (strcmp(variable, right_local->local->name.value) != 0)
-            return false;
-        // else
-        //     variable_expr = right_local;
-    }
-
-    if (AstExprConstantNumber* left_number = getRootExpr(expr->left)->as<AstExprConstantNumber>()) {
-        num_expr = left_number;
-        num_is_left = true;
-    } else if (AstExprConstantNumber* right_number = getRootExpr(expr->left)->as<AstExprConstantNumber>()) {
-        num_expr = right_number;
-    }
-
-    double expr_num = num_expr->value;
-
-    switch (expr->op) {
-        case AstExprBinary::CompareNe: {
-            return num != expr_num;
-        }
-        case AstExprBinary::CompareEq: {
-            return num == expr_num;
-        }
-        case AstExprBinary::CompareLt: {
-            break;
-        }
-        case AstExprBinary::CompareLe: {
-            break;
-        }
-        case AstExprBinary::CompareGt: {
-            break;
-        }
-        case AstExprBinary::CompareGe: {
-            break;
-        }
-        default:
-            break;
-    }
-
-    return false;
-}
-
-void handleStatementExtractionIf(AstStatIf* stat, StatementExtractionResult& result, double num) {
-    auto then_body = stat->thenbody->body;
-
-    AstStat* else_body = stat->elsebody;
-    if (else_body) {
-        if (AstStatIf* inner = else_body->as<AstStatIf>())
-            handleStatementExtractionIf(inner, result, num);
-    }
-
-    if (then_body.size < 1)
-        return;
-
-    if (then_body.size == 1)
-        if (AstStatIf* inner = then_body.data[0]->as<AstStatIf>())
-            return handleStatementExtractionIf(inner, result, num);
-
-    AstExprBinary* condition = getRootExpr(stat->condition)->as<AstExprBinary>();
-    if (!condition)
-        return;
+bool emitOutput(std::string& chunk) {
+    if (!output_sink)
+        return true;
 
-    StatementExtractionResult::Branch branch;
-    if (testBinaryWithVariable(condition, result.counter_name, num)) {
-        branch.condition = num;
-        // branch.target = ;
-    }
+    countStats(output_bytes, chunk.size());
+    bool keep_going = output_sink(chunk, output_sink_data);
+    chunk.clear();
+    return keep_going;
+};
 
-    bool is_end = false;
-    AstStat* last_stat = then_body.data[then_body.size - 1];
-    if (last_stat->is<AstStatBreak>())
-        is_end = true;
+thread_local bool b_ignore_types;
 
-    branch.is_end = is_end;
+thread_local bool from_stat_expr = false;
 
-    result.branch_list.push_back(branch);
-}
+// the printer globals a subtree's text depends on and leaves behind, indent, from_stat_expr and b_dont_append_do.
+// b_ignore_types, nosolve and the solve state are in the seed of prepareIncremental. skip_first_indent,
+// b_ignore_indent, b_dont_append_end, b_is_root and inject_callback aren't covered, nothing is cached while they're
+// set. b_inside_group is never read. any new global has to go in one of those
+uint64_t getPrinterState() {
+    return ((uint64_t) indent << 2) | ((uint64_t) from_stat_expr << 1) | (uint64_t) b_dont_append_do;
+};
 
-bool attemptStatementExtraction(AstStatBlock* block) {
-    auto block_body = block->body;
-    if (block_body.size < 2) {
-        return false;
-    }
+void setPrinterState(uint64_t state) {
+    indent = (int) (state >> 2);
+    from_stat_expr = state & 2;
+    b_dont_append_do = state & 1;
+};
 
-    const char* counter_name = nullptr;
-    double counter_initial;
-
-    AstStat* first_stat = block_body.data[0];
-    if (AstStatLocal* first_stat = first_stat->as<AstStatLocal>()) {
-        auto vars = first_stat->vars;
-        auto values = first_stat->values;
-        if (values.size > 0)
-            if (AstExprConstantNumber* expr_number = getRootExpr(values.data[0])->as<AstExprConstantNumber>()) {
-                counter_name = vars.data[0]->name.value;
-                counter_initial = expr_number->value;
-            }
-    }
+// the cached text of a subtree is only valid when it is printed with the same state it was cached with, and the
+// locals it reads are bound to the same things
+std::optional<IncrementalKey> getIncrementalKey(AstNode* node) {
+    if (!isIncremental() || inject_callback || skip_first_indent || b_ignore_indent || b_dont_append_end || b_is_root)
+        return std::nullopt;
 
-    if (counter_name == nullptr)
-        return false;
+    std::optional<uint64_t> bindings = getBindingsDigest(node);
+    if (!bindings)
+        return std::nullopt;
+    return getStructuralKey(node, getPrinterState(), *bindings);
+};
 
-    StatementExtractionResult result;
-    result.counter_name = counter_name;
+// appends the text cached under key, or what print returns, caching it
+template <typename Print>
+void appendIncremental(std::string& result, const std::optional<IncrementalKey>& key, Print print) {
+    uint64_t state_after;
+    if (!key)
+        result.append(print());
+    else if (lookupIncremental(*key, result, state_after))
+        setPrinterState(state_after);
+    else {
+        std::string text = print();
+        storeIncremental(*key, text, getPrinterState());
+        result.append(text);
+    };
+};
 
-    AstStat* second_stat = block_body.data[1];
-    if (AstStatWhile* second_stat = second_stat->as<AstStatWhile>()) {
-        auto second_body = second_stat->body->body;
-        if (second_body.size > 0)
-            if (AstStatIf* third_stat = second_body.data[0]->as<AstStatIf>()) {
-                handleStatementExtractionIf(third_stat, result, counter_initial);
-            }
-    }
+std::string beautify(AstNode* node);
 
-    printf("count: %zu\n", result.branch_list.size());
+// a call or an index that folds is printed as a constant, which can't be indexed or called without parentheses
+std::string beautifyPrefix(AstExpr* expr) {
+    if ((expr->is<AstExprCall>() || expr->is<AstExprIndexExpr>()) && isSolvable(expr))
+        return "(" + beautify(expr) + ")";
 
-    return false;
-}
+    return beautify(expr);
+};
 
-bool from_stat_expr = false;
 std::string beautify(AstNode* node) {
     std::string result = "";
 
@@ -392,21 +279,28 @@ std::string beautify(AstNode* node) {
             if (isSolvable(expr_call, from_stat_expr)) {
                 appendSolve(expr_call, beautify);
             } else {
-                result = beautify(expr_call->func);
+                result = beautifyPrefix(expr_call->func);
                 tuple(expr_call->args, AstExpr);
             };
         } else if (AstExprIndexName* expr_index_name = expr->as<AstExprIndexName>()) {
-            result = beautify(expr_index_name->expr);
+            result = beautifyPrefix(expr_index_name->expr);
             result.append(std::string{expr_index_name->op});
             result.append(expr_index_name->index.value);
         } else if (AstExprIndexExpr* expr_index_expr = expr->as<AstExprIndexExpr>()) {
-            result = beautify(expr_index_expr->expr);
-            result.append("[");
-            result.append(beautify(expr_index_expr->index));
-            result.append("]");
+            if (isSolvable(expr_index_expr)) {
+                appendSolve(expr_index_expr, beautify);
+            } else {
+                result = beautifyPrefix(expr_index_expr->expr);
+                result.append("[");
+                result.append(beautify(expr_index_expr->index));
+                result.append("]");
+            };
         } else if (AstExprFunction* expr_function = expr->as<AstExprFunction>()) {
-            result = "function";
-            beautifyFunction(expr_function);
+            appendIncremental(result, getIncrementalKey(expr_function), [&] {
+                std::string result = "function";
+                beautifyFunction(expr_function);
+                return result;
+            });
         } else if (AstExprTable* expr_table = expr->as<AstExprTable>()) {
             size_t size = expr_table->items.size;
             if (size > 0) {
@@ -497,9 +391,7 @@ std::string beautify(AstNode* node) {
         from_stat_expr = false;
     } else if (AstStat* stat = node->asStat()) {
         Injection injection = inject_callback ? inject_callback(stat, b_is_root, inject_callback_data) : INJECTION_NONE;
-        bool skip = skip_count == 0 || injection.skip;
-
-        if (skip_count >= 0) skip_count--;
+        bool skip = injection.skip;
 
         if (skip || injection.replace) {
             if (b_is_root)
@@ -518,6 +410,7 @@ std::string beautify(AstNode* node) {
 
         if (AstStatBlock* stat2 = stat->as<AstStatBlock>()) {
             bool append_do = stat2->hasEnd && !b_dont_append_do;
+            bool is_root_block = b_is_root;
             if (b_is_root) {
                 append_do = false;
                 b_is_root = false;
@@ -531,8 +424,17 @@ std::string beautify(AstNode* node) {
             b_dont_append_do = false;
 
             for (AstStat* child : stat2->body) {
-                result.append(beautify(child));
+                std::optional<IncrementalKey> cache_key;
+                if (is_root_block || child->is<AstStatFunction>() || child->is<AstStatLocalFunction>())
+                    cache_key = getIncrementalKey(child);
+
+                appendIncremental(result, cache_key, [&] {
+                    return beautify(child);
+                });
                 result.append("\n");
+
+                if (is_root_block && !emitOutput(result))
+                    break;
             };
 
             if (append_do) {
@@ -549,47 +451,9 @@ std::string beautify(AstNode* node) {
             result.append(beautify(stat_if->condition));
             result.append(" then\n");
 
-            AstStatIf* if_break_simplify = nullptr;
-            if (extra1 && stat_if->thenbody->body.size > 1) {
-                if (AstStatIf* second_stat_if = stat_if->thenbody->body.data[0]->as<AstStatIf>()) {
-                    if (!second_stat_if->elsebody && second_stat_if->thenbody->body.size > 0 && second_stat_if->thenbody->body.data[second_stat_if->thenbody->body.size - 1]->is<AstStatBreak>()) {
-                        second_stat_if->thenbody->body.size--; // this is probably a memory violation idrk
-
-                        if_break_simplify = second_stat_if;
-                    }
-                }
-            }
-
             indent++;
-            if (if_break_simplify) {
-                addIndents;
-
-                result.append("if ")
-                    .append(beautify(if_break_simplify->condition))
-                    .append(" then\n");
-
-                indent++;
-                b_dont_append_do = true;
-                result.append(beautify(if_break_simplify->thenbody));
-                indent--;
-
-                addIndents;
-
-                result.append("else");
-
-                indent++;
-                b_dont_append_do = true;
-                skip_count = 1;
-                result.append(beautify(stat_if->thenbody));
-                indent--;
-
-                addIndents;
-
-                result.append("end;");
-            } else {
-                b_dont_append_do = true;
-                result.append(beautify(stat_if->thenbody));
-            }
+            b_dont_append_do = true;
+            result.append(beautify(stat_if->thenbody));
             indent--;
 
             if (stat_if->elsebody) {
@@ -662,68 +526,36 @@ std::string beautify(AstNode* node) {
             result.append(beautify(stat_expr->expr));
             result.append(";");
         } else if (AstStatLocal* stat_local = stat->as<AstStatLocal>()) {
-            bool has_values = stat_local->values.size > 0;
-            bool all_values_are_ifelse_exprs = has_values;
-            if (has_values)
-                for (AstExpr* expr : stat_local->values)
-                    if (!expr->is<AstExprIfElse>()) {
-                        all_values_are_ifelse_exprs = false;
-                        break;
-                    };
-
-            if (replace_if_expressions && all_values_are_ifelse_exprs) {
-                AstExprIfElse** expr_if_else = reinterpret_cast<AstExprIfElse**>(stat_local->values.data);
-                for (int index = 0; index < stat_local->values.size; index++) {
-                    replaceIfElse(&result, (*expr_if_else), beautify(stat_local->vars.data[index]), true);
-
-                    if (index == stat_local->values.size - 1)
-                        result.erase(result.length() - 1, 1);
-                    expr_if_else++;
-                };
-            } else {
-                addIndents;
-                result.append("local ");
-                astlist(stat_local->vars, AstLocal);
-                if (has_values) {
-                    result.append(" = ");
-                    astlist2(stat_local->values, AstExpr);
-                };
-                result.append(";");
+            addIndents;
+            result.append("local ");
+            astlist(stat_local->vars, AstLocal);
+            if (stat_local->values.size > 0) {
+                result.append(" = ");
+                astlist2(stat_local->values, AstExpr);
             };
+            result.append(";");
         } else if (AstStatFor* stat_for = stat->as<AstStatFor>()) {
-            DummyForLoopVisitor* visitor = new DummyForLoopVisitor();
-            visitor->var = stat_for->var->name.value;
-
-            if (extra1)
-                stat_for->visit(visitor);
-
-            if (visitor->success) {
-                b_dont_append_do = true;
-                stat_for->body->body.size--; // this is probably a memory violation idrk
-                result.append(beautify(stat_for->body));
-            } else {
-                addIndents;
-                result.append("for ");
-                result.append(beautify(stat_for->var));
-                result.append(" = ");
-                result.append(beautify(stat_for->from));
+            addIndents;
+            result.append("for ");
+            result.append(beautify(stat_for->var));
+            result.append(" = ");
+            result.append(beautify(stat_for->from));
+            result.append(", ");
+            result.append(beautify(stat_for->to));
+            if (stat_for->step) {
                 result.append(", ");
-                result.append(beautify(stat_for->to));
-                if (stat_for->step) {
-                    result.append(", ");
-                    result.append(beautify(stat_for->step));
-                };
+                result.append(beautify(stat_for->step));
+            };
 
-                result.append(" do\n");
+            result.append(" do\n");
 
-                indent++;
-                b_dont_append_do = true;
-                result.append(beautify(stat_for->body));
-                indent--;
+            indent++;
+            b_dont_append_do = true;
+            result.append(beautify(stat_for->body));
+            indent--;
 
-                optionalNewline;
-                result.append("end;");
-            };
+            optionalNewline;
+            result.append("end;");
         } else if (AstStatForIn* stat_for_in = stat->as<AstStatForIn>()) {
             addIndents;
             result.append("for ");
@@ -740,33 +572,13 @@ std::string beautify(AstNode* node) {
             optionalNewline;
             result.append("end;");
         } else if (AstStatAssign* stat_assign = stat->as<AstStatAssign>()) {
-            bool has_values = stat_assign->values.size > 0;
-            bool all_values_are_ifelse_exprs = has_values;
-            if (has_values)
-                for (AstExpr* expr : stat_assign->values)
-                    if (!expr->is<AstExprIfElse>()) {
-                        all_values_are_ifelse_exprs = false;
-                        break;
-                    };
-
-            if (replace_if_expressions && all_values_are_ifelse_exprs) {
-                AstExprIfElse** expr_if_else = reinterpret_cast<AstExprIfElse**>(stat_assign->values.data);
-                for (int index = 0; index < stat_assign->values.size; index++) {
-                    replaceIfElse(&result, (*expr_if_else), beautify(stat_assign->vars.data[index]));
-
-                    if (index == stat_assign->values.size - 1)
-                        result.erase(result.length() - 1, 1);
-                    expr_if_else++;
-                };
-            } else {
-                addIndents;
-                astlist(stat_assign->vars, AstExpr);
-                if (has_values) {
-                    result.append(" = ");
-                    astlist2(stat_assign->values, AstExpr);
-                };
-                result.append(";");
+            addIndents;
+            astlist(stat_assign->vars, AstExpr);
+            if (stat_assign->values.size > 0) {
+                result.append(" = ");
+                astlist2(stat_assign->values, AstExpr);
             };
+            result.append(";");
         } else if (AstStatCompoundAssign* stat_compound_assign = stat->as<AstStatCompoundAssign>()) {
             addIndents;
             result.append(beautify(stat_compound_assign->var));
@@ -821,57 +633,29 @@ std::string beautify(AstNode* node) {
     return result;
 };
 
-void replaceIfElse(std::string* out, AstExprIfElse* expr, std::string var, bool use_local) {
-    std::string result = *out;
-    addIndents;
-    if (use_local) {
-        result.append("local ");
-        result.append(var);
-        result.append(";\n");
-        addIndents;
-    };
-
-    result.append("if ");
-    result.append(beautify(expr->condition));
-    result.append(" then\n");
-
-    indent++;
-    if (getRootExpr(expr->trueExpr)->is<AstExprIfElse>())
-        replaceIfElse(&result, getRootExpr(expr->trueExpr)->as<AstExprIfElse>(), var);
-    else {
-        addIndents;
-        result.append(var);
-        result.append(" = ");
-        result.append(beautify(expr->trueExpr));
-        result.append(";\n");
-    };
-    indent--;
-
-    addIndents;
-    result.append("else\n");
-    indent++;
-    if (getRootExpr(expr->falseExpr)->is<AstExprIfElse>())
-        replaceIfElse(&result, getRootExpr(expr->falseExpr)->as<AstExprIfElse>(), var);
-    else {
-        addIndents;
-        result.append(var);
-        result.append(" = ");
-        result.append(beautify(expr->falseExpr));
-        result.append(";\n");
-    };
-    indent--;
 
+void benchAddIndents(std::string& result, int indent_in) {
+    indent = indent_in;
+    skip_first_indent = false;
+    b_ignore_indent = false;
     addIndents;
-    result.append("end;\n");
+};
 
-    out->replace(0, out->size(), result.c_str());
+void benchOptionalNewline(std::string& result, int indent_in) {
+    indent = indent_in;
+    skip_first_indent = false;
+    b_ignore_indent = false;
+    optionalNewline;
 };
 
+std::string benchGetIndents(int indent_in) {
+    indent = indent_in;
+    return getIndents();
+};
 
-std::string beautifyRoot(AstStatBlock* root, bool nosolve_in, bool ignore_types_in, bool replace_if_expressions_in, bool extra1_in) {
+std::string beautifyRoot(AstStatBlock* root, bool nosolve_in, bool ignore_types_in) {
     indent = 0;
     skip_first_indent = false;
-    skip_count = -1;
     b_is_root = true; // aka is first beautify call
     b_dont_append_do = false;
     b_ignore_indent = false;
@@ -879,8 +663,6 @@ std::string beautifyRoot(AstStatBlock* root, bool nosolve_in, bool ignore_types_
     b_inside_group = false;
 
     b_ignore_types = ignore_types_in;
-    replace_if_expressions = replace_if_expressions_in;
-    extra1 = extra1_in;
     setupSolve(nosolve_in, ignore_types_in);
     return beautify(root);
 };
\ No newline at end of file
@@ -47,8 +47,23 @@ struct Injection {
 };
 
 typedef Injection InjectCallback(Luau::AstStat* stat, bool is_root, void* data);
+// one callback for the whole process: set it before any worker starts printing, it is then called from all of
+// them at once
 void setupInjectCallback(InjectCallback, void* data = nullptr);
 void dontAppendDo();
 
+// receives the output one top-level statement at a time instead of it being returned at the end
+// returning false stops printing
+typedef bool OutputSink(const std::string& chunk, void* data);
+void setupOutputSink(OutputSink* sink, void* data = nullptr);
+// hands chunk to the output sink (if any) and clears it, returns false once printing should stop
+bool emitOutput(std::string& chunk);
+
 std::string fixString(Luau::AstArray<char> value);
-std::string beautifyRoot(Luau::AstStatBlock* root, bool nosolve, bool ignore_types, bool replace_if_expressions, bool extra1);
\ No newline at end of file
+
+// the addIndents / optionalNewline / getIndents kernels on their own at a given indent, for bench/kernels.cpp
+void benchAddIndents(std::string& result, int indent);
+void benchOptionalNewline(std::string& result, int indent);
+std::string benchGetIndents(int indent);
+
+std::string beautifyRoot(Luau::AstStatBlock* root, bool nosolve, bool ignore_types);
\ No newline at end of file
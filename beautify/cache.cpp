@@ -0,0 +1,202 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Luau/Lexer.h"
+
+#include "hash.hpp"
+
+using namespace Luau;
+
+// once the cache grows past this, the entries used longest ago are dropped
+constexpr size_t incremental_budget = 256 * 1024 * 1024;
+
+constexpr uint64_t hash_base = fnv_prime;
+// the base of the check hash, which has to collide independently of the key hash
+constexpr uint64_t check_base = 0x9e3779b97f4a7c15;
+
+bool incremental = false;
+
+void setIncremental(bool enabled) {
+    incremental = enabled;
+};
+bool isIncremental() {
+    return incremental;
+};
+
+struct TokenHashes {
+    bool prepared = false;
+    uint64_t seed = 0;
+    std::vector<Position> begins;
+    std::vector<uint64_t> prefix; // prefix[i] is the hash of the first i tokens
+    std::vector<uint64_t> powers; // powers[i] is hash_base^i
+    std::vector<uint64_t> check_prefix; // the same with check_base
+    std::vector<uint64_t> check_powers;
+};
+thread_local TokenHashes token_hashes;
+
+struct CacheEntry {
+    std::string text;
+    uint64_t check;
+    size_t tokens;
+    uint64_t state_after;
+    std::list<uint64_t>::iterator recent;
+};
+
+std::mutex cache_mutex;
+std::unordered_map<uint64_t, CacheEntry> cache;
+std::list<uint64_t> cache_recent; // keys, most recently used first
+size_t cache_bytes = 0;
+size_t cache_hits = 0;
+size_t cache_misses = 0;
+
+uint64_t mixHash(uint64_t value) {
+    // splitmix64 finalizer
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111eb;
+    value ^= value >> 31;
+    return value;
+};
+
+uint64_t hashLexeme(const Lexeme& lexeme) {
+    uint64_t hash = fnv_offset_basis ^ (uint64_t) lexeme.type;
+    hash *= hash_base;
+
+    switch (lexeme.type) {
+        case Lexeme::Name:
+        case Lexeme::Attribute:
+            hash = hashDigest(hash, lexeme.name, strlen(lexeme.name));
+            break;
+
+        case Lexeme::RawString:
+        case Lexeme::QuotedString:
+        case Lexeme::Number:
+        case Lexeme::InterpStringBegin:
+        case Lexeme::InterpStringMid:
+        case Lexeme::InterpStringEnd:
+        case Lexeme::InterpStringSimple:
+            hash = hashDigest(hash, lexeme.data, lexeme.getLength());
+            break;
+
+        default:
+            break;
+    }
+
+    return mixHash(hash);
+};
+
+void prepareIncremental(const char* source, size_t size, uint64_t seed) {
+    TokenHashes& hashes = token_hashes;
+    hashes.begins.clear();
+    hashes.prefix.clear();
+    hashes.prefix.push_back(0);
+    hashes.check_prefix.clear();
+    hashes.check_prefix.push_back(0);
+
+    Allocator allocator;
+    AstNameTable names(allocator);
+
+    Lexer lexer(source, size, names);
+    lexer.setSkipComments(true);
+
+    while (lexer.next().type != Lexeme::Eof) {
+        const Lexeme& lexeme = lexer.current();
+        uint64_t hash = hashLexeme(lexeme);
+        hashes.begins.push_back(lexeme.location.begin);
+        hashes.prefix.push_back(hashes.prefix.back() * hash_base + hash);
+        hashes.check_prefix.push_back(hashes.check_prefix.back() * check_base + mixHash(hash + check_base));
+    }
+
+    if (hashes.powers.empty()) {
+        hashes.powers.push_back(1);
+        hashes.check_powers.push_back(1);
+    }
+    while (hashes.powers.size() < hashes.prefix.size()) {
+        hashes.powers.push_back(hashes.powers.back() * hash_base);
+        hashes.check_powers.push_back(hashes.check_powers.back() * check_base);
+    }
+
+    hashes.seed = mixHash(seed);
+    hashes.prepared = true;
+};
+
+void finishIncremental() {
+    token_hashes.prepared = false;
+};
+
+std::optional<IncrementalKey> getStructuralKey(AstNode* node, uint64_t state, uint64_t bindings) {
+    TokenHashes& hashes = token_hashes;
+    if (!hashes.prepared)
+        return std::nullopt;
+
+    auto first = std::lower_bound(hashes.begins.begin(), hashes.begins.end(), node->location.begin);
+    auto last = std::lower_bound(first, hashes.begins.end(), node->location.end);
+
+    size_t from = first - hashes.begins.begin();
+    size_t to = last - hashes.begins.begin();
+    if (from >= to)
+        return std::nullopt;
+
+    uint64_t hash = hashes.prefix[to] - hashes.prefix[from] * hashes.powers[to - from];
+    uint64_t check = hashes.check_prefix[to] - hashes.check_prefix[from] * hashes.check_powers[to - from];
+    return IncrementalKey {
+        mixHash(mixHash(hash ^ hashes.seed) ^ mixHash(state * hash_base + (to - from)) ^ mixHash(bindings)),
+        mixHash(check ^ mixHash(hashes.seed + check_base) ^ mixHash(state * check_base) ^ mixHash(bindings + check_base)),
+        to - from
+    };
+};
+
+bool lookupIncremental(const IncrementalKey& key, std::string& out, uint64_t& state_after) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = cache.find(key.hash);
+    if (it == cache.end() || it->second.check != key.check || it->second.tokens != key.tokens) {
+        cache_misses++;
+        return false;
+    }
+
+    cache_hits++;
+    cache_recent.splice(cache_recent.begin(), cache_recent, it->second.recent);
+    out.append(it->second.text);
+    state_after = it->second.state_after;
+    return true;
+};
+
+void storeIncremental(const IncrementalKey& key, const std::string& text, uint64_t state_after) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto [it, inserted] = cache.try_emplace(key.hash);
+    CacheEntry& entry = it->second;
+    if (inserted) {
+        cache_recent.push_front(key.hash);
+        entry.recent = cache_recent.begin();
+    } else
+        cache_recent.splice(cache_recent.begin(), cache_recent, entry.recent);
+
+    cache_bytes -= entry.text.size();
+    entry.text = text;
+    entry.check = key.check;
+    entry.tokens = key.tokens;
+    entry.state_after = state_after;
+    cache_bytes += entry.text.size();
+
+    // the least recently used entries go as soon as the budget is exceeded, so no store walks the whole cache
+    while (cache_bytes > incremental_budget && cache_recent.size() > 1) {
+        auto oldest = cache.find(cache_recent.back());
+        cache_bytes -= oldest->second.text.size();
+        cache.erase(oldest);
+        cache_recent.pop_back();
+    }
+};
+
+IncrementalStats getIncrementalStats() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return { cache_hits, cache_misses, cache.size(), cache_bytes };
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "Luau/Ast.h"
+
+// incremental beautify: formatted text of functions and top-level statements is cached by a
+// structural hash (the hash of their token stream), so re-running on an edited file only
+// re-emits the subtrees that actually changed. the cache lives for the whole process
+
+void setIncremental(bool enabled);
+bool isIncremental();
+
+// lexes the source and builds the prefix hashes used by getStructuralKey
+// seed should capture every option that changes the output
+void prepareIncremental(const char* source, size_t size, uint64_t seed);
+void finishIncremental();
+
+// a subtree's key. hash and check are independent hashes of its tokens and the printer state, tokens is how many
+// tokens it spans, and a cached text is only used when all three match
+struct IncrementalKey {
+    uint64_t hash;
+    uint64_t check;
+    size_t tokens;
+};
+
+// state is whatever printer state the output of node depends on (indent, flags), bindings what the locals it
+// reads are bound to
+std::optional<IncrementalKey> getStructuralKey(Luau::AstNode* node, uint64_t state, uint64_t bindings);
+
+// state_after is the printer state printing the subtree left behind, for a hit to restore
+bool lookupIncremental(const IncrementalKey& key, std::string& out, uint64_t& state_after);
+void storeIncremental(const IncrementalKey& key, const std::string& text, uint64_t state_after);
+
+struct IncrementalStats {
+    size_t hits;
+    size_t misses;
+    size_t entries;
+    size_t bytes;
+};
+IncrementalStats getIncrementalStats();
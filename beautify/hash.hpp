@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// fnv-1a, what the incremental cache, the digests in its seed and --shard hash with
+constexpr uint64_t fnv_offset_basis = 0xcbf29ce484222325;
+constexpr uint64_t fnv_prime = 0x100000001b3;
+
+// folds size bytes of data into digest, which starts out as fnv_offset_basis
+inline uint64_t hashDigest(uint64_t digest, const void* data, size_t size) {
+    for (size_t index = 0; index < size; index++) {
+        digest ^= ((const unsigned char*) data)[index];
+        digest *= fnv_prime;
+    };
+
+    return digest;
+};
@@ -0,0 +1,1755 @@
+#include "interpret.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cache.hpp"
+#include "solve.hpp"
+
+using namespace Luau;
+
+struct TableValue;
+struct ClosureValue;
+
+enum class Builtin {
+    Select,
+    Ipairs,
+    StringByte,
+    StringChar,
+    StringLen,
+    StringLower,
+    StringRep,
+    StringReverse,
+    StringSub,
+    StringUpper,
+    MathAbs,
+    MathCeil,
+    MathClamp,
+    MathFloor,
+    MathFmod,
+    MathMax,
+    MathMin,
+    MathRound,
+    MathSign,
+    MathSqrt,
+    Bit32Arshift,
+    Bit32Band,
+    Bit32Bnot,
+    Bit32Bor,
+    Bit32Btest,
+    Bit32Bxor,
+    Bit32Countlz,
+    Bit32Countrz,
+    Bit32Extract,
+    Bit32Lrotate,
+    Bit32Lshift,
+    Bit32Replace,
+    Bit32Rrotate,
+    Bit32Rshift
+};
+
+struct TrustedGlobal {
+    const char* name;
+    uint32_t bit;
+};
+
+const TrustedGlobal trusted_global_names[] = { { "select", TrustSelect }, { "string", TrustString }, { "math", TrustMath },
+    { "bit32", TrustBit32 }, { "ipairs", TrustIpairs } };
+
+struct LibraryMember {
+    uint32_t library;
+    const char* name;
+    Builtin builtin;
+};
+
+// only the functions whose result is exact on every platform, math.sin and friends depend on the libm
+const LibraryMember library_members[] = {
+    { TrustString, "byte", Builtin::StringByte }, { TrustString, "char", Builtin::StringChar },
+    { TrustString, "len", Builtin::StringLen }, { TrustString, "lower", Builtin::StringLower },
+    { TrustString, "rep", Builtin::StringRep }, { TrustString, "reverse", Builtin::StringReverse },
+    { TrustString, "sub", Builtin::StringSub }, { TrustString, "upper", Builtin::StringUpper },
+    { TrustMath, "abs", Builtin::MathAbs }, { TrustMath, "ceil", Builtin::MathCeil },
+    { TrustMath, "clamp", Builtin::MathClamp }, { TrustMath, "floor", Builtin::MathFloor },
+    { TrustMath, "fmod", Builtin::MathFmod }, { TrustMath, "max", Builtin::MathMax },
+    { TrustMath, "min", Builtin::MathMin }, { TrustMath, "round", Builtin::MathRound },
+    { TrustMath, "sign", Builtin::MathSign }, { TrustMath, "sqrt", Builtin::MathSqrt },
+    { TrustBit32, "arshift", Builtin::Bit32Arshift }, { TrustBit32, "band", Builtin::Bit32Band },
+    { TrustBit32, "bnot", Builtin::Bit32Bnot }, { TrustBit32, "bor", Builtin::Bit32Bor },
+    { TrustBit32, "btest", Builtin::Bit32Btest }, { TrustBit32, "bxor", Builtin::Bit32Bxor },
+    { TrustBit32, "countlz", Builtin::Bit32Countlz }, { TrustBit32, "countrz", Builtin::Bit32Countrz },
+    { TrustBit32, "extract", Builtin::Bit32Extract }, { TrustBit32, "lrotate", Builtin::Bit32Lrotate },
+    { TrustBit32, "lshift", Builtin::Bit32Lshift }, { TrustBit32, "replace", Builtin::Bit32Replace },
+    { TrustBit32, "rrotate", Builtin::Bit32Rrotate }, { TrustBit32, "rshift", Builtin::Bit32Rshift }
+};
+
+// set by prepareInterpret for the chunk being printed
+thread_local uint32_t trusted_globals = 0;
+
+// what a local holds everywhere, when the only assignment to it is where it's declared. found by
+// BindingVisitor, in the order of the chunk, so a use never has to look for its declaration
+struct BoundLocal {
+    Interpreted constant;
+    enum Kind {
+        Constant,
+        Builtin,
+        Library,
+        Function,
+        Table // only ever indexed, see isBoundTable
+    } kind;
+    ::Builtin builtin;
+    uint32_t library;
+    AstExprFunction* function;
+    std::vector<Interpreted> items;
+    // the statements that shuffled the table, when there were any
+    bool shuffled;
+    Location shuffles;
+    // of the kind and what it's bound to, see getBindingDigest
+    uint64_t digest;
+};
+thread_local std::unordered_map<AstLocal*, BoundLocal> bound_locals;
+thread_local std::unordered_map<AstExprCall*, std::optional<Interpreted>> interpreted_calls;
+
+uint32_t getTrustedGlobal(const char* name) {
+    for (const TrustedGlobal& global : trusted_global_names)
+        if (strcmp(global.name, name) == 0)
+            return global.bit;
+
+    return 0;
+};
+
+struct Value {
+    enum class Kind {
+        Nil,
+        Bool,
+        Number,
+        String,
+        Table,
+        Closure,
+        Builtin,
+        Library // string, math or bit32 themselves
+    } kind = Kind::Nil;
+    bool boolean = false;
+    double number = 0;
+    std::shared_ptr<const std::string> string; // shared, values are copied around a lot
+    TableValue* table = nullptr;
+    ClosureValue* closure = nullptr;
+    Builtin builtin = Builtin::Select;
+    uint32_t library = 0;
+};
+
+// t[1] to t[#array] live in array, so # and appends are cheap. any other number key goes to numbers
+struct TableValue {
+    std::vector<Value> array;
+    size_t array_nils = 0; // # is ambiguous once there's a hole
+    std::map<double, Value> numbers;
+    std::map<std::string, Value> strings;
+    Value true_value;
+    Value false_value;
+};
+
+struct Scope {
+    Scope* parent;
+    std::vector<std::pair<AstLocal*, Value>> locals;
+};
+
+struct ClosureValue {
+    AstExprFunction* function;
+    Scope* scope;
+};
+
+enum class Flow {
+    Normal,
+    Break,
+    Continue,
+    Return
+};
+
+bool isTruthy(const Value& value) {
+    return value.kind != Value::Kind::Nil && !(value.kind == Value::Kind::Bool && !value.boolean);
+};
+
+Value makeBool(bool boolean) {
+    Value value;
+    value.kind = Value::Kind::Bool;
+    value.boolean = boolean;
+    return value;
+};
+
+Value makeNumber(double number) {
+    Value value;
+    value.kind = Value::Kind::Number;
+    value.number = number;
+    return value;
+};
+
+bool isInteger(double number) {
+    return std::floor(number) == number && std::isfinite(number);
+};
+
+// luaL_checkinteger truncates, past what an int holds it's undefined so those aren't folded
+std::optional<int> toInt(const Value& value) {
+    if (value.kind != Value::Kind::Number || !(value.number > INT_MIN - 1.0 && value.number < INT_MAX + 1.0))
+        return std::nullopt;
+
+    return (int) value.number;
+};
+
+// luaL_optinteger, a missing or nil argument is the fallback
+std::optional<int> toInt(const std::vector<Value>& args, size_t index, std::optional<int> fallback) {
+    if (index >= args.size() || args[index].kind == Value::Kind::Nil)
+        return fallback;
+
+    return toInt(args[index]);
+};
+
+// bit32 takes numbers modulo 2^32 after truncating them
+std::optional<uint32_t> toUnsigned(const Value& value) {
+    if (value.kind != Value::Kind::Number || !(std::fabs(value.number) < 9007199254740992.0))
+        return std::nullopt;
+
+    return (uint32_t) (long long) value.number;
+};
+
+// the string arguments of the string library can be numbers too
+std::optional<std::string> toString(const Value& value) {
+    if (value.kind == Value::Kind::String)
+        return *value.string;
+    if (value.kind == Value::Kind::Number)
+        return numberToString(value.number);
+
+    return std::nullopt;
+};
+
+// what string.sub and string.byte make of a negative position
+int relativePosition(int position, size_t length) {
+    if (position >= 0)
+        return position;
+    if ((size_t) -(long long) position > length)
+        return 0;
+
+    return (int) length + position + 1;
+};
+
+// every function returns something harmless once failed is set, callers check it before going on
+struct Interpreter {
+    size_t max_steps = interpret_max_steps;
+    size_t max_bytes = interpret_max_bytes;
+    size_t steps = 0;
+    size_t depth = 0;
+    size_t bytes = 0; // what's alive right now, strings and scopes give theirs back
+    size_t string_bytes = 0;
+    bool failed = false;
+
+    // declared after bytes, the strings in them still give their bytes back while they're destroyed. lists,
+    // most evaluations never make any of these and an empty list doesn't allocate
+    std::list<TableValue> tables;
+    std::list<Scope> scopes;
+    std::list<ClosureValue> closures;
+
+    Scope* scope = nullptr;
+    const std::vector<Value>* varargs = nullptr; // of the innermost call, nullptr outside of one
+    std::vector<Value> returned;
+
+    Value fail() {
+        failed = true;
+        return {};
+    };
+
+    bool step() {
+        if (++steps > max_steps)
+            failed = true;
+        return !failed;
+    };
+
+    bool charge(size_t size) {
+        bytes += size;
+        if (bytes > max_bytes)
+            failed = true;
+        return !failed;
+    };
+
+    Value makeString(std::string string) {
+        size_t size = sizeof(std::string) + string.size();
+        string_bytes += string.size();
+        if (string_bytes > interpret_max_string_bytes)
+            return fail();
+        if (!charge(size))
+            return {};
+
+        Value value;
+        value.kind = Value::Kind::String;
+        value.string = std::shared_ptr<const std::string>(new std::string(std::move(string)), [this, size](const std::string* string) {
+            bytes -= size;
+            delete string;
+        });
+        return value;
+    };
+
+    Scope* pushScope() {
+        if (!charge(sizeof(Scope)))
+            return nullptr;
+
+        scopes.push_back({ scope, {} });
+        scope = &scopes.back();
+        return scope;
+    };
+
+    // loops push a scope every iteration, they're dropped again unless a closure made since could see them
+    void popScope(Scope* outer_scope, size_t closure_count) {
+        if (closures.size() == closure_count && !scopes.empty() && &scopes.back() == scope) {
+            bytes -= sizeof(Scope) + scope->locals.size() * sizeof(std::pair<AstLocal*, Value>);
+            scopes.pop_back();
+        };
+
+        scope = outer_scope;
+    };
+
+    void declare(AstLocal* local, Value value) {
+        if (charge(sizeof(std::pair<AstLocal*, Value>)))
+            scope->locals.push_back({ local, value });
+    };
+
+    Value* lookup(AstLocal* local) {
+        for (Scope* current = scope; current; current = current->parent)
+            for (auto it = current->locals.rbegin(); it != current->locals.rend(); it++)
+                if (it->first == local)
+                    return &it->second;
+
+        // an upvalue of something outside the call
+        return nullptr;
+    };
+
+    Value getMember(uint32_t library, const Value& key) {
+        if (key.kind != Value::Kind::String)
+            return fail();
+
+        if (library == TrustMath && (*key.string == "pi" || *key.string == "huge"))
+            return makeNumber(*key.string == "pi" ? 3.14159265358979323846 : HUGE_VAL);
+
+        for (const LibraryMember& member : library_members) {
+            if (member.library == library && *key.string == member.name) {
+                Value value;
+                value.kind = Value::Kind::Builtin;
+                value.builtin = member.builtin;
+                return value;
+            };
+        };
+
+        return fail();
+    };
+
+    Value get(const Value& object, const Value& key) {
+        if (object.kind == Value::Kind::Library)
+            return getMember(object.library, key);
+        // ("x"):rep(3) goes through the string metatable, which is the string library
+        if (object.kind == Value::Kind::String && (trusted_globals & TrustString))
+            return getMember(TrustString, key);
+        if (object.kind != Value::Kind::Table)
+            return fail();
+
+        TableValue* table = object.table;
+        switch (key.kind) {
+            case Value::Kind::Nil:
+                return {};
+            case Value::Kind::Bool:
+                return key.boolean ? table->true_value : table->false_value;
+            case Value::Kind::Number: {
+                if (std::isnan(key.number))
+                    return {};
+                if (isInteger(key.number) && key.number >= 1 && key.number <= table->array.size())
+                    return table->array[(size_t) key.number - 1];
+
+                auto it = table->numbers.find(key.number == 0 ? 0 : key.number);
+                return it == table->numbers.end() ? Value() : it->second;
+            };
+            case Value::Kind::String: {
+                auto it = table->strings.find(*key.string);
+                return it == table->strings.end() ? Value() : it->second;
+            };
+
+            default:
+                // tables and functions as keys
+                return fail();
+        };
+    };
+
+    void set(const Value& object, const Value& key, const Value& value) {
+        if (object.kind != Value::Kind::Table)
+            return (void) fail();
+
+        TableValue* table = object.table;
+        bool nil = value.kind == Value::Kind::Nil;
+        switch (key.kind) {
+            case Value::Kind::Bool:
+                (key.boolean ? table->true_value : table->false_value) = value;
+                break;
+            case Value::Kind::String:
+                if (nil)
+                    table->strings.erase(*key.string);
+                else if (table->strings.count(*key.string) || charge(sizeof(Value) + key.string->size()))
+                    table->strings[*key.string] = value;
+                break;
+            case Value::Kind::Number: {
+                if (std::isnan(key.number))
+                    return (void) fail();
+
+                double number = key.number == 0 ? 0 : key.number;
+                size_t size = table->array.size();
+                if (isInteger(number) && number >= 1 && number <= size) {
+                    Value& slot = table->array[(size_t) number - 1];
+                    table->array_nils += (size_t) nil - (size_t) (slot.kind == Value::Kind::Nil);
+                    slot = value;
+
+                    while (!table->array.empty() && table->array.back().kind == Value::Kind::Nil) {
+                        table->array.pop_back();
+                        table->array_nils--;
+                    };
+                } else if (number == size + 1 && !nil) {
+                    if (!charge(sizeof(Value)))
+                        return;
+                    table->array.push_back(value);
+
+                    // keys that were past the end until now
+                    auto it = table->numbers.end();
+                    while ((it = table->numbers.find((double) table->array.size() + 1)) != table->numbers.end()) {
+                        table->array.push_back(it->second);
+                        table->numbers.erase(it);
+                    };
+                } else if (nil)
+                    table->numbers.erase(number);
+                else if (table->numbers.count(number) || charge(sizeof(Value)))
+                    table->numbers[number] = value;
+                break;
+            };
+
+            default:
+                return (void) fail();
+        };
+    };
+
+    std::vector<Value> call(const Value& callee, std::vector<Value> args) {
+        if (callee.kind == Value::Kind::Builtin)
+            return callBuiltin(callee.builtin, args);
+        if (callee.kind != Value::Kind::Closure || depth >= interpret_max_depth) {
+            fail();
+            return {};
+        };
+
+        AstExprFunction* function = callee.closure->function;
+
+        Scope* outer_scope = scope;
+        const std::vector<Value>* outer_varargs = varargs;
+        size_t closure_count = closures.size();
+        depth++;
+
+        scope = callee.closure->scope;
+        Scope* call_scope = pushScope();
+
+        size_t index = 0;
+        if (function->self)
+            declare(function->self, index < args.size() ? args[index++] : Value());
+        for (AstLocal* arg : function->args)
+            declare(arg, index < args.size() ? args[index++] : Value());
+
+        std::vector<Value> extra;
+        if (function->vararg)
+            extra.assign(args.begin() + std::min(index, args.size()), args.end());
+        varargs = &extra;
+
+        std::vector<Value> results;
+        if (!failed && exec(function->body) == Flow::Return)
+            results = std::move(returned);
+
+        depth--;
+        varargs = outer_varargs;
+        if (call_scope)
+            popScope(outer_scope, closure_count);
+        else
+            scope = outer_scope;
+        return results;
+    };
+
+    std::vector<Value> callBuiltin(Builtin builtin, const std::vector<Value>& args) {
+        switch (builtin) {
+            case Builtin::Select: {
+                if (args.empty())
+                    break;
+
+                size_t count = args.size() - 1;
+                if (args[0].kind == Value::Kind::String && *args[0].string == "#")
+                    return { makeNumber((double) count) };
+                if (args[0].kind != Value::Kind::Number || !isInteger(args[0].number))
+                    break;
+
+                // negative indexes count from the end, anything out of range is an error
+                double index = args[0].number;
+                if (index < 0)
+                    index += count + 1;
+                if (index < 1 || (index > count && args[0].number < 0))
+                    break;
+                if (index > count)
+                    return {};
+
+                return std::vector<Value>(args.begin() + (size_t) index, args.end());
+            };
+
+            case Builtin::StringByte:
+            case Builtin::StringChar:
+            case Builtin::StringLen:
+            case Builtin::StringLower:
+            case Builtin::StringRep:
+            case Builtin::StringReverse:
+            case Builtin::StringSub:
+            case Builtin::StringUpper:
+                return callString(builtin, args);
+
+            case Builtin::MathAbs:
+            case Builtin::MathCeil:
+            case Builtin::MathClamp:
+            case Builtin::MathFloor:
+            case Builtin::MathFmod:
+            case Builtin::MathMax:
+            case Builtin::MathMin:
+            case Builtin::MathRound:
+            case Builtin::MathSign:
+            case Builtin::MathSqrt:
+                return callMath(builtin, args);
+
+            default:
+                return callBit32(builtin, args);
+        };
+
+        fail();
+        return {};
+    };
+
+    std::vector<Value> callString(Builtin builtin, const std::vector<Value>& args) {
+        if (builtin == Builtin::StringChar) {
+            std::string result;
+            for (const Value& arg : args) {
+                std::optional<int> code = toInt(arg);
+                if (!code || *code < 0 || *code > 255) {
+                    fail();
+                    return {};
+                };
+
+                result += (char) *code;
+            };
+
+            return { makeString(std::move(result)) };
+        };
+
+        std::optional<std::string> string = args.empty() ? std::nullopt : toString(args[0]);
+        if (!string) {
+            fail();
+            return {};
+        };
+
+        size_t length = string->size();
+        switch (builtin) {
+            case Builtin::StringLen:
+                return { makeNumber((double) length) };
+            case Builtin::StringLower:
+            case Builtin::StringUpper:
+                // the C locale, only ascii letters change
+                for (char& ch : *string) {
+                    if (builtin == Builtin::StringLower && ch >= 'A' && ch <= 'Z')
+                        ch += 'a' - 'A';
+                    else if (builtin == Builtin::StringUpper && ch >= 'a' && ch <= 'z')
+                        ch -= 'a' - 'A';
+                };
+                return { makeString(std::move(*string)) };
+            case Builtin::StringReverse:
+                std::reverse(string->begin(), string->end());
+                return { makeString(std::move(*string)) };
+            case Builtin::StringRep: {
+                std::optional<int> count = toInt(args, 1, std::nullopt);
+                if (!count || (*count > 0 && length > max_bytes / *count)) {
+                    fail();
+                    return {};
+                };
+
+                std::string result;
+                for (int index = 0; index < *count; index++)
+                    result.append(*string);
+                return { makeString(std::move(result)) };
+            };
+            case Builtin::StringSub:
+            case Builtin::StringByte: {
+                // byte defaults to just the first character, sub needs a start and goes to the end
+                std::optional<int> first = toInt(args, 1, builtin == Builtin::StringByte ? std::optional<int>(1) : std::nullopt);
+                if (!first) {
+                    fail();
+                    return {};
+                };
+
+                int start = relativePosition(*first, length);
+                std::optional<int> last = toInt(args, 2, builtin == Builtin::StringByte ? start : -1);
+                if (!last) {
+                    fail();
+                    return {};
+                };
+
+                int end = relativePosition(*last, length);
+                if (start < 1)
+                    start = 1;
+                if (end > (int) length)
+                    end = (int) length;
+
+                if (builtin == Builtin::StringSub)
+                    return { makeString(start <= end ? string->substr(start - 1, end - start + 1) : "") };
+
+                std::vector<Value> bytes;
+                for (int index = start; index <= end; index++)
+                    bytes.push_back(makeNumber((unsigned char) (*string)[index - 1]));
+                return bytes;
+            };
+
+            default:
+                break;
+        };
+
+        fail();
+        return {};
+    };
+
+    std::vector<Value> callMath(Builtin builtin, const std::vector<Value>& args) {
+        std::vector<double> numbers;
+        for (const Value& arg : args) {
+            // luau would take numeric strings too
+            if (arg.kind != Value::Kind::Number)
+                break;
+            numbers.push_back(arg.number);
+        };
+
+        size_t needed = builtin == Builtin::MathClamp ? 3 : builtin == Builtin::MathFmod ? 2 : 1;
+        if (numbers.size() < needed) {
+            fail();
+            return {};
+        };
+
+        double x = numbers[0];
+        switch (builtin) {
+            case Builtin::MathAbs:
+                return { makeNumber(std::fabs(x)) };
+            case Builtin::MathCeil:
+                return { makeNumber(std::ceil(x)) };
+            case Builtin::MathFloor:
+                return { makeNumber(std::floor(x)) };
+            case Builtin::MathSqrt:
+                return { makeNumber(std::sqrt(x)) };
+            case Builtin::MathRound:
+                return { makeNumber(std::round(x)) };
+            case Builtin::MathSign:
+                return { makeNumber(x > 0 ? 1 : x < 0 ? -1 : 0) };
+            case Builtin::MathFmod:
+                return { makeNumber(std::fmod(x, numbers[1])) };
+            case Builtin::MathClamp:
+                // an error in luau
+                if (!(numbers[1] <= numbers[2]))
+                    break;
+                return { makeNumber(x < numbers[1] ? numbers[1] : x > numbers[2] ? numbers[2] : x) };
+            case Builtin::MathMax:
+            case Builtin::MathMin: {
+                // the same comparisons as luau, for the same answer with nan
+                if (numbers.size() != args.size())
+                    break;
+                for (double number : numbers)
+                    if (builtin == Builtin::MathMax ? number > x : number < x)
+                        x = number;
+                return { makeNumber(x) };
+            };
+
+            default:
+                break;
+        };
+
+        fail();
+        return {};
+    };
+
+    std::vector<Value> callBit32(Builtin builtin, const std::vector<Value>& args) {
+        std::vector<uint32_t> numbers;
+        for (const Value& arg : args) {
+            std::optional<uint32_t> number = toUnsigned(arg);
+            if (!number)
+                break;
+            numbers.push_back(*number);
+        };
+
+        bool variadic = builtin == Builtin::Bit32Band || builtin == Builtin::Bit32Bor || builtin == Builtin::Bit32Bxor
+            || builtin == Builtin::Bit32Btest;
+        size_t needed = builtin == Builtin::Bit32Replace ? 3
+            : builtin == Builtin::Bit32Bnot || builtin == Builtin::Bit32Countlz || builtin == Builtin::Bit32Countrz ? 1
+            : builtin == Builtin::Bit32Extract ? 2
+            : variadic ? 0 : 2;
+        if (numbers.size() < needed || (variadic && numbers.size() != args.size())) {
+            fail();
+            return {};
+        };
+
+        uint32_t x = numbers.empty() ? 0 : numbers[0];
+        switch (builtin) {
+            case Builtin::Bit32Band:
+            case Builtin::Bit32Btest: {
+                uint32_t result = 0xFFFFFFFF;
+                for (uint32_t number : numbers)
+                    result &= number;
+                return { builtin == Builtin::Bit32Band ? makeNumber(result) : makeBool(result != 0) };
+            };
+            case Builtin::Bit32Bor:
+            case Builtin::Bit32Bxor: {
+                uint32_t result = 0;
+                for (uint32_t number : numbers)
+                    result = builtin == Builtin::Bit32Bor ? result | number : result ^ number;
+                return { makeNumber(result) };
+            };
+            case Builtin::Bit32Bnot:
+                return { makeNumber(~x) };
+            case Builtin::Bit32Countlz:
+            case Builtin::Bit32Countrz: {
+                int count = 0;
+                for (; count < 32; count++)
+                    if (builtin == Builtin::Bit32Countlz ? x & (0x80000000u >> count) : x & (1u << count))
+                        break;
+                return { makeNumber(count) };
+            };
+            case Builtin::Bit32Lshift:
+            case Builtin::Bit32Rshift:
+            case Builtin::Bit32Arshift:
+            case Builtin::Bit32Lrotate:
+            case Builtin::Bit32Rrotate: {
+                // shifts and fields take plain ints, not numbers modulo 2^32
+                std::optional<int> displacement = toInt(args[1]);
+                if (!displacement)
+                    break;
+
+                long long shift = *displacement;
+                if (builtin == Builtin::Bit32Lrotate || builtin == Builtin::Bit32Rrotate) {
+                    shift = (builtin == Builtin::Bit32Lrotate ? shift : -shift) & 31;
+                    return { makeNumber(shift == 0 ? x : (x << shift) | (x >> (32 - shift))) };
+                };
+
+                // arshift only differs from rshift for negative numbers shifted right
+                if (builtin == Builtin::Bit32Arshift && shift > 0 && (x & 0x80000000))
+                    return { makeNumber(shift >= 32 ? 0xFFFFFFFF : (x >> shift) | ~(0xFFFFFFFFu >> shift)) };
+
+                if (builtin != Builtin::Bit32Lshift)
+                    shift = -shift;
+                if (shift <= -32 || shift >= 32)
+                    return { makeNumber(0) };
+                return { makeNumber(shift >= 0 ? x << shift : x >> -shift) };
+            };
+            case Builtin::Bit32Extract:
+            case Builtin::Bit32Replace: {
+                bool replace = builtin == Builtin::Bit32Replace;
+                std::optional<int> field = toInt(args, replace ? 2 : 1, std::nullopt);
+                std::optional<int> width = toInt(args, replace ? 3 : 2, 1);
+                if (!field || !width || *field < 0 || *width <= 0 || *field + *width > 32)
+                    break;
+
+                uint32_t mask = 0xFFFFFFFFu >> (32 - *width);
+                if (!replace)
+                    return { makeNumber((x >> *field) & mask) };
+
+                uint32_t value = numbers[1] & mask;
+                return { makeNumber((x & ~(mask << *field)) | (value << *field)) };
+            };
+
+            default:
+                break;
+        };
+
+        fail();
+        return {};
+    };
+
+    // every value of the expression, calls and ... can have any number
+    std::vector<Value> evalMulti(AstExpr* expr) {
+        if (AstExprCall* expr_call = expr->as<AstExprCall>()) {
+            if (!step())
+                return {};
+
+            Value callee;
+            std::vector<Value> args;
+            if (expr_call->self) {
+                AstExprIndexName* method = expr_call->func->as<AstExprIndexName>();
+                if (!method) {
+                    fail();
+                    return {};
+                };
+
+                Value object = eval(method->expr);
+                callee = get(object, makeString(method->index.value));
+                args.push_back(object);
+            } else
+                callee = eval(expr_call->func);
+
+            // anything but a function fails anyway, there's no point in evaluating the arguments first
+            if (failed || (callee.kind != Value::Kind::Closure && callee.kind != Value::Kind::Builtin)) {
+                fail();
+                return {};
+            };
+
+            std::vector<Value> rest = evalList(expr_call->args);
+            args.insert(args.end(), rest.begin(), rest.end());
+            if (failed)
+                return {};
+
+            return call(callee, std::move(args));
+        } else if (expr->is<AstExprVarargs>()) {
+            if (!varargs) {
+                fail();
+                return {};
+            };
+
+            return *varargs;
+        };
+
+        return { eval(expr) };
+    };
+
+    std::vector<Value> evalList(const AstArray<AstExpr*>& list) {
+        std::vector<Value> values;
+        for (size_t index = 0; index < list.size && !failed; index++) {
+            if (index + 1 == list.size) {
+                std::vector<Value> last = evalMulti(list.data[index]);
+                values.insert(values.end(), last.begin(), last.end());
+            } else
+                values.push_back(eval(list.data[index]));
+        };
+
+        return values;
+    };
+
+    Value arithmetic(AstExprBinary::Op op, const Value& left, const Value& right) {
+        // luau would coerce numeric strings here, that's left alone
+        if (left.kind != Value::Kind::Number || right.kind != Value::Kind::Number)
+            return fail();
+
+        switch (op) {
+            case AstExprBinary::Op::Add:
+            case AstExprBinary::Op::Sub:
+            case AstExprBinary::Op::Mul:
+            case AstExprBinary::Op::Div:
+            case AstExprBinary::Op::FloorDiv:
+            case AstExprBinary::Op::Mod:
+            case AstExprBinary::Op::Pow:
+                return makeNumber(solveBinary(op, left.number, right.number));
+
+            default:
+                return fail();
+        };
+    };
+
+    Value binary(AstExprBinary::Op op, const Value& left, const Value& right) {
+        switch (op) {
+            case AstExprBinary::Op::Concat: {
+                std::string result;
+                for (const Value* value : { &left, &right }) {
+                    if (value->kind == Value::Kind::String)
+                        result.append(*value->string);
+                    else if (value->kind == Value::Kind::Number)
+                        result.append(numberToString(value->number));
+                    else
+                        return fail();
+                };
+
+                return makeString(std::move(result));
+            };
+
+            case AstExprBinary::Op::CompareEq:
+            case AstExprBinary::Op::CompareNe: {
+                bool equal;
+                if (left.kind != right.kind)
+                    equal = false;
+                else {
+                    switch (left.kind) {
+                        case Value::Kind::Nil:
+                            equal = true;
+                            break;
+                        case Value::Kind::Bool:
+                            equal = left.boolean == right.boolean;
+                            break;
+                        case Value::Kind::Number:
+                            equal = left.number == right.number;
+                            break;
+                        case Value::Kind::String:
+                            equal = *left.string == *right.string;
+                            break;
+                        case Value::Kind::Table:
+                            equal = left.table == right.table;
+                            break;
+
+                        default:
+                            // luau can share closures that have no upvalues, so identity isn't known here
+                            return fail();
+                    };
+                };
+
+                return makeBool(op == AstExprBinary::Op::CompareEq ? equal : !equal);
+            };
+
+            case AstExprBinary::Op::CompareLt:
+            case AstExprBinary::Op::CompareLe:
+            case AstExprBinary::Op::CompareGt:
+            case AstExprBinary::Op::CompareGe: {
+                // a > b is b < a, and nan makes every one of them false
+                bool swap = op == AstExprBinary::Op::CompareGt || op == AstExprBinary::Op::CompareGe;
+                bool or_equal = op == AstExprBinary::Op::CompareLe || op == AstExprBinary::Op::CompareGe;
+                const Value& a = swap ? right : left;
+                const Value& b = swap ? left : right;
+
+                if (a.kind == Value::Kind::Number && b.kind == Value::Kind::Number)
+                    return makeBool(or_equal ? a.number <= b.number : a.number < b.number);
+                if (a.kind == Value::Kind::String && b.kind == Value::Kind::String) {
+                    int compared = a.string->compare(*b.string);
+                    return makeBool(or_equal ? compared <= 0 : compared < 0);
+                };
+
+                return fail();
+            };
+
+            default:
+                return arithmetic(op, left, right);
+        };
+    };
+
+    Value fromInterpreted(const Interpreted& constant) {
+        switch (constant.type) {
+            case Interpreted::Nil:
+                return {};
+            case Interpreted::Bool:
+                return makeBool(constant.bool_result);
+            case Interpreted::Number:
+                return makeNumber(constant.number_result);
+            case Interpreted::String:
+                return makeString(constant.string_result);
+        };
+
+        return {};
+    };
+
+    Value fromBound(const BoundLocal& bound) {
+        Value value;
+        switch (bound.kind) {
+            case BoundLocal::Constant:
+                return fromInterpreted(bound.constant);
+            case BoundLocal::Builtin:
+                value.kind = Value::Kind::Builtin;
+                value.builtin = bound.builtin;
+                break;
+            case BoundLocal::Library:
+                value.kind = Value::Kind::Library;
+                value.library = bound.library;
+                break;
+            case BoundLocal::Function:
+                // declared at the top of the chunk as far as the interpreter knows, its upvalues have to be bound too
+                if (!charge(sizeof(ClosureValue)))
+                    return {};
+                closures.push_back({ bound.function, nullptr });
+                value.kind = Value::Kind::Closure;
+                value.closure = &closures.back();
+                break;
+            case BoundLocal::Table:
+                // only read through bound items, there's no table to hand out
+                return fail();
+        };
+
+        return value;
+    };
+
+    // t[i] of a table bound outside whatever is being run, straight from its items
+    Value getBoundIndex(const BoundLocal& bound, AstExprIndexExpr* expr) {
+        Value key = eval(expr->index);
+        if (failed || (bound.shuffled && bound.shuffles.encloses(expr->location)) || key.kind != Value::Kind::Number
+            || !isInteger(key.number) || key.number < 1 || key.number > bound.items.size())
+            return fail();
+
+        return fromInterpreted(bound.items[(size_t) key.number - 1]);
+    };
+
+    Value eval(AstExpr* expr) {
+        if (!step())
+            return {};
+
+        if (AstExprGroup* expr_group = expr->as<AstExprGroup>())
+            return eval(expr_group->expr);
+        else if (AstExprTypeAssertion* expr_type_assertion = expr->as<AstExprTypeAssertion>())
+            return eval(expr_type_assertion->expr);
+        else if (expr->is<AstExprConstantNil>())
+            return {};
+        else if (AstExprConstantBool* expr_bool = expr->as<AstExprConstantBool>())
+            return makeBool(expr_bool->value);
+        else if (AstExprConstantNumber* expr_number = expr->as<AstExprConstantNumber>())
+            return makeNumber(expr_number->value);
+        else if (AstExprConstantString* expr_string = expr->as<AstExprConstantString>())
+            return makeString(std::string(expr_string->value.data, expr_string->value.size));
+        else if (AstExprLocal* expr_local = expr->as<AstExprLocal>()) {
+            if (Value* value = lookup(expr_local->local))
+                return *value;
+
+            auto it = bound_locals.find(expr_local->local);
+            return it == bound_locals.end() ? fail() : fromBound(it->second);
+        } else if (AstExprGlobal* expr_global = expr->as<AstExprGlobal>()) {
+            uint32_t global = getTrustedGlobal(expr_global->name.value);
+            if (!(global & trusted_globals))
+                return fail();
+
+            Value value;
+            if (global == TrustSelect || global == TrustIpairs) {
+                value.kind = Value::Kind::Builtin;
+                value.builtin = global == TrustSelect ? Builtin::Select : Builtin::Ipairs;
+            } else {
+                value.kind = Value::Kind::Library;
+                value.library = global;
+            };
+            return value;
+        } else if (expr->is<AstExprVarargs>() || expr->is<AstExprCall>()) {
+            std::vector<Value> values = evalMulti(expr);
+            return values.empty() ? Value() : values[0];
+        } else if (AstExprIndexName* expr_index_name = expr->as<AstExprIndexName>()) {
+            Value object = eval(expr_index_name->expr);
+            return failed ? Value() : get(object, makeString(expr_index_name->index.value));
+        } else if (AstExprIndexExpr* expr_index_expr = expr->as<AstExprIndexExpr>()) {
+            if (AstExprLocal* expr_local = expr_index_expr->expr->as<AstExprLocal>(); expr_local && !lookup(expr_local->local)) {
+                auto it = bound_locals.find(expr_local->local);
+                if (it != bound_locals.end() && it->second.kind == BoundLocal::Table)
+                    return getBoundIndex(it->second, expr_index_expr);
+            };
+
+            Value object = eval(expr_index_expr->expr);
+            Value key = eval(expr_index_expr->index);
+            return failed ? Value() : get(object, key);
+        } else if (AstExprFunction* expr_function = expr->as<AstExprFunction>()) {
+            if (!charge(sizeof(ClosureValue)))
+                return {};
+
+            closures.push_back({ expr_function, scope });
+            Value value;
+            value.kind = Value::Kind::Closure;
+            value.closure = &closures.back();
+            return value;
+        } else if (AstExprTable* expr_table = expr->as<AstExprTable>())
+            return evalTable(expr_table);
+        else if (AstExprUnary* expr_unary = expr->as<AstExprUnary>()) {
+            Value operand = eval(expr_unary->expr);
+            if (failed)
+                return {};
+
+            switch (expr_unary->op) {
+                case AstExprUnary::Op::Not:
+                    return makeBool(!isTruthy(operand));
+                case AstExprUnary::Op::Minus:
+                    return operand.kind == Value::Kind::Number ? makeNumber(-operand.number) : fail();
+                case AstExprUnary::Op::Len:
+                    if (operand.kind == Value::Kind::String)
+                        return makeNumber((double) operand.string->size());
+                    if (operand.kind == Value::Kind::Table && operand.table->array_nils == 0)
+                        return makeNumber((double) operand.table->array.size());
+                    return fail();
+
+                default:
+                    return fail();
+            };
+        } else if (AstExprBinary* expr_binary = expr->as<AstExprBinary>()) {
+            Value left = eval(expr_binary->left);
+            if (failed)
+                return {};
+
+            if (expr_binary->op == AstExprBinary::Op::And)
+                return isTruthy(left) ? eval(expr_binary->right) : left;
+            if (expr_binary->op == AstExprBinary::Op::Or)
+                return isTruthy(left) ? left : eval(expr_binary->right);
+
+            Value right = eval(expr_binary->right);
+            return failed ? Value() : binary(expr_binary->op, left, right);
+        } else if (AstExprIfElse* expr_if_else = expr->as<AstExprIfElse>()) {
+            Value condition = eval(expr_if_else->condition);
+            if (failed)
+                return {};
+
+            return eval(isTruthy(condition) ? expr_if_else->trueExpr : expr_if_else->falseExpr);
+        };
+
+        return fail();
+    };
+
+    Value evalTable(AstExprTable* expr_table) {
+        if (!charge(sizeof(TableValue)))
+            return {};
+
+        tables.emplace_back();
+        Value table;
+        table.kind = Value::Kind::Table;
+        table.table = &tables.back();
+
+        // the list items are stored after everything else, like luau's SETLIST does, so a [n] = that one of
+        // them overwrites would depend on batching. that case isn't folded
+        std::vector<Value> list;
+        size_t size = expr_table->items.size;
+        for (size_t index = 0; index < size && !failed; index++) {
+            const AstExprTable::Item& item = expr_table->items.data[index];
+            if (item.kind == AstExprTable::Item::List) {
+                if (index + 1 == size) {
+                    std::vector<Value> last = evalMulti(item.value);
+                    list.insert(list.end(), last.begin(), last.end());
+                } else
+                    list.push_back(eval(item.value));
+                continue;
+            };
+
+            Value key = eval(item.key);
+            Value value = eval(item.value);
+            if (!failed)
+                set(table, key, value);
+        };
+
+        for (size_t index = 0; index < list.size() && !failed; index++) {
+            Value key = makeNumber((double) index + 1);
+            if (get(table, key).kind != Value::Kind::Nil)
+                return fail();
+
+            set(table, key, list[index]);
+        };
+
+        return failed ? Value() : table;
+    };
+
+    void assign(AstExpr* target, const Value& value) {
+        if (AstExprLocal* expr_local = target->as<AstExprLocal>()) {
+            Value* slot = lookup(expr_local->local);
+            if (!slot)
+                return (void) fail();
+
+            *slot = value;
+        } else if (AstExprIndexName* expr_index_name = target->as<AstExprIndexName>()) {
+            Value object = eval(expr_index_name->expr);
+            if (!failed)
+                set(object, makeString(expr_index_name->index.value), value);
+        } else if (AstExprIndexExpr* expr_index_expr = target->as<AstExprIndexExpr>()) {
+            Value object = eval(expr_index_expr->expr);
+            Value key = eval(expr_index_expr->index);
+            if (!failed)
+                set(object, key, value);
+        } else
+            fail();
+    };
+
+    Flow execBody(AstStatBlock* block) {
+        for (AstStat* stat : block->body) {
+            Flow flow = exec(stat);
+            if (failed || flow != Flow::Normal)
+                return flow;
+        };
+
+        return Flow::Normal;
+    };
+
+    // a block with a scope of its own
+    Flow exec(AstStatBlock* block) {
+        Scope* outer_scope = scope;
+        size_t closure_count = closures.size();
+        if (!pushScope())
+            return Flow::Normal;
+
+        Flow flow = execBody(block);
+        popScope(outer_scope, closure_count);
+        return flow;
+    };
+
+    Flow exec(AstStat* stat) {
+        if (!step())
+            return Flow::Normal;
+
+        if (AstStatBlock* stat_block = stat->as<AstStatBlock>())
+            return exec(stat_block);
+        else if (AstStatLocal* stat_local = stat->as<AstStatLocal>()) {
+            std::vector<Value> values = evalList(stat_local->values);
+            for (size_t index = 0; index < stat_local->vars.size && !failed; index++)
+                declare(stat_local->vars.data[index], index < values.size() ? values[index] : Value());
+        } else if (AstStatAssign* stat_assign = stat->as<AstStatAssign>()) {
+            std::vector<Value> values = evalList(stat_assign->values);
+            for (size_t index = 0; index < stat_assign->vars.size && !failed; index++)
+                assign(stat_assign->vars.data[index], index < values.size() ? values[index] : Value());
+        } else if (AstStatCompoundAssign* stat_compound_assign = stat->as<AstStatCompoundAssign>()) {
+            Value current = eval(stat_compound_assign->var);
+            Value operand = eval(stat_compound_assign->value);
+            if (!failed) {
+                Value value = binary(stat_compound_assign->op, current, operand);
+                if (!failed)
+                    assign(stat_compound_assign->var, value);
+            };
+        } else if (AstStatIf* stat_if = stat->as<AstStatIf>()) {
+            Value condition = eval(stat_if->condition);
+            if (failed)
+                return Flow::Normal;
+
+            if (isTruthy(condition))
+                return exec(stat_if->thenbody);
+            else if (stat_if->elsebody)
+                return exec(stat_if->elsebody);
+        } else if (AstStatWhile* stat_while = stat->as<AstStatWhile>()) {
+            while (true) {
+                Value condition = eval(stat_while->condition);
+                if (failed || !isTruthy(condition))
+                    break;
+
+                Flow flow = exec(stat_while->body);
+                if (failed || flow == Flow::Break)
+                    break;
+                if (flow == Flow::Return)
+                    return flow;
+            };
+        } else if (AstStatRepeat* stat_repeat = stat->as<AstStatRepeat>()) {
+            while (true) {
+                // until can see the locals of the body
+                Scope* outer_scope = scope;
+                size_t closure_count = closures.size();
+                if (!pushScope())
+                    break;
+
+                Flow flow = execBody(stat_repeat->body);
+                Value condition;
+                if (!failed && flow != Flow::Break && flow != Flow::Return)
+                    condition = eval(stat_repeat->condition);
+                popScope(outer_scope, closure_count);
+
+                if (flow == Flow::Return)
+                    return flow;
+                if (failed || flow == Flow::Break || isTruthy(condition))
+                    break;
+            };
+        } else if (AstStatFor* stat_for = stat->as<AstStatFor>()) {
+            Value from = eval(stat_for->from);
+            Value to = eval(stat_for->to);
+            Value step = stat_for->step ? eval(stat_for->step) : makeNumber(1);
+            if (failed)
+                return Flow::Normal;
+
+            if (from.kind != Value::Kind::Number || to.kind != Value::Kind::Number || step.kind != Value::Kind::Number
+                || step.number == 0 || std::isnan(step.number)) {
+                fail();
+                return Flow::Normal;
+            };
+
+            for (double index = from.number; step.number > 0 ? index <= to.number : index >= to.number; index += step.number) {
+                Scope* outer_scope = scope;
+                size_t closure_count = closures.size();
+                if (!pushScope())
+                    break;
+
+                declare(stat_for->var, makeNumber(index));
+                Flow flow = execBody(stat_for->body);
+                popScope(outer_scope, closure_count);
+
+                if (failed || flow == Flow::Break)
+                    break;
+                if (flow == Flow::Return)
+                    return flow;
+            };
+        } else if (AstStatForIn* stat_for_in = stat->as<AstStatForIn>()) {
+            // only for i, v in ipairs(t), which goes until the first nil and sees what the body changes
+            AstExprCall* iterator = stat_for_in->values.size == 1 ? stat_for_in->values.data[0]->as<AstExprCall>() : nullptr;
+            if (!iterator || iterator->self || iterator->args.size != 1) {
+                fail();
+                return Flow::Normal;
+            };
+
+            Value callee = eval(iterator->func);
+            Value table = eval(iterator->args.data[0]);
+            if (failed || callee.kind != Value::Kind::Builtin || callee.builtin != Builtin::Ipairs || table.kind != Value::Kind::Table) {
+                fail();
+                return Flow::Normal;
+            };
+
+            for (double index = 1;; index++) {
+                Value value = get(table, makeNumber(index));
+                if (failed || value.kind == Value::Kind::Nil)
+                    break;
+
+                Scope* outer_scope = scope;
+                size_t closure_count = closures.size();
+                if (!pushScope())
+                    break;
+
+                for (size_t var = 0; var < stat_for_in->vars.size; var++)
+                    declare(stat_for_in->vars.data[var], var == 0 ? makeNumber(index) : var == 1 ? value : Value());
+                Flow flow = execBody(stat_for_in->body);
+                popScope(outer_scope, closure_count);
+
+                if (failed || flow == Flow::Break)
+                    break;
+                if (flow == Flow::Return)
+                    return flow;
+            };
+        } else if (AstStatReturn* stat_return = stat->as<AstStatReturn>()) {
+            returned = evalList(stat_return->list);
+            return Flow::Return;
+        } else if (stat->is<AstStatBreak>())
+            return Flow::Break;
+        else if (stat->is<AstStatContinue>())
+            return Flow::Continue;
+        else if (AstStatExpr* stat_expr = stat->as<AstStatExpr>())
+            evalMulti(stat_expr->expr);
+        else if (AstStatLocalFunction* stat_local_function = stat->as<AstStatLocalFunction>()) {
+            // declared first, the function can call itself
+            declare(stat_local_function->name, {});
+            Value function = eval(stat_local_function->func);
+            if (Value* slot = failed ? nullptr : lookup(stat_local_function->name))
+                *slot = function;
+        } else if (AstStatFunction* stat_function = stat->as<AstStatFunction>()) {
+            Value function = eval(stat_function->func);
+            if (!failed)
+                assign(stat_function->name, function);
+        } else
+            fail();
+
+        return Flow::Normal;
+    };
+};
+
+AstExpr* skipGroups(AstExpr* expr) {
+    while (AstExprGroup* expr_group = expr->as<AstExprGroup>())
+        expr = expr_group->expr;
+
+    return expr;
+};
+
+bool isTrustedGlobal(AstExpr* expr) {
+    AstExprGlobal* global = skipGroups(expr)->as<AstExprGlobal>();
+    return global && (getTrustedGlobal(global->name.value) & trusted_globals);
+};
+
+// the library globals of the chunk, and whether anything could change them. a library that is assigned,
+// has a field assigned or is used other than by indexing it (passed to rawset, put in a table) is out, and so
+// is everything once the environment itself is reachable. local s = string makes s stand for the library.
+// it also notes which locals are read, which are assigned after their declaration, and which are used other
+// than by reading t[...] from them
+enum : uint8_t {
+    LocalUsed = 1,
+    LocalAssigned = 2,
+    LocalEscaped = 4, // read as a value of its own
+    LocalMutated = 8 // t[...] = assigned
+};
+
+// whether stat could reorder the table local holds, by assigning t[...] or handing t to a function
+struct ShuffleVisitor : AstVisitor {
+    AstLocal* local;
+    bool shuffles = false;
+
+    ShuffleVisitor(AstLocal* local)
+        : local(local) {};
+
+    bool isTable(AstExpr* expr) {
+        AstExprLocal* expr_local = skipGroups(expr)->as<AstExprLocal>();
+        return expr_local && expr_local->local == local;
+    };
+
+    bool visit(AstStatAssign* node) override {
+        for (AstExpr* var : node->vars)
+            if (AstExprIndexExpr* index_expr = var->as<AstExprIndexExpr>())
+                shuffles |= isTable(index_expr->expr);
+        return !shuffles;
+    };
+
+    bool visit(AstExprCall* node) override {
+        for (AstExpr* arg : node->args)
+            shuffles |= isTable(arg);
+        return !shuffles;
+    };
+};
+
+bool isShuffle(AstStat* stat, AstLocal* local) {
+    if (!stat->is<AstStatBlock>() && !stat->is<AstStatFor>() && !stat->is<AstStatForIn>() && !stat->is<AstStatWhile>()
+        && !stat->is<AstStatRepeat>() && !stat->is<AstStatAssign>() && !stat->is<AstStatExpr>() && !stat->is<AstStatIf>())
+        return false;
+
+    ShuffleVisitor visitor(local);
+    stat->visit(&visitor);
+    return visitor.shuffles;
+};
+
+struct GlobalUseVisitor : AstVisitor {
+    uint32_t changed = 0;
+    std::unordered_map<AstLocal*, uint32_t> aliases;
+    std::unordered_map<AstLocal*, uint8_t> locals;
+    // the statements right after local t = { ... } that reorder it, which are run when t is bound
+    std::unordered_map<AstLocal*, std::vector<AstStat*>> shuffles;
+
+    uint32_t getLibrary(AstExpr* expr) {
+        expr = skipGroups(expr);
+        if (AstExprLocal* expr_local = expr->as<AstExprLocal>()) {
+            auto it = aliases.find(expr_local->local);
+            return it == aliases.end() ? 0 : it->second;
+        };
+
+        AstExprGlobal* global = expr->as<AstExprGlobal>();
+        uint32_t bit = global ? getTrustedGlobal(global->name.value) : 0;
+        return bit == TrustSelect || bit == TrustIpairs ? 0 : bit;
+    };
+
+    void assigned(AstExpr* target) {
+        if (AstExprGlobal* global = target->as<AstExprGlobal>())
+            changed |= getTrustedGlobal(global->name.value);
+        else if (AstExprLocal* expr_local = target->as<AstExprLocal>())
+            locals[expr_local->local] |= LocalAssigned;
+        else if (AstExprIndexName* index_name = target->as<AstExprIndexName>())
+            changed |= getLibrary(index_name->expr);
+        else if (AstExprIndexExpr* index_expr = target->as<AstExprIndexExpr>()) {
+            changed |= getLibrary(index_expr->expr);
+            if (AstExprLocal* object = skipGroups(index_expr->expr)->as<AstExprLocal>())
+                locals[object->local] |= LocalMutated;
+        };
+    };
+
+    bool visit(AstExprGlobal* node) override {
+        const char* name = node->name.value;
+        changed |= getLibrary(node);
+        if (strcmp(name, "getfenv") == 0 || strcmp(name, "setfenv") == 0 || strcmp(name, "_G") == 0)
+            changed = ~0u;
+        // getmetatable("").__index is the string library
+        else if (strcmp(name, "getmetatable") == 0)
+            changed |= TrustString;
+        return false;
+    };
+
+    bool visit(AstExprLocal* node) override {
+        locals[node->local] |= LocalUsed | LocalEscaped;
+        changed |= getLibrary(node);
+        return false;
+    };
+
+    // indexing a library doesn't let it escape, but an alias local doing it is still read
+    bool isLibraryBase(AstExpr* expr) {
+        if (!getLibrary(expr))
+            return false;
+
+        if (AstExprLocal* expr_local = skipGroups(expr)->as<AstExprLocal>())
+            locals[expr_local->local] |= LocalUsed;
+        return true;
+    };
+
+    bool visit(AstExprIndexName* node) override {
+        return !isLibraryBase(node->expr);
+    };
+
+    bool visit(AstExprIndexExpr* node) override {
+        if (AstExprLocal* object = skipGroups(node->expr)->as<AstExprLocal>(); object && !getLibrary(object))
+            locals[object->local] |= LocalUsed;
+        else if (!isLibraryBase(node->expr))
+            return true;
+
+        node->index->visit(this);
+        return false;
+    };
+
+    bool visit(AstStatBlock* node) override {
+        for (size_t index = 0; index < node->body.size; index++) {
+            AstStat* stat = node->body.data[index];
+            stat->visit(this);
+
+            AstStatLocal* stat_local = stat->as<AstStatLocal>();
+            if (!stat_local || stat_local->vars.size != 1 || stat_local->values.size != 1 || !skipGroups(stat_local->values.data[0])->is<AstExprTable>())
+                continue;
+
+            // what they do with the table doesn't count, it only escapes or changes if they can't be run
+            AstLocal* table = stat_local->vars.data[0];
+            std::vector<AstStat*> table_shuffles;
+            while (index + 1 < node->body.size && table_shuffles.size() < interpret_max_shuffles && isShuffle(node->body.data[index + 1], table)) {
+                uint8_t flags = locals[table];
+                table_shuffles.push_back(node->body.data[++index]);
+                table_shuffles.back()->visit(this);
+                locals[table] = flags;
+            };
+
+            if (!table_shuffles.empty())
+                shuffles[table] = std::move(table_shuffles);
+        };
+
+        return false;
+    };
+
+    bool visit(AstStatLocal* node) override {
+        for (size_t index = 0; index < node->values.size; index++) {
+            AstExpr* value = node->values.data[index];
+            uint32_t library = index < node->vars.size ? getLibrary(value) : 0;
+            if (library)
+                aliases[node->vars.data[index]] = library;
+            else
+                value->visit(this);
+        };
+
+        return false;
+    };
+
+    bool visit(AstStatAssign* node) override {
+        for (AstExpr* var : node->vars)
+            assigned(var);
+        return true;
+    };
+
+    bool visit(AstStatCompoundAssign* node) override {
+        assigned(node->var);
+        return true;
+    };
+
+    bool visit(AstStatFunction* node) override {
+        assigned(node->name);
+        return true;
+    };
+};
+
+std::optional<Interpreted> toInterpreted(const Value& value) {
+    switch (value.kind) {
+        case Value::Kind::Nil:
+            return Interpreted{ Interpreted::Nil, false, 0, {} };
+        case Value::Kind::Bool:
+            return Interpreted{ Interpreted::Bool, value.boolean, 0, {} };
+        case Value::Kind::Number:
+            return Interpreted{ Interpreted::Number, false, value.number, {} };
+        case Value::Kind::String:
+            return Interpreted{ Interpreted::String, false, 0, *value.string };
+
+        default:
+            return std::nullopt;
+    };
+};
+
+// binds the locals that are read but never assigned after their declaration to what they're declared with,
+// when that's a constant, a builtin, a library, a list of constants only ever indexed or (outside of
+// incremental runs) a function. the chunk is walked in order, so whatever a declaration uses was bound before it
+struct BindingVisitor : AstVisitor {
+    const std::unordered_map<AstLocal*, uint8_t>& locals;
+    const std::unordered_map<AstLocal*, std::vector<AstStat*>>& shuffles;
+    // cached text is keyed on the tokens of a subtree and what the locals it reads are bound to. a function
+    // can't be summed up there, so they're only bound without a cache
+    bool bind_functions = !isIncremental();
+
+    BindingVisitor(const std::unordered_map<AstLocal*, uint8_t>& locals, const std::unordered_map<AstLocal*, std::vector<AstStat*>>& shuffles)
+        : locals(locals)
+        , shuffles(shuffles) {};
+
+    static uint64_t hashConstant(uint64_t digest, const Interpreted& constant) {
+        digest = hashDigest(digest, &constant.type, sizeof(constant.type));
+        digest = hashDigest(digest, &constant.bool_result, sizeof(bool));
+        digest = hashDigest(digest, &constant.number_result, sizeof(double));
+        return hashDigest(digest, constant.string_result.data(), constant.string_result.size());
+    };
+
+    // the list the table holds once its shuffles ran, with every slot a constant and no other keys
+    bool bindTable(AstLocal* local, AstExpr* value, BoundLocal& bound) {
+        Interpreter interpreter;
+        interpreter.max_steps = interpret_max_table_steps;
+        interpreter.max_bytes = interpret_max_table_bytes;
+        if (!interpreter.pushScope())
+            return false;
+        interpreter.declare(local, interpreter.eval(value));
+
+        auto it = shuffles.find(local);
+        if (it != shuffles.end()) {
+            for (AstStat* stat : it->second)
+                if (interpreter.exec(stat) != Flow::Normal)
+                    interpreter.fail();
+
+            bound.shuffled = true;
+            bound.shuffles = Location(it->second.front()->location, it->second.back()->location);
+        };
+
+        Value* table = interpreter.failed ? nullptr : interpreter.lookup(local);
+        if (!table || table->kind != Value::Kind::Table)
+            return false;
+
+        const TableValue& items = *table->table;
+        if (!items.numbers.empty() || !items.strings.empty() || items.true_value.kind != Value::Kind::Nil
+            || items.false_value.kind != Value::Kind::Nil)
+            return false;
+
+        bound.kind = BoundLocal::Table;
+        bound.items.reserve(items.array.size());
+        for (const Value& item : items.array) {
+            std::optional<Interpreted> constant = toInterpreted(item);
+            if (!constant)
+                return false;
+            bound.items.push_back(std::move(*constant));
+        };
+
+        return true;
+    };
+
+    void bind(AstLocal* local, BoundLocal& bound) {
+        uint64_t digest = hashDigest(fnv_offset_basis, &bound.kind, sizeof(bound.kind));
+        switch (bound.kind) {
+            case BoundLocal::Constant:
+                digest = hashConstant(digest, bound.constant);
+                break;
+            case BoundLocal::Table:
+                for (const Interpreted& item : bound.items)
+                    digest = hashConstant(digest, item);
+                digest = hashDigest(digest, &bound.shuffled, sizeof(bool));
+                digest = hashDigest(digest, &bound.shuffles, sizeof(Location));
+                break;
+            case BoundLocal::Builtin:
+                digest = hashDigest(digest, &bound.builtin, sizeof(bound.builtin));
+                break;
+            case BoundLocal::Library:
+                digest = hashDigest(digest, &bound.library, sizeof(bound.library));
+                break;
+            case BoundLocal::Function:
+                break;
+        };
+
+        bound.digest = digest;
+        bound_locals[local] = std::move(bound);
+    };
+
+    void bind(AstLocal* local, AstExpr* value) {
+        auto it = locals.find(local);
+        if (it == locals.end() || !(it->second & LocalUsed) || (it->second & LocalAssigned))
+            return;
+
+        BoundLocal bound = {};
+        AstExpr* root = skipGroups(value);
+        if (root->is<AstExprTable>()) {
+            if ((it->second & (LocalEscaped | LocalMutated)) || !bindTable(local, value, bound))
+                return;
+        } else if (AstExprFunction* expr_function = root->as<AstExprFunction>()) {
+            if (!bind_functions)
+                return;
+
+            bound.kind = BoundLocal::Function;
+            bound.function = expr_function;
+        } else if (AstExprCall* expr_call = root->as<AstExprCall>()) {
+            const Interpreted* interpreted = interpretCall(expr_call);
+            if (!interpreted)
+                return;
+
+            bound.kind = BoundLocal::Constant;
+            bound.constant = *interpreted;
+        } else {
+            Interpreter interpreter;
+            Value result = interpreter.eval(value);
+            if (interpreter.failed)
+                return;
+
+            if (result.kind == Value::Kind::Builtin) {
+                bound.kind = BoundLocal::Builtin;
+                bound.builtin = result.builtin;
+            } else if (result.kind == Value::Kind::Library) {
+                bound.kind = BoundLocal::Library;
+                bound.library = result.library;
+            } else if (std::optional<Interpreted> constant = toInterpreted(result)) {
+                bound.kind = BoundLocal::Constant;
+                bound.constant = std::move(*constant);
+            } else
+                return;
+        };
+
+        bind(local, bound);
+    };
+
+    bool visit(AstStatLocal* node) override {
+        for (size_t index = 0; index < node->vars.size && index < node->values.size; index++)
+            bind(node->vars.data[index], node->values.data[index]);
+        return true;
+    };
+
+    bool visit(AstStatLocalFunction* node) override {
+        bind(node->name, node->func);
+        return true;
+    };
+};
+
+void resetInterpret() {
+    trusted_globals = 0;
+    bound_locals.clear();
+    interpreted_calls.clear();
+};
+
+uint64_t prepareInterpret(AstStatBlock* root) {
+    resetInterpret();
+
+    GlobalUseVisitor uses;
+    root->visit(&uses);
+    trusted_globals = (TrustSelect | TrustString | TrustMath | TrustBit32 | TrustIpairs) & ~uses.changed;
+
+    BindingVisitor bindings(uses.locals, uses.shuffles);
+    root->visit(&bindings);
+
+    return hashDigest(fnv_offset_basis, &trusted_globals, sizeof(trusted_globals));
+};
+
+uint64_t getBindingDigest(AstLocal* local) {
+    auto it = bound_locals.find(local);
+    return it == bound_locals.end() ? 0 : it->second.digest;
+};
+
+const Interpreted* getBoundConstant(AstLocal* local) {
+    auto it = bound_locals.find(local);
+    if (it == bound_locals.end() || it->second.kind != BoundLocal::Constant)
+        return nullptr;
+
+    return &it->second.constant;
+};
+
+bool isBoundTable(AstExprIndexExpr* expr) {
+    AstExprLocal* expr_local = skipGroups(expr->expr)->as<AstExprLocal>();
+    auto it = expr_local ? bound_locals.find(expr_local->local) : bound_locals.end();
+    return it != bound_locals.end() && it->second.kind == BoundLocal::Table
+        && !(it->second.shuffled && it->second.shuffles.encloses(expr->location));
+};
+
+const Interpreted* getBoundItem(AstExprIndexExpr* expr, double index) {
+    if (!isBoundTable(expr) || !isInteger(index) || index < 1)
+        return nullptr;
+
+    const BoundLocal& bound = bound_locals.find(skipGroups(expr->expr)->as<AstExprLocal>()->local)->second;
+    return index <= bound.items.size() ? &bound.items[(size_t) index - 1] : nullptr;
+};
+
+bool isBound(AstExpr* expr) {
+    AstExprLocal* expr_local = skipGroups(expr)->as<AstExprLocal>();
+    return expr_local && bound_locals.count(expr_local->local);
+};
+
+// only calls whose callee is known without running anything are worth a try: a function written right
+// there, a builtin or a bound local, or a method of a string constant (or of another such call)
+bool isKnownCall(AstExprCall* call) {
+    AstExpr* func = skipGroups(call->func);
+    if (AstExprIndexName* index_name = func->as<AstExprIndexName>()) {
+        AstExpr* object = skipGroups(index_name->expr);
+        if (isTrustedGlobal(object) || isBound(object))
+            return true;
+
+        AstExprCall* object_call = object->as<AstExprCall>();
+        return call->self && (object->is<AstExprConstantString>() || (object_call && isKnownCall(object_call)));
+    } else if (AstExprIndexExpr* index_expr = func->as<AstExprIndexExpr>())
+        return isTrustedGlobal(index_expr->expr) || isBound(index_expr->expr);
+
+    return func->is<AstExprFunction>() || isTrustedGlobal(func) || isBound(func);
+};
+
+const Interpreted* interpretCall(AstExprCall* call) {
+    auto it = interpreted_calls.find(call);
+    if (it != interpreted_calls.end())
+        return it->second ? &*it->second : nullptr;
+
+    std::optional<Interpreted> result;
+    if (isKnownCall(call)) {
+        Interpreter interpreter;
+        std::vector<Value> values = interpreter.evalMulti(call);
+        if (!interpreter.failed && values.size() == 1)
+            result = toInterpreted(values[0]);
+    };
+
+    it = interpreted_calls.emplace(call, std::move(result)).first;
+    return it->second ? &*it->second : nullptr;
+};
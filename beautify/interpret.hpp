@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "Luau/Ast.h"
+
+#include "hash.hpp"
+
+// a small interpreter for calls that do pure work on constants, like the string decoders obfuscators wrap in
+// (function(s) ... end)("..."). anything it doesn't know (upvalues from outside the call, globals other than
+// the builtins, generic for loops other than ipairs, metatables) makes it give up, and so does running past a
+// budget
+constexpr size_t interpret_max_steps = 100000; // statements and expressions evaluated
+constexpr size_t interpret_max_depth = 64; // nested calls
+constexpr size_t interpret_max_bytes = 1024 * 1024; // strings, table slots, scopes and closures alive at once
+constexpr size_t interpret_max_string_bytes = 16 * 1024 * 1024; // strings made in total, s = s .. c is quadratic
+constexpr size_t interpret_max_shuffles = 8; // statements right after local t = { ... } that can reorder it
+// what building and shuffling a table of constants can take instead, they're often thousands of strings
+constexpr size_t interpret_max_table_steps = 1024 * 1024;
+constexpr size_t interpret_max_table_bytes = 16 * 1024 * 1024;
+
+struct Interpreted {
+    enum Type {
+        Nil,
+        Bool,
+        Number,
+        String
+    } type = Nil;
+    bool bool_result = false;
+    double number_result = 0;
+    std::string string_result;
+};
+
+// the globals the interpreter treats as luau's builtins, once prepareInterpret found nothing that changes them
+enum : uint32_t {
+    TrustSelect = 1,
+    TrustString = 2,
+    TrustMath = 4,
+    TrustBit32 = 8,
+    TrustIpairs = 16
+};
+
+// two linear passes over the chunk: which builtins nothing changes, then what every local that is never
+// assigned after its declaration is bound to. returns a digest of the builtins for the incremental seed, the
+// bindings are in the key of each subtree that reads them, see getBindingDigest
+uint64_t prepareInterpret(Luau::AstStatBlock* root);
+// forgets all of that and every memoized call, the AST they point into is going away
+void resetInterpret();
+
+// a digest of what prepareInterpret bound a local to, the same for two declarations bound to the same thing.
+// 0 when it isn't bound
+uint64_t getBindingDigest(Luau::AstLocal* local);
+// the constant a local holds everywhere, nullptr unless prepareInterpret bound it to one
+const Interpreted* getBoundConstant(Luau::AstLocal* local);
+// whether t[...] indexes a local bound to a list of constants, like the string tables obfuscators move every
+// string into. the list is what's left once the statements that shuffle it right after its declaration ran,
+// indexes inside those statements still see it unshuffled so they don't count
+bool isBoundTable(Luau::AstExprIndexExpr* expr);
+// the constant at t[index], from an array built once when the local was bound. nullptr past its ends
+const Interpreted* getBoundItem(Luau::AstExprIndexExpr* expr, double index);
+
+// the constant the call returns, only when it provably returns exactly that one value. memoized until the
+// next prepareInterpret or resetInterpret
+const Interpreted* interpretCall(Luau::AstExprCall* call);
+
+// what the parentheses around an expression hold, however many there are
+Luau::AstExpr* skipGroups(Luau::AstExpr* expr);
@@ -0,0 +1,79 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+// signed, blocks allocated before counting started (or by another thread) can be freed
+std::atomic<int64_t> heap_bytes = 0;
+std::atomic<int64_t> peak_heap_bytes = 0;
+thread_local int64_t thread_heap_bytes = 0;
+thread_local int64_t thread_peak_heap_bytes = 0;
+
+void setHeapCounting(bool enabled) {
+    heap_counting = enabled;
+};
+
+void countHeapAlloc(size_t bytes) {
+    thread_heap_bytes += bytes;
+    thread_peak_heap_bytes = std::max(thread_peak_heap_bytes, thread_heap_bytes);
+
+    int64_t total = heap_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = peak_heap_bytes.load(std::memory_order_relaxed);
+    while (total > peak && !peak_heap_bytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {}
+};
+
+void countHeapFree(size_t bytes) {
+    thread_heap_bytes -= bytes;
+    heap_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+};
+
+size_t getHeapBytes() {
+    return (size_t) std::max<int64_t>(0, heap_bytes.load(std::memory_order_relaxed));
+};
+
+size_t getPeakHeapBytes() {
+    return (size_t) std::max<int64_t>(0, peak_heap_bytes.load(std::memory_order_relaxed));
+};
+
+HeapScope::HeapScope() {
+    if (!heap_counting)
+        return;
+
+    active = true;
+    start = thread_heap_bytes;
+    outer_peak = thread_peak_heap_bytes;
+    thread_peak_heap_bytes = thread_heap_bytes;
+};
+
+HeapScope::~HeapScope() {
+    end();
+};
+
+size_t HeapScope::end() {
+    if (!active)
+        return 0;
+
+    active = false;
+    int64_t peak = thread_peak_heap_bytes;
+    thread_peak_heap_bytes = std::max(outer_peak, peak);
+    return peak > start ? (size_t) (peak - start) : 0;
+};
+
+long getPeakRssKb() {
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024; // bytes there
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+};
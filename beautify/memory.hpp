@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// heap accounting for --memory. the bytes are counted by the operator new and delete in heap.cpp, which
+// only the CLI links, so the library and wasm builds always see 0. nothing is counted until it's enabled
+inline bool heap_counting = false;
+void setHeapCounting(bool enabled);
+
+void countHeapAlloc(size_t bytes);
+void countHeapFree(size_t bytes);
+
+// what the whole process has allocated and not freed yet, and the most it ever had
+size_t getHeapBytes();
+size_t getPeakHeapBytes();
+
+// the most the calling thread allocated on top of what it had when the scope started. scopes nest, an
+// outer one still sees the peaks of the ones inside it. frees of memory another thread allocated count
+// against this one, so a scope is only meaningful around work that stays on one thread
+struct HeapScope {
+    int64_t start = 0;
+    int64_t outer_peak = 0;
+    bool active = false;
+
+    HeapScope();
+    ~HeapScope();
+
+    // the peak so far, the scope is over after the first call
+    size_t end();
+};
+
+// getrusage's high water mark of the whole process, 0 where it isn't available
+long getPeakRssKb();
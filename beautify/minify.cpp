@@ -42,8 +42,18 @@ for (type* obj : array) { \
     }; \
 }
 
-bool m_is_root = true; // aka is first minify call
-bool m_dont_append_do = false;
+thread_local bool m_is_root = true; // aka is first minify call
+thread_local bool m_dont_append_do = false;
+
+std::string minify(Luau::AstNode* node);
+
+// an index that folds is printed as a constant, which can't be indexed or called without parentheses
+std::string minifyPrefix(AstExpr* expr) {
+    if (expr->is<AstExprIndexExpr>() && isSolvable(expr))
+        return "(" + minify(expr) + ")";
+
+    return minify(expr);
+};
 
 std::string minify(Luau::AstNode* node) {
     std::string result = "";
@@ -72,17 +82,21 @@ std::string minify(Luau::AstNode* node) {
         } else if (AstExprVarargs* expr_varargs = expr->as<AstExprVarargs>()) {
             result = "...";
         } else if (AstExprCall* expr_call = expr->as<AstExprCall>()) {
-            result = minify(expr_call->func);
+            result = minifyPrefix(expr_call->func);
             tuple(expr_call->args, AstExpr);
         } else if (AstExprIndexName* expr_index_name = expr->as<AstExprIndexName>()) {
-            result = minify(expr_index_name->expr);
+            result = minifyPrefix(expr_index_name->expr);
             result.append(std::string{expr_index_name->op});
             result.append(expr_index_name->index.value);
         } else if (AstExprIndexExpr* expr_index_expr = expr->as<AstExprIndexExpr>()) {
-            result = minify(expr_index_expr->expr);
-            result.append("[");
-            result.append(minify(expr_index_expr->index));
-            result.append("]");
+            if (isSolvable(expr_index_expr)) {
+                appendSolve(expr_index_expr, minify);
+            } else {
+                result = minifyPrefix(expr_index_expr->expr);
+                result.append("[");
+                result.append(minify(expr_index_expr->index));
+                result.append("]");
+            };
         } else if (AstExprFunction* expr_function = expr->as<AstExprFunction>()) {
             result = "function";
             minifyFunction(expr_function);
@@ -167,6 +181,7 @@ std::string minify(Luau::AstNode* node) {
     } else if (AstStat* stat = node->asStat()) {
         if (AstStatBlock* stat2 = stat->as<AstStatBlock>()) {
             bool append_do = stat2->hasEnd && !m_dont_append_do;
+            bool is_root_block = m_is_root;
             if (m_is_root) {
                 append_do = false;
                 m_is_root = false;
@@ -179,6 +194,9 @@ std::string minify(Luau::AstNode* node) {
 
             for (AstStat* child : stat2->body) {
                 result.append(minify(child));
+
+                if (is_root_block && !emitOutput(result))
+                    break;
             };
 
             if (append_do) {
@@ -315,6 +333,9 @@ std::string minify(Luau::AstNode* node) {
 };
 
 std::string minifyRoot(Luau::AstStatBlock* root, bool nosolve, bool ignore_types) {
+    m_is_root = true;
+    m_dont_append_do = false;
+
     setupSolve(nosolve, ignore_types);
     return minify(root);
 };
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include "passes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Luau/TimeTrace.h"
+
+#include "cache.hpp"
+#include "predicates.hpp"
+#include "proxies.hpp"
+#include "solve.hpp"
+#include "stats.hpp"
+#include "unflatten.hpp"
+
+using namespace Luau;
+
+thread_local Allocator* pass_allocator = nullptr;
+thread_local AstStatBlock* pass_root = nullptr;
+
+template<typename T>
+AstArray<T> copyArray(const T* data, size_t size) {
+    T* copy = (T*) pass_allocator->allocate(sizeof(T) * size);
+    std::copy(data, data + size, copy);
+    return { copy, size };
+};
+
+// statements that take the place of others are spliced into the block, so the rewrites of the block can see
+// them on the next round
+void replaceBody(AstStatBlock* block, const std::vector<AstStat*>& body) {
+    block->body = copyArray(body.data(), body.size());
+};
+
+// a condition that folds, or one the ranges of the locals in it decide. those ranges come from assignments
+// anywhere in the chunk, outside of the tokens incremental runs cache a subtree by, so they're left out then
+std::optional<bool> getConditionTruthiness(AstExpr* condition) {
+    std::optional<bool> truthy = getTruthiness(condition);
+    if (truthy || isIncremental())
+        return truthy;
+
+    truthy = provePredicate(condition);
+    if (truthy)
+        countPass(OpaquePredicate);
+    return truthy;
+};
+
+// what's left of an if once the branches whose conditions fold are gone: one of its blocks, a shorter chain
+// of elseifs, or nothing
+AstStat* pruneIf(AstStatIf* stat_if) {
+    std::optional<bool> truthy = getConditionTruthiness(stat_if->condition);
+    if (!truthy) {
+        if (AstStatIf* else_if = stat_if->elsebody ? stat_if->elsebody->as<AstStatIf>() : nullptr)
+            stat_if->elsebody = pruneIf(else_if);
+        return stat_if;
+    };
+
+    if (*truthy)
+        return stat_if->thenbody;
+    else if (AstStatIf* else_if = stat_if->elsebody ? stat_if->elsebody->as<AstStatIf>() : nullptr)
+        return pruneIf(else_if);
+
+    return stat_if->elsebody;
+};
+
+bool alwaysExits(AstStat* stat) {
+    if (stat->is<AstStatReturn>() || stat->is<AstStatBreak>() || stat->is<AstStatContinue>())
+        return true;
+    else if (AstStatBlock* block = stat->as<AstStatBlock>())
+        return block->body.size > 0 && alwaysExits(block->body.data[block->body.size - 1]);
+    else if (AstStatIf* stat_if = stat->as<AstStatIf>())
+        return stat_if->elsebody && alwaysExits(stat_if->thenbody) && alwaysExits(stat_if->elsebody);
+
+    return false;
+};
+
+bool declaresLocals(AstStatBlock* block) {
+    for (AstStat* stat : block->body)
+        if (stat->is<AstStatLocal>() || stat->is<AstStatLocalFunction>() || stat->is<AstStatTypeAlias>())
+            return true;
+    return false;
+};
+
+// appends what's left of stat to body, returns true once nothing after it can run
+bool appendLive(std::vector<AstStat*>& body, AstStat* stat, bool& changed) {
+    if (AstStatIf* stat_if = stat->as<AstStatIf>()) {
+        AstStat* pruned = pruneIf(stat_if);
+        if (pruned != stat_if) {
+            countPass(DeadBranch);
+            changed = true;
+
+            // the branch that always runs takes the place of the if, in a do block when it has locals
+            if (!pruned)
+                return false;
+            else if (AstStatBlock* branch = pruned->as<AstStatBlock>()) {
+                if (!declaresLocals(branch)) {
+                    for (AstStat* branch_stat : branch->body)
+                        if (appendLive(body, branch_stat, changed))
+                            return true;
+                    return false;
+                };
+
+                stat = pass_allocator->alloc<AstStatBlock>(stat_if->location, branch->body, true);
+            } else
+                stat = pruned;
+        };
+    } else if (AstStatWhile* stat_while = stat->as<AstStatWhile>()) {
+        std::optional<bool> truthy = getConditionTruthiness(stat_while->condition);
+        if (truthy && !*truthy) {
+            countPass(DeadBranch);
+            changed = true;
+            return false;
+        };
+    };
+
+    if (AstStatBlock* block = stat->as<AstStatBlock>(); block && block->body.size == 0) {
+        countPass(DeadBranch);
+        changed = true;
+        return false;
+    };
+
+    body.push_back(stat);
+    return alwaysExits(stat);
+};
+
+// if true / if false / while false with any condition that folds, empty do blocks, and whatever follows a
+// return, break or continue (do return end is how one gets in the middle of a block)
+bool pruneDeadCode(AstStatBlock* block) {
+    std::vector<AstStat*> body;
+    bool changed = false;
+    for (size_t index = 0; index < block->body.size; index++) {
+        if (!appendLive(body, block->body.data[index], changed))
+            continue;
+
+        size_t unreachable = block->body.size - index - 1;
+        if (unreachable > 0) {
+            countStats(rewrites[(int) PassRule::Unreachable], unreachable);
+            changed = true;
+        };
+        break;
+    };
+
+    if (changed)
+        replaceBody(block, body);
+    return changed;
+};
+
+// the declarations of proxies whose every call is printed as the proxy's body instead
+bool dropUnusedProxies(AstStatBlock* block) {
+    std::vector<AstStat*> body;
+    bool changed = false;
+    for (AstStat* stat : block->body) {
+        if (!isUnusedProxy(stat)) {
+            body.push_back(stat);
+            continue;
+        };
+
+        countPass(UnusedProxy);
+        changed = true;
+    };
+
+    if (changed)
+        replaceBody(block, body);
+    return changed;
+};
+
+// the statements a dispatcher is replaced with are new, and incremental runs cache the top-level ones by the
+// tokens they span. the ifs and loops unflattening makes print far more than their own tokens, so the top level
+// is only unflattened when nothing is cached
+bool unflattenFlow(AstStatBlock* block) {
+    if (block == pass_root && isIncremental())
+        return false;
+    return unflattenDispatchers(*pass_allocator, block);
+};
+
+/*
+    obfuscators commonly employ techniques to make control flow hard to read
+    one of these is a for loop with a break at the end and no continue
+    example:
+    for i = 1, 10 do
+        // code here
+        break
+    end
+    this can be simpilfied to just
+    // code here
+
+    to detect these loops we take advantage of AstVisitors
+*/
+class DummyForLoopVisitor : public AstVisitor {
+    bool first_run = true;
+
+    public:
+    const char* var = nullptr;
+    bool success = false;
+    DummyForLoopVisitor() {}
+
+    bool visit(AstExprLocal* expr_local) override {
+        if (strcmp(var, expr_local->local->name.value) == 0)
+            success = false;
+        return true;
+    }
+    bool visit(AstStatContinue* stat_continue) override {
+        success = false;
+        return true;
+    }
+    bool visit(AstStatFor* stat_for) override {
+        if (first_run) {
+            if (stat_for->body->body.size > 0 && stat_for->body->body.data[stat_for->body->body.size - 1]->is<AstStatBreak>())
+                success = true;
+        }
+        first_run = false;
+        return true;
+    }
+};
+
+// --extra1. the body takes the place of the loop, without the break
+bool unwrapDummyLoops(AstStatBlock* block) {
+    std::vector<AstStat*> body;
+    bool changed = false;
+    for (AstStat* stat : block->body) {
+        AstStatFor* stat_for = stat->as<AstStatFor>();
+        if (!stat_for) {
+            body.push_back(stat);
+            continue;
+        };
+
+        DummyForLoopVisitor visitor;
+        visitor.var = stat_for->var->name.value;
+        stat_for->visit(&visitor);
+        if (!visitor.success) {
+            body.push_back(stat);
+            continue;
+        };
+
+        AstArray<AstStat*> loop_body = stat_for->body->body;
+        body.insert(body.end(), loop_body.data, loop_body.data + loop_body.size - 1);
+        countPass(UnwrapLoop);
+        changed = true;
+    };
+
+    if (changed)
+        replaceBody(block, body);
+    return changed;
+};
+
+// --extra1. if a then if b then <x> break end <y> end becomes if a then if b then <x> else <y> end end
+bool simplifyIfBreaks(AstStatBlock* block) {
+    bool changed = false;
+    for (AstStat* stat : block->body) {
+        AstStatIf* stat_if = stat->as<AstStatIf>();
+        for (; stat_if; stat_if = stat_if->elsebody ? stat_if->elsebody->as<AstStatIf>() : nullptr) {
+            AstArray<AstStat*>& then_body = stat_if->thenbody->body;
+            if (then_body.size < 2)
+                continue;
+
+            AstStatIf* first_if = then_body.data[0]->as<AstStatIf>();
+            if (!first_if || first_if->elsebody)
+                continue;
+
+            AstArray<AstStat*> break_body = first_if->thenbody->body;
+            if (break_body.size == 0 || !break_body.data[break_body.size - 1]->is<AstStatBreak>())
+                continue;
+
+            AstStatBlock* new_then = pass_allocator->alloc<AstStatBlock>(first_if->thenbody->location, AstArray<AstStat*>{ break_body.data, break_body.size - 1 });
+            Location rest_location(then_body.data[1]->location.begin, then_body.data[then_body.size - 1]->location.end);
+            AstStatBlock* new_else = pass_allocator->alloc<AstStatBlock>(rest_location, AstArray<AstStat*>{ then_body.data + 1, then_body.size - 1 });
+
+            then_body.data[0] = pass_allocator->alloc<AstStatIf>(first_if->location, first_if->condition, new_then, new_else, first_if->thenLocation, std::nullopt);
+            then_body.size = 1;
+            countPass(IfBreak);
+            changed = true;
+        };
+    };
+
+    return changed;
+};
+
+AstStat* assignIfElse(AstExprIfElse* expr, AstExpr* target);
+
+AstStatBlock* assignBranch(AstExpr* value, AstExpr* target) {
+    AstStat* stat;
+    if (AstExprIfElse* nested = getRootExpr(value)->as<AstExprIfElse>())
+        stat = assignIfElse(nested, target);
+    else
+        stat = pass_allocator->alloc<AstStatAssign>(value->location, copyArray(&target, 1), copyArray(&value, 1));
+
+    return pass_allocator->alloc<AstStatBlock>(value->location, copyArray(&stat, 1));
+};
+
+// target = if a then b else c as if a then target = b else target = c end, a nested if expression becomes a
+// nested if statement
+AstStat* assignIfElse(AstExprIfElse* expr, AstExpr* target) {
+    return pass_allocator->alloc<AstStatIf>(expr->location, expr->condition, assignBranch(expr->trueExpr, target),
+        assignBranch(expr->falseExpr, target), std::nullopt, std::nullopt);
+};
+
+bool areIfElseExprs(AstArray<AstExpr*> values) {
+    for (AstExpr* expr : values)
+        if (!expr->is<AstExprIfElse>())
+            return false;
+    return values.size > 0;
+};
+
+// --replaceifelseexpr. only the top-level statements are cached by incremental runs, by the tokens they span,
+// so each new one spans the tokens that decide what it prints: the name for local a, and the target up to
+// its value for the if
+bool replaceIfElseExprs(AstStatBlock* block) {
+    std::vector<AstStat*> body;
+    bool changed = false;
+    for (AstStat* stat : block->body) {
+        if (AstStatLocal* stat_local = stat->as<AstStatLocal>(); stat_local && stat_local->vars.size == stat_local->values.size
+            && areIfElseExprs(stat_local->values)) {
+            for (size_t index = 0; index < stat_local->vars.size; index++) {
+                AstLocal* local = stat_local->vars.data[index];
+                AstExprIfElse* value = stat_local->values.data[index]->as<AstExprIfElse>();
+                body.push_back(pass_allocator->alloc<AstStatLocal>(local->location, copyArray(&local, 1), AstArray<AstExpr*>{}, std::nullopt));
+
+                AstExpr* target = pass_allocator->alloc<AstExprLocal>(local->location, local, false);
+                AstStat* stat_if = assignIfElse(value, target);
+                stat_if->location = Location(local->location.begin, value->location.end);
+                body.push_back(stat_if);
+            };
+        } else if (AstStatAssign* stat_assign = stat->as<AstStatAssign>(); stat_assign && stat_assign->vars.size == stat_assign->values.size
+            && areIfElseExprs(stat_assign->values)) {
+            for (size_t index = 0; index < stat_assign->vars.size; index++) {
+                AstExpr* target = stat_assign->vars.data[index];
+                AstExprIfElse* value = stat_assign->values.data[index]->as<AstExprIfElse>();
+
+                AstStat* stat_if = assignIfElse(value, target);
+                stat_if->location = Location(target->location.begin, value->location.end);
+                body.push_back(stat_if);
+            };
+        } else {
+            body.push_back(stat);
+            continue;
+        };
+
+        countPass(IfElseExpression);
+        changed = true;
+    };
+
+    if (changed)
+        replaceBody(block, body);
+    return changed;
+};
+
+// the blocks directly inside a block, functions in expressions included, but not the blocks inside those
+struct NestedBlockVisitor : AstVisitor {
+    AstStatBlock* root;
+    std::vector<AstStatBlock*> blocks;
+
+    NestedBlockVisitor(AstStatBlock* root)
+        : root(root) {};
+
+    bool visit(AstStatBlock* node) override {
+        if (node == root)
+            return true;
+
+        blocks.push_back(node);
+        return false;
+    };
+};
+
+typedef bool Pass(AstStatBlock* block);
+
+void runPasses(Allocator& allocator, AstStatBlock* root, bool nosolve, bool replace_if_expressions, bool extra1, bool inline_proxies) {
+    std::vector<Pass*> passes;
+    if (!nosolve) {
+        passes.push_back(pruneDeadCode);
+        passes.push_back(unflattenFlow);
+        if (inline_proxies)
+            passes.push_back(dropUnusedProxies);
+    };
+    if (extra1) {
+        passes.push_back(unwrapDummyLoops);
+        passes.push_back(simplifyIfBreaks);
+    };
+    if (replace_if_expressions)
+        passes.push_back(replaceIfElseExprs);
+
+    if (passes.empty())
+        return;
+
+    LUAU_TIMETRACE_SCOPE("runPasses", "transform");
+    pass_allocator = &allocator;
+    pass_root = root;
+    if (!nosolve)
+        preparePredicates(root);
+
+    // every block once, innermost first, so what a block's rewrite exposes to the block around it is
+    // usually seen in the same round
+    std::unordered_map<AstStatBlock*, AstStatBlock*> parents = { { root, nullptr } };
+    std::vector<AstStatBlock*> worklist = { root };
+    for (size_t index = 0; index < worklist.size(); index++) {
+        NestedBlockVisitor visitor(worklist[index]);
+        worklist[index]->visit(&visitor);
+        for (AstStatBlock* nested : visitor.blocks) {
+            parents[nested] = worklist[index];
+            worklist.push_back(nested);
+        };
+    };
+    std::reverse(worklist.begin(), worklist.end());
+
+    size_t rounds = 0;
+    while (!worklist.empty() && rounds < pass_max_rounds) {
+        LUAU_TIMETRACE_SCOPE("passRound", "transform");
+        rounds++;
+
+        std::vector<AstStatBlock*> dirty;
+        std::unordered_set<AstStatBlock*> queued;
+        auto queue = [&](AstStatBlock* block) {
+            if (block && queued.insert(block).second)
+                dirty.push_back(block);
+        };
+
+        for (AstStatBlock* block : worklist) {
+            bool changed = false;
+            for (Pass* pass : passes)
+                changed |= pass(block);
+            // a rewrite can move blocks into new ones, their parents are brought up to date as the new ones
+            // are revisited
+            if (!changed && rounds == 1)
+                continue;
+
+            NestedBlockVisitor visitor(block);
+            block->visit(&visitor);
+            for (AstStatBlock* nested : visitor.blocks)
+                parents[nested] = block;
+            if (!changed)
+                continue;
+
+            // the block itself, whatever it now contains (some of which is new) and the block around it
+            for (AstStatBlock* nested : visitor.blocks)
+                queue(nested);
+            queue(block);
+            queue(parents[block]);
+        };
+
+        worklist = std::move(dirty);
+    };
+
+    countStats(pass_rounds, rounds);
+    resetPredicates();
+    pass_allocator = nullptr;
+    pass_root = nullptr;
+};
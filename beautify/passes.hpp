@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+
+// the rewrites that simplify the AST before it's printed, run until none of them changes anything. a round
+// only revisits the blocks that changed in the round before, and the blocks right around them. whatever is
+// still changing after this many rounds is printed as it is
+constexpr size_t pass_max_rounds = 16;
+
+// after prepareSolve and setupSolve, conditions are folded to find dead code. new nodes are made in
+// allocator, the one root was parsed into
+// the locals of a block would be in scope of what follows it if it was spliced into the block around it
+bool declaresLocals(Luau::AstStatBlock* block);
+
+// inline_proxies when the printer inlines the calls of proxies (beautify does, minify doesn't fold calls), so
+// their declarations can go
+void runPasses(Luau::Allocator& allocator, Luau::AstStatBlock* root, bool nosolve, bool replace_if_expressions, bool extra1, bool inline_proxies);
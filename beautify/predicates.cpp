@@ -0,0 +1,845 @@
+#include "predicates.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "Luau/TimeTrace.h"
+
+using namespace Luau;
+
+constexpr double infinity = std::numeric_limits<double>::infinity();
+// every operator is exact on integers this small, so their congruences hold at runtime too
+constexpr double exact_limit = 1099511627776.0; // 2^40
+
+struct NumberRange {
+    double low = -infinity;
+    double high = infinity;
+    bool integer = false; // every value is an integer or infinite
+    bool nan = true; // a value can be nan
+    // every value is residue + k * modulus. modulus 0 when there's only one value, 1 when nothing is known.
+    // only kept while the range is exact
+    int64_t modulus = 1;
+    int64_t residue = 0;
+
+    bool isExact() const {
+        return integer && !nan && low >= -exact_limit && high <= exact_limit;
+    };
+    bool isConstant() const {
+        return !nan && low == high;
+    };
+    bool isUnbounded() const {
+        return low == -infinity || high == infinity;
+    };
+    bool hasZero() const {
+        return low <= 0 && high >= 0;
+    };
+    bool operator==(const NumberRange& other) const {
+        return low == other.low && high == other.high && integer == other.integer && nan == other.nan && modulus == other.modulus
+            && residue == other.residue;
+    };
+};
+
+// the congruence of an exact range brought back to its smallest form, or forgotten when it's too big to be
+// multiplied without overflowing
+void normalize(NumberRange& range) {
+    if (std::isnan(range.low))
+        range.low = -infinity;
+    if (std::isnan(range.high))
+        range.high = infinity;
+
+    if (!range.isExact()) {
+        range.modulus = 1;
+        range.residue = 0;
+        return;
+    };
+
+    if (range.low == range.high) {
+        range.modulus = 0;
+        range.residue = (int64_t) range.low;
+    };
+
+    if (range.modulus > predicate_max_modulus || (range.modulus == 0 && std::abs(range.residue) > predicate_max_modulus)) {
+        range.modulus = 1;
+        range.residue = 0;
+    } else if (range.modulus > 0)
+        range.residue = ((range.residue % range.modulus) + range.modulus) % range.modulus;
+};
+
+NumberRange makeConstant(double value) {
+    NumberRange range;
+    range.low = std::isnan(value) ? infinity : value;
+    range.high = std::isnan(value) ? -infinity : value;
+    range.integer = std::isfinite(value) && std::floor(value) == value;
+    range.nan = std::isnan(value);
+    normalize(range);
+    return range;
+};
+
+NumberRange makeUnknown() {
+    return NumberRange();
+};
+
+NumberRange joinRanges(const NumberRange& left, const NumberRange& right) {
+    NumberRange range;
+    range.low = std::min(left.low, right.low);
+    range.high = std::max(left.high, right.high);
+    range.integer = left.integer && right.integer;
+    range.nan = left.nan || right.nan;
+    if (left.isExact() && right.isExact()) {
+        range.modulus = std::gcd(std::gcd(left.modulus, right.modulus), left.residue - right.residue);
+        range.residue = left.residue;
+    };
+
+    normalize(range);
+    return range;
+};
+
+NumberRange negateRange(const NumberRange& operand) {
+    NumberRange range = operand;
+    range.low = -operand.high;
+    range.high = -operand.low;
+    range.residue = -operand.residue;
+    normalize(range);
+    return range;
+};
+
+// the bounds are rounded the way the values are, which keeps them bounds since rounding is monotonic. where
+// a bound is undefined (inf - inf, 0 * inf) anything goes
+NumberRange addRanges(const NumberRange& left, const NumberRange& right) {
+    NumberRange range;
+    range.low = left.low + right.low;
+    range.high = left.high + right.high;
+    range.integer = left.integer && right.integer;
+    range.nan = left.nan || right.nan || (left.high == infinity && right.low == -infinity) || (left.low == -infinity && right.high == infinity);
+    if (left.isExact() && right.isExact()) {
+        range.modulus = std::gcd(left.modulus, right.modulus);
+        range.residue = left.residue + right.residue;
+    };
+
+    normalize(range);
+    return range;
+};
+
+NumberRange multiplyRanges(const NumberRange& left, const NumberRange& right) {
+    double products[4] = { left.low * right.low, left.low * right.high, left.high * right.low, left.high * right.high };
+
+    NumberRange range;
+    range.low = *std::min_element(products, products + 4);
+    range.high = *std::max_element(products, products + 4);
+    bool undefined = std::any_of(products, products + 4, [](double product) {
+        return std::isnan(product);
+    });
+    if (undefined) {
+        range.low = -infinity;
+        range.high = infinity;
+    };
+
+    range.integer = left.integer && right.integer;
+    range.nan = left.nan || right.nan || undefined || (left.hasZero() && right.isUnbounded()) || (right.hasZero() && left.isUnbounded());
+    if (left.isExact() && right.isExact()) {
+        // (a + k * m) * (b + l * n) = a * b + (a * n * l + b * m * k + k * l * m * n)
+        range.modulus = std::gcd(std::gcd(left.modulus * right.modulus, left.modulus * right.residue), right.modulus * left.residue);
+        range.residue = left.residue * right.residue;
+    };
+
+    normalize(range);
+    return range;
+};
+
+NumberRange divideRanges(const NumberRange& left, const NumberRange& right) {
+    if (right.nan || right.hasZero())
+        return makeUnknown();
+
+    double quotients[4] = { left.low / right.low, left.low / right.high, left.high / right.low, left.high / right.high };
+    if (std::any_of(quotients, quotients + 4, [](double quotient) {
+            return std::isnan(quotient);
+        }))
+        return makeUnknown();
+
+    NumberRange range;
+    range.low = *std::min_element(quotients, quotients + 4);
+    range.high = *std::max_element(quotients, quotients + 4);
+    range.nan = left.nan;
+    normalize(range);
+    return range;
+};
+
+// luau's a - floor(a / b) * b, only by a positive constant
+NumberRange moduloRanges(const NumberRange& left, const NumberRange& right) {
+    if (!right.isConstant() || !(right.low > 0) || right.low == infinity)
+        return makeUnknown();
+
+    double divisor = right.low;
+    NumberRange range;
+    range.nan = false;
+    if (left.isExact() && right.integer && divisor <= predicate_max_modulus) {
+        int64_t modulus = (int64_t) divisor;
+        range.integer = true;
+        if (left.modulus % modulus == 0) {
+            int64_t residue = ((left.residue % modulus) + modulus) % modulus;
+            range.low = range.high = (double) residue;
+        } else {
+            range.low = 0;
+            range.high = divisor - 1;
+            range.modulus = std::gcd(left.modulus, modulus);
+            range.residue = left.residue;
+        };
+    } else if (left.integer && right.integer && divisor <= predicate_max_modulus && (((int64_t) divisor) & ((int64_t) divisor - 1)) == 0) {
+        // dividing by a power of two is exact at any size, so is the rest, only infinity makes nan
+        range.low = 0;
+        range.high = divisor - 1;
+        range.integer = true;
+        range.nan = left.nan || left.isUnbounded();
+    } else if (!left.nan && left.low >= -exact_limit && left.high <= exact_limit) {
+        // floor(a / b) can be one too big after a / b is rounded, and the subtraction rounds too
+        range.low = -divisor - 1;
+        range.high = divisor + 1;
+    } else
+        return makeUnknown();
+
+    normalize(range);
+    return range;
+};
+
+std::optional<bool> compareRanges(AstExprBinary::Op op, const NumberRange& left, const NumberRange& right) {
+    switch (op) {
+        case AstExprBinary::Op::CompareLt:
+            if (left.high < right.low && !left.nan && !right.nan)
+                return true;
+            else if (left.low >= right.high)
+                return false;
+            break;
+        case AstExprBinary::Op::CompareLe:
+            if (left.high <= right.low && !left.nan && !right.nan)
+                return true;
+            else if (left.low > right.high)
+                return false;
+            break;
+        case AstExprBinary::Op::CompareGt:
+            return compareRanges(AstExprBinary::Op::CompareLt, right, left);
+        case AstExprBinary::Op::CompareGe:
+            return compareRanges(AstExprBinary::Op::CompareLe, right, left);
+        case AstExprBinary::Op::CompareEq: {
+            if (left.high < right.low || right.high < left.low)
+                return false;
+            if (left.isExact() && right.isExact()) {
+                int64_t modulus = std::gcd(left.modulus, right.modulus);
+                if (modulus == 0 ? left.residue != right.residue : (left.residue - right.residue) % modulus != 0)
+                    return false;
+            };
+            if (left.isConstant() && right.isConstant() && left.low == right.low)
+                return true;
+            break;
+        };
+        case AstExprBinary::Op::CompareNe: {
+            std::optional<bool> equal = compareRanges(AstExprBinary::Op::CompareEq, left, right);
+            if (equal)
+                return !*equal;
+            break;
+        };
+        default:
+            break;
+    };
+
+    return std::nullopt;
+};
+
+// what an expression can evaluate to. a number is only ever made of numbers, locals that hold them and
+// arithmetic, which has no side effects on numbers
+struct Abstract {
+    enum Kind {
+        Bottom, // no value yet, the local isn't assigned by anything evaluated so far
+        Number,
+        Top // anything, or something that can have a side effect
+    } kind = Bottom;
+    NumberRange range;
+
+    bool operator==(const Abstract& other) const {
+        return kind == other.kind && (kind != Number || range == other.range);
+    };
+};
+
+Abstract makeNumber(const NumberRange& range) {
+    return { Abstract::Number, range };
+};
+
+Abstract makeTop() {
+    return { Abstract::Top, {} };
+};
+
+Abstract joinAbstract(const Abstract& left, const Abstract& right) {
+    if (left.kind == Abstract::Bottom || right.kind == Abstract::Top)
+        return right;
+    else if (right.kind == Abstract::Bottom || left.kind == Abstract::Top)
+        return left;
+    return makeNumber(joinRanges(left.range, right.range));
+};
+
+// everything assigned to a local, anywhere
+struct Definition {
+    enum Kind {
+        Assign, // local a = value, a = value
+        Compound, // a op= value
+        ForLoop // for a = from, to, step
+    } kind;
+    AstExpr* value = nullptr;
+    AstExprBinary::Op op = AstExprBinary::Op::Add;
+    AstStatFor* loop = nullptr;
+};
+
+struct LocalFacts {
+    size_t function;
+    bool unknown = false; // a parameter, a function, nil, or the function ran out of steps
+    std::vector<Definition> definitions;
+    std::vector<size_t> dependents; // the locals whose definitions read this one
+    Abstract value;
+    size_t updates = 0;
+    bool queued = false;
+    bool evaluated = false;
+};
+
+thread_local AstStatBlock* predicate_root = nullptr;
+thread_local bool predicate_solved = false;
+thread_local std::vector<LocalFacts> predicate_locals;
+thread_local std::unordered_map<AstLocal*, size_t> predicate_local_indices;
+thread_local std::vector<std::vector<size_t>> predicate_function_locals;
+thread_local std::vector<size_t> predicate_steps;
+// the ranges locals are narrowed to while a condition is tried for each residue
+thread_local std::unordered_map<AstLocal*, NumberRange> predicate_overrides;
+thread_local size_t* predicate_budget = nullptr;
+// the local whose definitions are evaluated for the first time, every local they read gets it as a dependent.
+// evaluation doesn't depend on values, so later ones read the same locals
+thread_local size_t predicate_reader = SIZE_MAX;
+
+AstExpr* stripGroups(AstExpr* expr) {
+    while (true) {
+        if (AstExprGroup* expr_group = expr->as<AstExprGroup>())
+            expr = expr_group->expr;
+        else if (AstExprTypeAssertion* expr_assertion = expr->as<AstExprTypeAssertion>())
+            expr = expr_assertion->expr;
+        else
+            return expr;
+    };
+};
+
+Abstract evaluate(AstExpr* expr) {
+    ++*predicate_budget;
+    expr = stripGroups(expr);
+
+    if (AstExprConstantNumber* expr_number = expr->as<AstExprConstantNumber>())
+        return makeNumber(makeConstant(expr_number->value));
+    else if (AstExprLocal* expr_local = expr->as<AstExprLocal>()) {
+        if (!predicate_overrides.empty()) {
+            auto found = predicate_overrides.find(expr_local->local);
+            if (found != predicate_overrides.end())
+                return makeNumber(found->second);
+        };
+
+        auto found = predicate_local_indices.find(expr_local->local);
+        if (found == predicate_local_indices.end())
+            return makeTop();
+
+        LocalFacts& facts = predicate_locals[found->second];
+        if (predicate_reader != SIZE_MAX && (facts.dependents.empty() || facts.dependents.back() != predicate_reader))
+            facts.dependents.push_back(predicate_reader);
+        return facts.unknown ? makeTop() : facts.value;
+    } else if (AstExprUnary* expr_unary = expr->as<AstExprUnary>()) {
+        if (expr_unary->op != AstExprUnary::Op::Minus)
+            return makeTop();
+
+        Abstract operand = evaluate(expr_unary->expr);
+        if (operand.kind != Abstract::Number)
+            return operand;
+        return makeNumber(negateRange(operand.range));
+    };
+
+    AstExprBinary* expr_binary = expr->as<AstExprBinary>();
+    if (!expr_binary)
+        return makeTop();
+
+    switch (expr_binary->op) {
+        case AstExprBinary::Op::Add:
+        case AstExprBinary::Op::Sub:
+        case AstExprBinary::Op::Mul:
+        case AstExprBinary::Op::Div:
+        case AstExprBinary::Op::FloorDiv:
+        case AstExprBinary::Op::Mod:
+        case AstExprBinary::Op::Pow:
+            break;
+        default:
+            return makeTop();
+    };
+
+    Abstract left = evaluate(expr_binary->left);
+    Abstract right = evaluate(expr_binary->right);
+    if (left.kind == Abstract::Top || right.kind == Abstract::Top)
+        return makeTop();
+    else if (left.kind == Abstract::Bottom || right.kind == Abstract::Bottom)
+        return Abstract();
+
+    switch (expr_binary->op) {
+        case AstExprBinary::Op::Add:
+            return makeNumber(addRanges(left.range, right.range));
+        case AstExprBinary::Op::Sub:
+            return makeNumber(addRanges(left.range, negateRange(right.range)));
+        case AstExprBinary::Op::Mul:
+            return makeNumber(multiplyRanges(left.range, right.range));
+        case AstExprBinary::Op::Div:
+            return makeNumber(divideRanges(left.range, right.range));
+        case AstExprBinary::Op::Mod:
+            return makeNumber(moduloRanges(left.range, right.range));
+        default:
+            return makeNumber(makeUnknown());
+    };
+};
+
+Abstract evaluateDefinition(LocalFacts& facts, const Definition& definition) {
+    switch (definition.kind) {
+        case Definition::Assign:
+            return evaluate(definition.value);
+        case Definition::Compound: {
+            Abstract right = evaluate(definition.value);
+            if (right.kind != Abstract::Number || facts.value.kind != Abstract::Number)
+                return right.kind == Abstract::Top ? right : Abstract();
+
+            switch (definition.op) {
+                case AstExprBinary::Op::Add:
+                    return makeNumber(addRanges(facts.value.range, right.range));
+                case AstExprBinary::Op::Sub:
+                    return makeNumber(addRanges(facts.value.range, negateRange(right.range)));
+                case AstExprBinary::Op::Mul:
+                    return makeNumber(multiplyRanges(facts.value.range, right.range));
+                case AstExprBinary::Op::Div:
+                    return makeNumber(divideRanges(facts.value.range, right.range));
+                case AstExprBinary::Op::Mod:
+                    return makeNumber(moduloRanges(facts.value.range, right.range));
+                case AstExprBinary::Op::FloorDiv:
+                case AstExprBinary::Op::Pow:
+                    return makeNumber(makeUnknown());
+                default:
+                    // ..= makes a string
+                    return makeTop();
+            };
+        };
+        case Definition::ForLoop: {
+            // the variable is always somewhere from the start to the limit, whichever way the step goes
+            AstStatFor* loop = definition.loop;
+            Abstract from = evaluate(loop->from);
+            Abstract to = evaluate(loop->to);
+            Abstract step = loop->step ? evaluate(loop->step) : makeNumber(makeConstant(1));
+            if (from.kind != Abstract::Number || to.kind != Abstract::Number || step.kind != Abstract::Number)
+                return from.kind == Abstract::Top || to.kind == Abstract::Top || step.kind == Abstract::Top ? makeTop() : Abstract();
+
+            NumberRange range;
+            range.low = std::min(from.range.low, to.range.low);
+            range.high = std::max(from.range.high, to.range.high);
+            range.integer = from.range.integer && step.range.integer;
+            // a nan start or limit never runs the loop
+            range.nan = false;
+            if (from.range.isExact() && step.range.isExact()) {
+                range.modulus = std::gcd(from.range.modulus, std::gcd(step.range.modulus, step.range.residue));
+                range.residue = from.range.residue;
+            };
+
+            normalize(range);
+            return makeNumber(range);
+        };
+    };
+
+    return makeTop();
+};
+
+struct PredicateVisitor : AstVisitor {
+    std::vector<size_t> functions = { 0 };
+
+    size_t declare(AstLocal* local, bool unknown) {
+        size_t index = predicate_locals.size();
+        predicate_local_indices[local] = index;
+        predicate_locals.emplace_back();
+        predicate_locals.back().function = functions.back();
+        predicate_locals.back().unknown = unknown;
+        predicate_function_locals[functions.back()].push_back(index);
+        return index;
+    };
+
+    void define(AstLocal* local, Definition definition) {
+        auto found = predicate_local_indices.find(local);
+        if (found == predicate_local_indices.end())
+            return;
+
+        LocalFacts& facts = predicate_locals[found->second];
+        if (facts.unknown)
+            return;
+        facts.definitions.push_back(definition);
+        // the others it reads are found as it's evaluated
+        if (definition.kind == Definition::Compound && (facts.dependents.empty() || facts.dependents.back() != found->second))
+            facts.dependents.push_back(found->second);
+    };
+
+    void makeUnknown(AstLocal* local) {
+        auto found = predicate_local_indices.find(local);
+        if (found != predicate_local_indices.end())
+            predicate_locals[found->second].unknown = true;
+    };
+
+    // a = value for each target, nil or the extra results of a call past the last value
+    void assign(AstLocal* local, AstArray<AstExpr*> values, size_t index) {
+        if (index < values.size)
+            define(local, { Definition::Assign, values.data[index] });
+        else
+            makeUnknown(local);
+    };
+
+    bool visit(AstExprFunction* expr_function) override {
+        functions.push_back(predicate_function_locals.size());
+        predicate_function_locals.emplace_back();
+        predicate_steps.push_back(0);
+
+        if (expr_function->self)
+            declare(expr_function->self, true);
+        for (AstLocal* arg : expr_function->args)
+            declare(arg, true);
+        expr_function->body->visit(this);
+
+        functions.pop_back();
+        return false;
+    };
+
+    bool visit(AstStatLocal* stat_local) override {
+        for (AstExpr* value : stat_local->values)
+            value->visit(this);
+
+        for (size_t index = 0; index < stat_local->vars.size; index++) {
+            declare(stat_local->vars.data[index], false);
+            assign(stat_local->vars.data[index], stat_local->values, index);
+        };
+        return false;
+    };
+
+    bool visit(AstStatAssign* stat_assign) override {
+        for (size_t index = 0; index < stat_assign->vars.size; index++)
+            if (AstExprLocal* expr_local = stat_assign->vars.data[index]->as<AstExprLocal>())
+                assign(expr_local->local, stat_assign->values, index);
+        return true;
+    };
+
+    bool visit(AstStatCompoundAssign* stat_compound) override {
+        if (AstExprLocal* expr_local = stat_compound->var->as<AstExprLocal>())
+            define(expr_local->local, { Definition::Compound, stat_compound->value, stat_compound->op });
+        return true;
+    };
+
+    bool visit(AstStatFor* stat_for) override {
+        stat_for->from->visit(this);
+        stat_for->to->visit(this);
+        if (stat_for->step)
+            stat_for->step->visit(this);
+
+        declare(stat_for->var, false);
+        define(stat_for->var, { Definition::ForLoop, nullptr, AstExprBinary::Op::Add, stat_for });
+        stat_for->body->visit(this);
+        return false;
+    };
+
+    bool visit(AstStatForIn* stat_for_in) override {
+        for (AstExpr* value : stat_for_in->values)
+            value->visit(this);
+        for (AstLocal* var : stat_for_in->vars)
+            declare(var, true);
+        stat_for_in->body->visit(this);
+        return false;
+    };
+
+    bool visit(AstStatLocalFunction* stat_function) override {
+        declare(stat_function->name, true);
+        return true;
+    };
+
+    bool visit(AstStatFunction* stat_function) override {
+        if (AstExprLocal* expr_local = stat_function->name->as<AstExprLocal>())
+            makeUnknown(expr_local->local);
+        return true;
+    };
+
+};
+
+// a worklist over the locals, a local is evaluated again when one its definitions read changed. a bound
+// that still moves after a couple of updates goes to infinity, so every local settles
+void solveLocals() {
+    std::vector<size_t> worklist;
+    for (size_t index = predicate_locals.size(); index-- > 0;) {
+        if (predicate_locals[index].unknown)
+            continue;
+        predicate_locals[index].queued = true;
+        worklist.push_back(index);
+    };
+
+    auto queueDependents = [&](size_t index) {
+        for (size_t dependent : predicate_locals[index].dependents) {
+            if (predicate_locals[dependent].queued)
+                continue;
+            predicate_locals[dependent].queued = true;
+            worklist.push_back(dependent);
+        };
+    };
+
+    while (!worklist.empty()) {
+        size_t index = worklist.back();
+        worklist.pop_back();
+
+        LocalFacts& facts = predicate_locals[index];
+        facts.queued = false;
+        if (facts.unknown)
+            continue;
+
+        predicate_budget = &predicate_steps[facts.function];
+        predicate_reader = facts.evaluated ? SIZE_MAX : index;
+        // only ever grows, whatever the operators do at the edges of their ranges
+        Abstract value = facts.value;
+        for (const Definition& definition : facts.definitions)
+            value = joinAbstract(value, evaluateDefinition(facts, definition));
+        predicate_reader = SIZE_MAX;
+        facts.evaluated = true;
+
+        if (*predicate_budget > predicate_max_steps) {
+            // every local of the function is given up on, along with everything that reads them
+            for (size_t local : predicate_function_locals[facts.function]) {
+                if (predicate_locals[local].unknown)
+                    continue;
+                predicate_locals[local].unknown = true;
+                queueDependents(local);
+            };
+            continue;
+        };
+
+        if (value == facts.value)
+            continue;
+
+        if (facts.updates >= 2 && value.kind == Abstract::Number && facts.value.kind == Abstract::Number) {
+            if (value.range.low < facts.value.range.low)
+                value.range.low = -infinity;
+            if (value.range.high > facts.value.range.high)
+                value.range.high = infinity;
+            normalize(value.range);
+        };
+
+        facts.value = value;
+        facts.updates++;
+        queueDependents(index);
+    };
+
+    predicate_budget = nullptr;
+};
+
+void resetPredicates() {
+    predicate_root = nullptr;
+    predicate_solved = false;
+    predicate_locals.clear();
+    predicate_local_indices.clear();
+    predicate_function_locals.clear();
+    predicate_steps.clear();
+    predicate_overrides.clear();
+};
+
+void preparePredicates(AstStatBlock* root) {
+    resetPredicates();
+    predicate_root = root;
+};
+
+// the whole chunk is walked, so it's only done once a condition that doesn't fold reads a local. the chunk has
+// been rewritten by then, but into code that does the same
+void solvePredicates() {
+    LUAU_TIMETRACE_SCOPE("solvePredicates", "transform");
+    predicate_solved = true;
+
+    // the chunk is function 0
+    predicate_function_locals.emplace_back();
+    predicate_steps.push_back(0);
+
+    PredicateVisitor visitor;
+    predicate_root->visit(&visitor);
+    solveLocals();
+};
+
+struct LocalFindVisitor : AstVisitor {
+    AstLocal* local = nullptr;
+
+    bool visit(AstExpr* expr) override {
+        if (AstExprLocal* expr_local = expr->as<AstExprLocal>(); expr_local && !local)
+            local = expr_local->local;
+        return !local;
+    };
+    bool visit(AstExprFunction* expr_function) override {
+        return false;
+    };
+};
+
+struct ModuloVisitor : AstVisitor {
+    int64_t divisor = 0;
+    std::vector<AstLocal*> locals;
+
+    bool visit(AstExprBinary* expr_binary) override {
+        if (expr_binary->op == AstExprBinary::Op::Mod && divisor == 0)
+            if (AstExprConstantNumber* expr_number = stripGroups(expr_binary->right)->as<AstExprConstantNumber>())
+                if (expr_number->value >= 2 && expr_number->value <= predicate_max_split && std::floor(expr_number->value) == expr_number->value)
+                    divisor = (int64_t) expr_number->value;
+        return true;
+    };
+    bool visit(AstExprLocal* expr_local) override {
+        if (std::find(locals.begin(), locals.end(), expr_local->local) == locals.end())
+            locals.push_back(expr_local->local);
+        return false;
+    };
+    bool visit(AstExprFunction* expr_function) override {
+        return false;
+    };
+};
+
+bool isOtherConstant(AstExpr* expr) {
+    expr = stripGroups(expr);
+    return expr->is<AstExprConstantString>() || expr->is<AstExprConstantBool>() || expr->is<AstExprConstantNil>();
+};
+
+std::optional<bool> compareExprs(AstExprBinary* expr_binary) {
+    Abstract left = evaluate(expr_binary->left);
+    Abstract right = evaluate(expr_binary->right);
+    if (left.kind == Abstract::Number && right.kind == Abstract::Number)
+        return compareRanges(expr_binary->op, left.range, right.range);
+
+    // a number is never equal to a string, a boolean or nil, and ordering them errors
+    bool mixed = (left.kind == Abstract::Number && isOtherConstant(expr_binary->right))
+        || (right.kind == Abstract::Number && isOtherConstant(expr_binary->left));
+    if (mixed && expr_binary->op == AstExprBinary::Op::CompareEq)
+        return false;
+    else if (mixed && expr_binary->op == AstExprBinary::Op::CompareNe)
+        return true;
+    return std::nullopt;
+};
+
+// x * (x + 1) % 2 == 0 has no congruence for x, but it holds for each residue of x on its own
+std::optional<bool> compareByResidue(AstExprBinary* expr_binary) {
+    ModuloVisitor visitor;
+    expr_binary->visit(&visitor);
+    if (visitor.divisor == 0)
+        return std::nullopt;
+
+    std::vector<std::pair<AstLocal*, NumberRange>> split;
+    for (AstLocal* local : visitor.locals) {
+        auto found = predicate_local_indices.find(local);
+        if (found == predicate_local_indices.end())
+            continue;
+
+        const LocalFacts& facts = predicate_locals[found->second];
+        if (!facts.unknown && facts.value.kind == Abstract::Number && facts.value.range.isExact() && facts.value.range.modulus == 1)
+            split.push_back({ local, facts.value.range });
+    };
+
+    size_t cases = 1;
+    for (size_t index = 0; index < split.size() && cases <= (size_t) (predicate_max_split * predicate_max_split); index++)
+        cases *= (size_t) visitor.divisor;
+    if (split.empty() || cases > (size_t) (predicate_max_split * predicate_max_split))
+        return std::nullopt;
+
+    std::optional<bool> verdict;
+    for (size_t index = 0; index < cases; index++) {
+        size_t residues = index;
+        for (auto& [local, range] : split) {
+            NumberRange narrowed = range;
+            narrowed.modulus = visitor.divisor;
+            narrowed.residue = (int64_t) (residues % visitor.divisor);
+            residues /= visitor.divisor;
+            normalize(narrowed);
+            predicate_overrides[local] = narrowed;
+        };
+
+        std::optional<bool> result = compareExprs(expr_binary);
+        if (!result || (verdict && *verdict != *result)) {
+            verdict = std::nullopt;
+            break;
+        };
+        verdict = result;
+    };
+
+    predicate_overrides.clear();
+    return verdict;
+};
+
+// only what can't have a side effect is decided, and the right side of and / or only when the left side
+// doesn't already decide it
+std::optional<bool> proveTruthiness(AstExpr* expr) {
+    expr = stripGroups(expr);
+    if (AstExprConstantBool* expr_bool = expr->as<AstExprConstantBool>())
+        return expr_bool->value;
+    else if (expr->is<AstExprConstantNil>())
+        return false;
+    else if (AstExprUnary* expr_unary = expr->as<AstExprUnary>(); expr_unary && expr_unary->op == AstExprUnary::Op::Not) {
+        std::optional<bool> operand = proveTruthiness(expr_unary->expr);
+        if (!operand)
+            return std::nullopt;
+        return !*operand;
+    };
+
+    if (AstExprBinary* expr_binary = expr->as<AstExprBinary>()) {
+        switch (expr_binary->op) {
+            case AstExprBinary::Op::And:
+            case AstExprBinary::Op::Or: {
+                std::optional<bool> left = proveTruthiness(expr_binary->left);
+                if (!left)
+                    return std::nullopt;
+                else if (*left == (expr_binary->op == AstExprBinary::Op::Or))
+                    return left;
+                return proveTruthiness(expr_binary->right);
+            };
+            case AstExprBinary::Op::CompareEq:
+            case AstExprBinary::Op::CompareNe:
+            case AstExprBinary::Op::CompareLt:
+            case AstExprBinary::Op::CompareLe:
+            case AstExprBinary::Op::CompareGt:
+            case AstExprBinary::Op::CompareGe: {
+                std::optional<bool> result = compareExprs(expr_binary);
+                if (!result)
+                    result = compareByResidue(expr_binary);
+                return result;
+            };
+            default:
+                break;
+        };
+    };
+
+    // a number, nan included, is truthy
+    if (evaluate(expr).kind == Abstract::Number)
+        return true;
+    return std::nullopt;
+};
+
+// a condition that reads no local is left to the folder. the steps it takes are charged to the function of the
+// first local it reads, which is usually the one it's in
+std::optional<bool> provePredicate(AstExpr* condition) {
+    if (!predicate_root)
+        return std::nullopt;
+
+    LocalFindVisitor visitor;
+    condition->visit(&visitor);
+    if (!visitor.local)
+        return std::nullopt;
+    else if (!predicate_solved)
+        solvePredicates();
+
+    auto found = predicate_local_indices.find(visitor.local);
+    if (found == predicate_local_indices.end())
+        return std::nullopt;
+
+    predicate_budget = &predicate_steps[predicate_locals[found->second].function];
+    std::optional<bool> verdict;
+    if (*predicate_budget <= predicate_max_steps)
+        verdict = proveTruthiness(condition);
+    if (*predicate_budget > predicate_max_steps)
+        verdict = std::nullopt;
+
+    predicate_budget = nullptr;
+    return verdict;
+};
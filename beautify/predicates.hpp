@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "Luau/Ast.h"
+
+// an abstract interpreter for the opaque predicates obfuscators guard code with, like if (x * x) % 2 ~= 2 then
+// or a loop counter compared against its own bounds. every local that only ever holds numbers gets an interval,
+// whether it's always an integer, and a congruence (x = 3 mod 4), joined over everything assigned to it
+// anywhere, which stays true whatever order the code runs in. conditions of ifs and whiles made only of those
+// locals, numbers and arithmetic are then proved always true or always false
+constexpr size_t predicate_max_steps = 50000; // expressions evaluated per function, its locals are unknown past it
+constexpr int64_t predicate_max_modulus = 1 << 24; // congruences past this are forgotten
+constexpr int64_t predicate_max_split = 16; // x % n with n up to this is tried for each residue of x
+
+// remembers the chunk. the first condition provePredicate can't skip takes one linear pass over it, which finds
+// the locals, and then every local's range. ranges stay sound while code is removed or moved, but not when new
+// assignments are made
+void preparePredicates(Luau::AstStatBlock* root);
+// forgets the ranges, the AST they point into is going away
+void resetPredicates();
+
+// whether a condition in the chunk is always truthy, nullopt when that can't be proved, or the condition could
+// have a side effect
+std::optional<bool> provePredicate(Luau::AstExpr* condition);
@@ -0,0 +1,454 @@
+#include "proxies.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "interpret.hpp"
+#include "solve.hpp"
+
+using namespace Luau;
+
+// where an expression is printed, which decides whether it needs parentheses there
+struct Slot {
+    enum Kind {
+        Any,
+        Single, // in place of a call, where a call or ... would be more than one value
+        Left, // of a binary operator
+        Right,
+        Operand, // of a unary operator
+        Prefix // what is indexed
+    } kind = Any;
+    int op = 0;
+};
+
+struct ProxyParam {
+    size_t uses = 0;
+    bool conditional = false; // used on the right of an and or an or, or in a branch of an if expression
+    size_t order = 0; // when its first use is evaluated, counted from 1
+};
+
+struct Proxy {
+    AstExprFunction* function;
+    AstExpr* body;
+    std::vector<ProxyParam> params;
+    uint64_t digest;
+    bool assigned = false;
+    bool referenced = false; // used other than by the calls that are inlined
+    bool called = false;
+};
+
+struct ProxyCall {
+    Proxy* proxy;
+    Slot slot;
+    AstExpr* inlined = nullptr;
+};
+
+thread_local std::unordered_map<AstLocal*, Proxy> proxies;
+thread_local std::unordered_map<AstExprCall*, ProxyCall> proxy_calls;
+
+// luau's binding powers of the binary operators, left and right, as in its parser. unary operators bind at 8
+const int binary_priorities[AstExprBinary::Op__Count][2] = { { 6, 6 }, { 6, 6 }, { 7, 7 }, { 7, 7 }, { 7, 7 },
+    { 7, 7 }, { 10, 9 }, { 5, 4 }, { 3, 3 }, { 3, 3 }, { 3, 3 }, { 3, 3 }, { 3, 3 }, { 3, 3 }, { 2, 2 }, { 1, 1 } };
+
+size_t getParam(AstExprFunction* function, AstLocal* local) {
+    for (size_t index = 0; index < function->args.size; index++)
+        if (function->args.data[index] == local)
+            return index;
+
+    return function->args.size;
+};
+
+// walks the body in the order luau evaluates it, counting the uses of each parameter. fails on anything but
+// parameters, constants and operators, and on bodies too big to be worth copying into every call
+struct ProxyBody {
+    Proxy& proxy;
+    size_t nodes = 0;
+    size_t evaluated = 0;
+
+    ProxyBody(Proxy& proxy)
+        : proxy(proxy) {};
+
+    void hash(const void* data, size_t size) {
+        proxy.digest = hashDigest(proxy.digest, data, size);
+    };
+
+    bool walk(AstExpr* expr, bool conditional) {
+        if (++nodes > proxy_max_nodes)
+            return false;
+
+        hash(&expr->classIndex, sizeof(expr->classIndex));
+        if (AstExprLocal* expr_local = expr->as<AstExprLocal>()) {
+            size_t index = getParam(proxy.function, expr_local->local);
+            if (index == proxy.params.size())
+                return false;
+
+            ProxyParam& param = proxy.params[index];
+            if (param.uses++ == 0)
+                param.order = ++evaluated;
+            param.conditional |= conditional;
+            hash(&index, sizeof(index));
+            return true;
+        } else if (AstExprGroup* expr_group = expr->as<AstExprGroup>())
+            return walk(expr_group->expr, conditional);
+        else if (AstExprConstantBool* expr_bool = expr->as<AstExprConstantBool>())
+            hash(&expr_bool->value, sizeof(bool));
+        else if (AstExprConstantNumber* expr_number = expr->as<AstExprConstantNumber>())
+            hash(&expr_number->value, sizeof(double));
+        else if (AstExprConstantString* expr_string = expr->as<AstExprConstantString>())
+            hash(expr_string->value.data, expr_string->value.size);
+        else if (AstExprUnary* expr_unary = expr->as<AstExprUnary>()) {
+            hash(&expr_unary->op, sizeof(expr_unary->op));
+            return walk(expr_unary->expr, conditional);
+        } else if (AstExprBinary* expr_binary = expr->as<AstExprBinary>()) {
+            hash(&expr_binary->op, sizeof(expr_binary->op));
+            bool short_circuits = expr_binary->op == AstExprBinary::And || expr_binary->op == AstExprBinary::Or;
+            return walk(expr_binary->left, conditional) && walk(expr_binary->right, conditional || short_circuits);
+        } else if (AstExprIfElse* expr_if_else = expr->as<AstExprIfElse>())
+            return walk(expr_if_else->condition, conditional) && walk(expr_if_else->trueExpr, true) && walk(expr_if_else->falseExpr, true);
+        else if (AstExprIndexExpr* expr_index_expr = expr->as<AstExprIndexExpr>())
+            return walk(expr_index_expr->expr, conditional) && walk(expr_index_expr->index, conditional);
+        else if (AstExprIndexName* expr_index_name = expr->as<AstExprIndexName>()) {
+            hash(expr_index_name->index.value, strlen(expr_index_name->index.value));
+            return walk(expr_index_name->expr, conditional);
+        } else if (!expr->is<AstExprConstantNil>())
+            return false;
+
+        return true;
+    };
+};
+
+// a constant is the same wherever and however often it's evaluated, and so is a variable as long as nothing
+// else the call evaluates could change it
+enum class ProxyArg {
+    Constant,
+    Variable,
+    Other
+};
+
+ProxyArg getProxyArg(AstExpr* arg) {
+    arg = skipGroups(arg);
+    if (AstExprUnary* expr_unary = arg->as<AstExprUnary>(); expr_unary && expr_unary->op == AstExprUnary::Minus)
+        arg = skipGroups(expr_unary->expr)->is<AstExprConstantNumber>() ? skipGroups(expr_unary->expr) : arg;
+
+    if (arg->is<AstExprConstantNil>() || arg->is<AstExprConstantBool>() || arg->is<AstExprConstantNumber>() || arg->is<AstExprConstantString>())
+        return ProxyArg::Constant;
+    else if (arg->is<AstExprLocal>() || arg->is<AstExprGlobal>())
+        return ProxyArg::Variable;
+
+    return ProxyArg::Other;
+};
+
+// the arguments are all evaluated before the body runs, so once one of them could have a side effect, every
+// parameter that isn't a constant has to be evaluated exactly once, and in the order of the arguments
+bool canInline(const Proxy& proxy, AstExprCall* call) {
+    AstArray<AstExpr*> args = call->args;
+    if (call->self || args.size > proxy.params.size())
+        return false;
+    // the values of the last one would be spread over the parameters after it
+    else if (args.size > 0 && args.size < proxy.params.size()
+        && (args.data[args.size - 1]->is<AstExprCall>() || args.data[args.size - 1]->is<AstExprVarargs>()))
+        return false;
+
+    bool ordered = false;
+    for (AstExpr* arg : args)
+        ordered |= getProxyArg(arg) == ProxyArg::Other;
+    if (!ordered)
+        return true;
+
+    size_t evaluated = 0;
+    for (size_t index = 0; index < args.size; index++) {
+        const ProxyParam& param = proxy.params[index];
+        if (getProxyArg(args.data[index]) == ProxyArg::Constant)
+            continue;
+        else if (param.uses != 1 || param.conditional || param.order <= evaluated)
+            return false;
+
+        evaluated = param.order;
+    };
+
+    return true;
+};
+
+// the def-use index, every call of a proxy that can be inlined is found together with the slot it's in
+struct ProxyUseVisitor : AstVisitor {
+    Proxy* getProxy(AstExpr* expr) {
+        AstExprLocal* expr_local = skipGroups(expr)->as<AstExprLocal>();
+        auto it = expr_local ? proxies.find(expr_local->local) : proxies.end();
+        return it == proxies.end() ? nullptr : &it->second;
+    };
+
+    void declare(AstLocal* local, AstExprFunction* function) {
+        if (function->vararg || function->self || function->body->body.size != 1)
+            return;
+
+        AstStatReturn* stat_return = function->body->body.data[0]->as<AstStatReturn>();
+        if (!stat_return || stat_return->list.size != 1)
+            return;
+
+        Proxy proxy = { function, stat_return->list.data[0], std::vector<ProxyParam>(function->args.size) };
+        proxy.digest = hashDigest(fnv_offset_basis, &function->args.size, sizeof(size_t));
+        if (!ProxyBody(proxy).walk(proxy.body, false))
+            return;
+
+        proxies.emplace(local, std::move(proxy));
+    };
+
+    // the parent sees the call before it's visited, the call itself only fills in the slot if nothing did
+    void note(AstExpr* expr, Slot slot) {
+        AstExprCall* call = expr->as<AstExprCall>();
+        if (Proxy* proxy = call ? getProxy(call->func) : nullptr; proxy && canInline(*proxy, call))
+            proxy_calls.emplace(call, ProxyCall{ proxy, slot });
+    };
+
+    void assigned(AstExpr* target) {
+        if (target->is<AstExprLocal>())
+            if (Proxy* proxy = getProxy(target))
+                proxy->assigned = true;
+    };
+
+    bool visit(AstStatLocalFunction* node) override {
+        declare(node->name, node->func);
+        return true;
+    };
+
+    bool visit(AstStatLocal* node) override {
+        if (node->vars.size == 1 && node->values.size == 1)
+            if (AstExprFunction* function = skipGroups(node->values.data[0])->as<AstExprFunction>())
+                declare(node->vars.data[0], function);
+        return true;
+    };
+
+    bool visit(AstStatAssign* node) override {
+        for (AstExpr* var : node->vars)
+            assigned(var);
+        return true;
+    };
+
+    bool visit(AstStatCompoundAssign* node) override {
+        assigned(node->var);
+        return true;
+    };
+
+    bool visit(AstStatFunction* node) override {
+        assigned(node->name);
+        return true;
+    };
+
+    // a call on its own is a statement, it can't be replaced by an expression
+    bool visit(AstStatExpr* node) override {
+        AstExprCall* call = node->expr->as<AstExprCall>();
+        Proxy* proxy = call ? getProxy(call->func) : nullptr;
+        if (!proxy)
+            return true;
+
+        proxy->referenced = true;
+        for (AstExpr* arg : call->args)
+            arg->visit(this);
+        return false;
+    };
+
+    bool visit(AstExprCall* node) override {
+        Proxy* proxy = getProxy(node->func);
+        if (!proxy)
+            return true;
+
+        if (canInline(*proxy, node))
+            proxy_calls.try_emplace(node, ProxyCall{ proxy, { Slot::Single } });
+        else
+            proxy->referenced = true;
+        proxy->called = true;
+        for (AstExpr* arg : node->args)
+            arg->visit(this);
+        return false;
+    };
+
+    bool visit(AstExprLocal* node) override {
+        if (Proxy* proxy = getProxy(node))
+            proxy->referenced = true;
+        return false;
+    };
+
+    bool visit(AstExprUnary* node) override {
+        note(node->expr, { Slot::Operand, node->op });
+        return true;
+    };
+
+    bool visit(AstExprBinary* node) override {
+        note(node->left, { Slot::Left, node->op });
+        note(node->right, { Slot::Right, node->op });
+        return true;
+    };
+
+    // a :: T binds tighter than any operator
+    bool visit(AstExprTypeAssertion* node) override {
+        note(node->expr, { Slot::Prefix });
+        return true;
+    };
+};
+
+void resetProxies() {
+    proxies.clear();
+    proxy_calls.clear();
+};
+
+void prepareProxies(AstStatBlock* root) {
+    resetProxies();
+
+    ProxyUseVisitor uses;
+    root->visit(&uses);
+};
+
+uint64_t getProxyDigest(AstLocal* local) {
+    auto it = proxies.find(local);
+    return it == proxies.end() || it->second.assigned ? 0 : it->second.digest;
+};
+
+// what an expression looks like once it's printed, as far as the operators around it are concerned
+struct Shape {
+    enum Kind {
+        Atom,
+        Unary, // starts with an operator, -1 included
+        Binary,
+        Open // if a then b else c and a :: T take whatever follows them
+    } kind;
+    int op = 0;
+};
+
+Shape getShape(Allocator& allocator, AstExpr* expr) {
+    if (AstExprConstantNumber* expr_number = expr->as<AstExprConstantNumber>())
+        return { std::signbit(expr_number->value) && !std::isnan(expr_number->value) ? Shape::Unary : Shape::Atom };
+    else if (AstExprUnary* expr_unary = expr->as<AstExprUnary>())
+        return { Shape::Unary, expr_unary->op };
+    else if (AstExprBinary* expr_binary = expr->as<AstExprBinary>())
+        return { Shape::Binary, expr_binary->op };
+    else if (expr->is<AstExprIfElse>() || expr->is<AstExprTypeAssertion>())
+        return { Shape::Open };
+    else if (!expr->is<AstExprCall>() && !expr->is<AstExprIndexExpr>())
+        return { Shape::Atom };
+
+    // calls and indexes can fold into something else entirely
+    if (AstExprCall* call = expr->as<AstExprCall>())
+        if (AstExpr* inlined = inlineProxyCall(allocator, call))
+            return getShape(allocator, inlined);
+
+    if (!isSolvable(expr))
+        return { Shape::Atom };
+
+    Solved solved = solve(expr);
+    switch (solved.type) {
+        case Solved::Type::Number:
+            return { std::signbit(solved.number_result) && !std::isnan(solved.number_result) ? Shape::Unary : Shape::Atom };
+        case Solved::Type::Bool:
+            return { Shape::Atom };
+        case Solved::Type::Expression:
+            return getShape(allocator, solved.expression_result);
+    };
+
+    return { Shape::Atom };
+};
+
+bool needsGroup(Allocator& allocator, AstExpr* expr, Slot slot) {
+    switch (slot.kind) {
+        case Slot::Any:
+            return false;
+        case Slot::Single:
+            return expr->is<AstExprVarargs>() || (expr->is<AstExprCall>() && !isSolvable(expr));
+        case Slot::Prefix:
+            return !expr->is<AstExprLocal>() && !expr->is<AstExprGlobal>() && !expr->is<AstExprCall>()
+                && !expr->is<AstExprIndexExpr>() && !expr->is<AstExprIndexName>() && !expr->is<AstExprGroup>();
+        default:
+            break;
+    };
+
+    Shape shape = getShape(allocator, expr);
+    switch (shape.kind) {
+        case Shape::Atom:
+            return false;
+        case Shape::Open:
+            return true;
+        case Shape::Unary:
+            // -a ^ b is -(a ^ b), and - -a would print as a comment
+            return (slot.kind == Slot::Left && slot.op == AstExprBinary::Pow) || (slot.kind == Slot::Operand && slot.op == AstExprUnary::Minus);
+        case Shape::Binary:
+            if (slot.kind == Slot::Left)
+                return binary_priorities[slot.op][0] > binary_priorities[shape.op][1];
+            else if (slot.kind == Slot::Right)
+                return binary_priorities[shape.op][0] <= binary_priorities[slot.op][1];
+            return shape.op != AstExprBinary::Pow;
+    };
+
+    return false;
+};
+
+// a copy of the body with the arguments in place of the parameters, the constants in it are shared
+struct ProxyInliner {
+    Allocator& allocator;
+    AstExprCall* call;
+    const Proxy& proxy;
+
+    ProxyInliner(Allocator& allocator, AstExprCall* call, const Proxy& proxy)
+        : allocator(allocator)
+        , call(call)
+        , proxy(proxy) {};
+
+    AstExpr* place(AstExpr* expr, Slot slot) {
+        return needsGroup(allocator, expr, slot) ? allocator.alloc<AstExprGroup>(call->location, expr) : expr;
+    };
+
+    AstExpr* substitute(AstExpr* expr) {
+        const Location& location = call->location;
+        if (AstExprLocal* expr_local = expr->as<AstExprLocal>()) {
+            size_t index = getParam(proxy.function, expr_local->local);
+            return index < call->args.size ? call->args.data[index] : allocator.alloc<AstExprConstantNil>(location);
+        } else if (AstExprGroup* expr_group = expr->as<AstExprGroup>())
+            return allocator.alloc<AstExprGroup>(location, substitute(expr_group->expr));
+        else if (AstExprUnary* expr_unary = expr->as<AstExprUnary>())
+            return allocator.alloc<AstExprUnary>(location, expr_unary->op,
+                place(substitute(expr_unary->expr), { Slot::Operand, expr_unary->op }));
+        else if (AstExprBinary* expr_binary = expr->as<AstExprBinary>())
+            return allocator.alloc<AstExprBinary>(location, expr_binary->op, place(substitute(expr_binary->left), { Slot::Left, expr_binary->op }),
+                place(substitute(expr_binary->right), { Slot::Right, expr_binary->op }));
+        else if (AstExprIfElse* expr_if_else = expr->as<AstExprIfElse>())
+            return allocator.alloc<AstExprIfElse>(location, substitute(expr_if_else->condition), expr_if_else->hasThen,
+                substitute(expr_if_else->trueExpr), expr_if_else->hasElse, substitute(expr_if_else->falseExpr));
+        else if (AstExprIndexExpr* expr_index_expr = expr->as<AstExprIndexExpr>())
+            return allocator.alloc<AstExprIndexExpr>(location, place(substitute(expr_index_expr->expr), { Slot::Prefix }),
+                substitute(expr_index_expr->index));
+        else if (AstExprIndexName* expr_index_name = expr->as<AstExprIndexName>())
+            return allocator.alloc<AstExprIndexName>(location, place(substitute(expr_index_name->expr), { Slot::Prefix }),
+                expr_index_name->index, expr_index_name->indexLocation, expr_index_name->opPosition, expr_index_name->op);
+
+        return expr;
+    };
+};
+
+AstExpr* inlineProxyCall(Allocator& allocator, AstExprCall* call) {
+    if (proxy_calls.empty() || !skipGroups(call->func)->is<AstExprLocal>())
+        return nullptr;
+
+    // the proxy could be assigned after the call, which is only known once the whole chunk was visited
+    auto it = proxy_calls.find(call);
+    if (it == proxy_calls.end() || it->second.proxy->assigned)
+        return nullptr;
+
+    ProxyCall& proxy_call = it->second;
+    if (!proxy_call.inlined) {
+        ProxyInliner inliner(allocator, call, *proxy_call.proxy);
+        proxy_call.inlined = inliner.place(inliner.substitute(proxy_call.proxy->body), proxy_call.slot);
+    };
+
+    return proxy_call.inlined;
+};
+
+bool isUnusedProxy(AstStat* stat) {
+    AstLocal* local = nullptr;
+    if (AstStatLocalFunction* stat_local_function = stat->as<AstStatLocalFunction>())
+        local = stat_local_function->name;
+    else if (AstStatLocal* stat_local = stat->as<AstStatLocal>(); stat_local && stat_local->vars.size == 1)
+        local = stat_local->vars.data[0];
+
+    auto it = local ? proxies.find(local) : proxies.end();
+    return it != proxies.end() && it->second.called && !it->second.referenced && !it->second.assigned;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+
+// obfuscators wrap operators in tiny local functions, local function f(a, b) return a + b end, and then call
+// f(x, y) everywhere a + b was. a local function that is never assigned again and whose body is one return of
+// its parameters, constants and operators (indexing included) is a proxy, and a call of it prints as that
+// expression with the arguments in place of the parameters. an argument other than a constant or a variable
+// has to be used exactly once, not behind an and, or or if, and in the order the arguments were evaluated in,
+// or the call is left as it is. operators are taken to have no side effects, the same as the folds in solve.cpp
+constexpr size_t proxy_max_nodes = 64; // expressions in the body of a proxy, bigger functions stay calls
+
+// one linear pass over the chunk indexes every proxy, each call of it and whatever else uses it
+void prepareProxies(Luau::AstStatBlock* root);
+// a digest of the body of the proxy a local is declared as, the same for two proxies that inline the same way.
+// 0 when it isn't a proxy or is assigned again
+uint64_t getProxyDigest(Luau::AstLocal* local);
+// forgets the proxies and the inlined calls, the AST they point into is going away
+void resetProxies();
+
+// the body of the proxy call calls, with the arguments in place of the parameters and parenthesized for
+// wherever the call is. made in allocator the first time, nullptr when call isn't a call that can be inlined
+Luau::AstExpr* inlineProxyCall(Luau::Allocator& allocator, Luau::AstExprCall* call);
+// whether stat declares a proxy that nothing but its inlined calls uses, so it can go once they're printed
+bool isUnusedProxy(Luau::AstStat* stat);
@@ -1,23 +1,124 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "cache.hpp"
+#include "interpret.hpp"
+#include "proxies.hpp"
 #include "solve.hpp"
+#include "stats.hpp"
 
 #include "Luau/Ast.h"
 #include "Luau/Lexer.h"
 
 using namespace Luau;
 
-Allocator* allocator = nullptr;
+// NOTE: if we add function to this list, beautify on AstExprGroup will need to be adjusted
+enum SolveResultType {
+    None,
+    Bool,
+    Number,
+    String,
+    Unknown,
+    Inlined // a call of a proxy, printed as its body and not a constant, see proxies.hpp
+};
+
+thread_local Allocator* allocator = nullptr;
+// links of concat chains with a piece that isn't constant, see isConstantConcat
+thread_local std::unordered_set<AstExprBinary*> unsolvable_concats;
+// the string constant made for each bound local, shared by all of its uses
+thread_local std::unordered_map<AstLocal*, AstExprConstantString*> bound_strings;
+// and for each string item of a bound table
+thread_local std::unordered_map<const Interpreted*, AstExprConstantString*> bound_item_strings;
+// what each proxy call is inlined as and what that folds to, nullptr when the interpreter runs it instead. typing
+// the body again for every parent that asks is quadratic in how deep the calls are nested
+struct ProxyFold {
+    AstExpr* inlined;
+    SolveResultType type;
+};
+thread_local std::unordered_map<AstExprCall*, ProxyFold> proxy_folds;
+// for incremental runs, what the locals read in each statement and function are bound to and the proxies they
+// are, see getBindingsDigest
+thread_local std::unordered_map<AstNode*, uint64_t> bindings_digests;
 
 void setAllocator(Luau::Allocator* allocator_in) {
     allocator = allocator_in;
+    unsolvable_concats.clear();
+    bound_strings.clear();
+    bound_item_strings.clear();
+    proxy_folds.clear();
+    bindings_digests.clear();
+    resetInterpret();
+    resetProxies();
 }
 
-bool nosolve;
-bool s_ignore_types;
+// the bindings of the locals a subtree reads, in the order it reads them. each statement and function inside
+// it gets its own digest on the way, which the subtree's takes in instead of walking it again
+struct BindingsDigestVisitor : AstVisitor {
+    AstNode* root;
+    uint64_t digest = fnv_offset_basis;
+
+    BindingsDigestVisitor(AstNode* root)
+        : root(root) {};
+
+    bool nest(AstNode* node) {
+        if (node == root)
+            return true;
+
+        BindingsDigestVisitor nested(node);
+        node->visit(&nested);
+        bindings_digests[node] = nested.digest;
+        digest = hashDigest(digest, &nested.digest, sizeof(uint64_t));
+        return false;
+    };
+
+    bool visit(AstStat* node) override {
+        return nest(node);
+    };
+
+    bool visit(AstExprFunction* node) override {
+        return nest(node);
+    };
+
+    bool visit(AstExprLocal* node) override {
+        uint64_t binding = getBindingDigest(node->local);
+        uint64_t proxy = getProxyDigest(node->local);
+        digest = hashDigest(digest, &binding, sizeof(uint64_t));
+        digest = hashDigest(digest, &proxy, sizeof(uint64_t));
+        return false;
+    };
+};
+
+uint64_t prepareSolve(AstStatBlock* root) {
+    LUAU_TIMETRACE_SCOPE("prepareSolve", "fold");
+    bound_item_strings.clear();
+    proxy_folds.clear();
+    bindings_digests.clear();
+    uint64_t digest = prepareInterpret(root);
+    prepareProxies(root);
+    if (isIncremental()) {
+        BindingsDigestVisitor bindings(root);
+        root->visit(&bindings);
+    };
+    return digest;
+};
+
+std::optional<uint64_t> getBindingsDigest(AstNode* node) {
+    auto it = bindings_digests.find(node);
+    if (it == bindings_digests.end())
+        return std::nullopt;
+    return it->second;
+};
+
+thread_local bool nosolve;
+thread_local bool s_ignore_types;
 
 AstExpr* getRootExpr(AstExpr* expr) {
     if (s_ignore_types) {
@@ -40,15 +141,6 @@ AstExpr* getRootExpr(AstExpr* expr) {
     return expr;
 };
 
-// NOTE: if we add function to this list, beautify on AstExprGroup will need to be adjusted
-enum SolveResultType {
-    None,
-    Bool,
-    Number,
-    String,
-    Unknown
-};
-
 bool isConstant(AstExpr* expr);
 bool isConstantNumber(AstExpr* expr);
 bool isConstantString(AstExpr* expr);
@@ -89,7 +181,8 @@ double solveBinary(AstExprBinary::Op op, double left, double right) {
             return floor(left / right);
             break;
         case AstExprBinary::Op::Mod:
-            return (int) left % (int) right;
+            // luau's definition, which also covers fractions, negatives and a zero divisor (nan)
+            return left - floor(left / right) * right;
             break;
         case AstExprBinary::Op::Pow:
             return pow(left, right);
@@ -252,7 +345,7 @@ std::optional<InlineNumberThroughStringLenFunctionResult> testInlineNumberThroug
         return std::nullopt;
 
     auto left = getRootExpr(expr_binary->left)->as<AstExprUnary>();
-    if (left->op != AstExprUnary::Len)
+    if (!left || left->op != AstExprUnary::Len)
         return std::nullopt;
 
     auto unary_expr = getRootExpr(left->expr)->as<AstExprLocal>();
@@ -267,7 +360,7 @@ std::optional<InlineNumberThroughStringLenFunctionResult> testInlineNumberThroug
     if (strcmp(arg_received->name.value, unary_expr->local->name.value) == 0) {
         InlineNumberThroughStringLenFunctionResult result {
             .op = expr_binary->op,
-            .length = strlen(arg_passed->value.data),
+            .length = arg_passed->value.size,
             .number = binary_right.number_result
         };
         return result;
@@ -276,6 +369,24 @@ std::optional<InlineNumberThroughStringLenFunctionResult> testInlineNumberThroug
     return std::nullopt;
 }
 
+const Interpreted* testInterpretedCall(AstExpr* expr, bool from_stat_expr = false) {
+    // a constant alone isn't a statement, and strings and nil need somewhere to live
+    if (from_stat_expr || !allocator)
+        return nullptr;
+
+    auto expr_call = getRootExpr(expr)->as<AstExprCall>();
+    return expr_call ? interpretCall(expr_call) : nullptr;
+}
+
+// local a = 5 ... a, only locals never assigned again, see prepareInterpret
+const Interpreted* testBoundLocal(AstExpr* expr) {
+    if (!allocator)
+        return nullptr;
+
+    auto expr_local = getRootExpr(expr)->as<AstExprLocal>();
+    return expr_local ? getBoundConstant(expr_local->local) : nullptr;
+}
+
 std::optional<AstExpr*> testSimpleFunctionCall(AstExpr* expr, bool from_stat_expr = false) {
     if (from_stat_expr)
         return std::nullopt;
@@ -314,7 +425,98 @@ std::optional<AstExpr*> testSimpleFunctionCall(AstExpr* expr, bool from_stat_exp
     return list.data[0];
 }
 
-SolveResultType getSolveResultType(AstExpr* expr, bool from_stat_expr = false) {
+SolveResultType getSolveResultType(AstExpr* expr, bool from_stat_expr = false);
+
+// t[i] where t is bound to a list of constants and i folds to a number
+const Interpreted* testBoundIndex(AstExpr* expr) {
+    if (!allocator)
+        return nullptr;
+
+    auto index_expr = getRootExpr(expr)->as<AstExprIndexExpr>();
+    if (!index_expr || !isBoundTable(index_expr))
+        return nullptr;
+
+    AstExpr* index = getRootExpr(index_expr->index);
+    if (auto index_number = index->as<AstExprConstantNumber>())
+        return getBoundItem(index_expr, index_number->value);
+    else if (getSolveResultType(index) != Number)
+        return nullptr;
+
+    Solved solved = solve(index);
+    return solved.type == Solved::Type::Number ? getBoundItem(index_expr, solved.number_result) : nullptr;
+};
+
+// f(x, y) where f is a proxy. a call on its own is never one, so from_stat_expr doesn't matter, and a call that
+// is would have its proxy dropped before it's printed. asked before testInterpretedCall so a call asked about again
+// takes one lookup, but the calls the interpreter can run are still left to it, it knows the tables the body is
+// given. the body is only a constant when everything it was given folds
+const ProxyFold* testProxyCall(AstExpr* expr) {
+    auto expr_call = getRootExpr(expr)->as<AstExprCall>();
+    if (!allocator || !expr_call)
+        return nullptr;
+
+    auto it = proxy_folds.find(expr_call);
+    if (it == proxy_folds.end()) {
+        AstExpr* inlined = inlineProxyCall(*allocator, expr_call);
+        if (!inlined)
+            return nullptr;
+        else if (interpretCall(expr_call))
+            inlined = nullptr;
+
+        SolveResultType type = inlined ? getSolveResultType(getRootExpr(inlined)) : None;
+        it = proxy_folds.emplace(expr_call, ProxyFold{ inlined, type == None ? Inlined : type }).first;
+    };
+
+    return it->second.inlined ? &it->second : nullptr;
+};
+
+bool isConcatPiece(AstExpr* expr) {
+    SolveResultType type = getSolveResultType(getRootExpr(expr));
+    return type == String || type == Number;
+};
+
+// obfuscators split strings into thousands of "a" .. "b" pieces, and since .. is right associative the chain
+// is walked down its right side in a loop instead of recursing. when a piece isn't constant every link above
+// it is remembered, the printer asks again for each of them on its way down
+bool isConstantConcat(AstExprBinary* expr_binary) {
+    // the folded string has to live somewhere
+    if (!allocator)
+        return false;
+
+    std::vector<AstExprBinary*> links;
+    AstExpr* expr = expr_binary;
+    AstExprBinary* link;
+    bool constant = true;
+    while ((link = expr->as<AstExprBinary>()) && link->op == AstExprBinary::Op::Concat) {
+        links.push_back(link);
+        if (unsolvable_concats.count(link) || !isConcatPiece(link->left)) {
+            constant = false;
+            break;
+        };
+
+        expr = getRootExpr(link->right);
+    };
+
+    if (constant && isConcatPiece(expr))
+        return true;
+
+    unsolvable_concats.insert(links.begin(), links.end());
+    return false;
+};
+
+SolveResultType getInterpretedType(const Interpreted& interpreted) {
+    switch (interpreted.type) {
+        case Interpreted::Number:
+            return Number;
+        case Interpreted::String:
+            return String;
+
+        default:
+            return Unknown;
+    };
+};
+
+SolveResultType getSolveResultType(AstExpr* expr, bool from_stat_expr) {
     SolveResultType result = None;
     if (nosolve)
         return result;
@@ -343,10 +545,17 @@ SolveResultType getSolveResultType(AstExpr* expr, bool from_stat_expr = false) {
                 break;
         };
     } else if (AstExprBinary* expr_binary = expr->as<AstExprBinary>()) {
-        // TODO: number concat
-        if (expr_binary->op != AstExprBinary::Op::Concat && isConstantNumber(expr_binary->left) && isConstantNumber(expr_binary->right))
+        if (expr_binary->op == AstExprBinary::Op::Concat)
+            return isConstantConcat(expr_binary) ? String : None;
+
+        // each side is only typed once, asking isConstantNumber and then isConstantString for both made this
+        // exponential in the depth of a chain that solves to neither
+        SolveResultType left = getSolveResultType(getRootExpr(expr_binary->left));
+        SolveResultType right = left == Number || left == String ? getSolveResultType(getRootExpr(expr_binary->right)) : None;
+
+        if (left == Number && right == Number)
             result = Number;
-        else if (isConstantString(expr_binary->left) && isConstantString(expr_binary->right)) {
+        else if (left == String && right == String) {
             switch (expr_binary->op) {
                 case AstExprBinary::Op::CompareNe:
                 case AstExprBinary::Op::CompareEq:
@@ -375,6 +584,14 @@ SolveResultType getSolveResultType(AstExpr* expr, bool from_stat_expr = false) {
     // (function(A) return (#A - 9) end)("some string")
     else if (testInlineNumberThroughStringLenFunction(expr, from_stat_expr))
         result = Number;
+    else if (const Interpreted* interpreted = testBoundLocal(expr))
+        result = getInterpretedType(*interpreted);
+    else if (const Interpreted* interpreted = testBoundIndex(expr))
+        result = getInterpretedType(*interpreted);
+    else if (const ProxyFold* proxy_fold = testProxyCall(expr))
+        result = proxy_fold->type;
+    else if (const Interpreted* interpreted = testInterpretedCall(expr, from_stat_expr))
+        result = getInterpretedType(*interpreted);
     else if (testSimpleFunctionCall(expr, from_stat_expr))
         result = Unknown;
 
@@ -382,7 +599,8 @@ SolveResultType getSolveResultType(AstExpr* expr, bool from_stat_expr = false) {
 };
 
 bool isConstant(AstExpr* expr) {
-    if (isSolvable(expr))
+    SolveResultType type = getSolveResultType(expr);
+    if (type != None && type != Inlined)
         return true;
 
     expr = getRootExpr(expr);
@@ -405,10 +623,90 @@ bool isConstantTable(AstExpr* expr) {
     return expr->is<AstExprTable>();
 };
 
+thread_local bool fold_timing = false;
+thread_local double fold_ms = 0;
+thread_local int fold_timer_depth = 0;
+
+void setFoldTiming(bool enabled) {
+    fold_timing = enabled;
+};
+
+double takeFoldMilliseconds() {
+    double ms = fold_ms;
+    fold_ms = 0;
+    return ms;
+};
+
+// adds the time until it goes out of scope to fold_ms, when it's the outermost one
+struct FoldTimer {
+    std::chrono::steady_clock::time_point start;
+
+    FoldTimer() {
+        if (fold_timing && fold_timer_depth++ == 0)
+            start = std::chrono::steady_clock::now();
+    };
+
+    ~FoldTimer() {
+        if (fold_timing && --fold_timer_depth == 0)
+            fold_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+};
+
 bool isSolvable(AstExpr* expr, bool from_stat_expr) {
+    FoldTimer timer;
+    countStats(solvable_calls, 1);
     return getSolveResultType(expr, from_stat_expr) != None;
 };
 
+// the pieces are copied straight into one buffer of the allocator, numbers converted the way luau's tostring does
+AstExprConstantString* solveConcat(AstExprBinary* expr_binary) {
+    std::vector<AstExpr*> pieces;
+    AstExpr* expr = expr_binary;
+    AstExprBinary* link;
+    while ((link = expr->as<AstExprBinary>()) && link->op == AstExprBinary::Op::Concat) {
+        pieces.push_back(link->left);
+        expr = getRootExpr(link->right);
+    };
+    pieces.push_back(expr);
+
+    // reserved up front, the strings can't move while the values point into them
+    std::vector<std::string> numbers;
+    numbers.reserve(pieces.size());
+    std::vector<AstArray<char>> values;
+    values.reserve(pieces.size());
+
+    size_t size = 0;
+    for (AstExpr* piece : pieces) {
+        Solved solved = solve(piece);
+        if (solved.type == Solved::Type::Number) {
+            numbers.push_back(numberToString(solved.number_result));
+            values.push_back({ numbers.back().data(), numbers.back().size() });
+        } else
+            values.push_back(solved.expression_result->as<AstExprConstantString>()->value);
+
+        size += values.back().size;
+    };
+
+    char* data = (char*) allocator->allocate(size + 1);
+    char* end = data;
+    for (const AstArray<char>& value : values) {
+        memcpy(end, value.data, value.size);
+        end += value.size;
+    };
+    *end = '\0';
+
+    return allocator->alloc<AstExprConstantString>(expr_binary->location, AstArray<char>{ data, size });
+};
+
+// byte order like strcmp, but the strings can have zeros in them
+int compareStrings(const AstArray<char>& left, const AstArray<char>& right) {
+    int res = memcmp(left.data, right.data, std::min(left.size, right.size));
+    if (res != 0)
+        return res;
+
+    return left.size < right.size ? -1 : left.size > right.size;
+};
+
 bool isFalsey(AstExpr* expr) {
     if (AstExprConstantBool* expr_bool = expr->as<AstExprConstantBool>())
         return expr_bool->value == false;
@@ -416,11 +714,73 @@ bool isFalsey(AstExpr* expr) {
     return expr->is<AstExprConstantNil>();
 };
 
+std::optional<bool> getTruthiness(AstExpr* expr) {
+    if (!isSolvable(expr))
+        return std::nullopt;
+
+    Solved solved = solve(expr);
+    switch (solved.type) {
+        case Solved::Type::Number:
+            return true;
+        case Solved::Type::Bool:
+            return solved.bool_result;
+        case Solved::Type::Expression: {
+            AstExpr* root = getRootExpr(solved.expression_result);
+            if (root->is<AstExprConstantNil>() || root->is<AstExprConstantBool>())
+                return !isFalsey(root);
+            if (root->is<AstExprConstantNumber>() || root->is<AstExprConstantString>())
+                return true;
+            break;
+        };
+    };
+
+    return std::nullopt;
+};
+
+AstExprConstantString* makeConstantString(const Location& location, const std::string& value) {
+    char* data = (char*) allocator->allocate(value.size() + 1);
+    memcpy(data, value.data(), value.size());
+    data[value.size()] = '\0';
+
+    return allocator->alloc<AstExprConstantString>(location, AstArray<char>{ data, value.size() });
+};
+
+Solved solveInterpreted(AstExpr* expr, const Interpreted& interpreted) {
+    Solved result = {};
+    switch (interpreted.type) {
+        case Interpreted::Nil:
+            result.type = Solved::Type::Expression;
+            result.expression_result = allocator->alloc<AstExprConstantNil>(expr->location);
+            break;
+        case Interpreted::Bool:
+            result.type = Solved::Type::Bool;
+            result.bool_result = interpreted.bool_result;
+            break;
+        case Interpreted::Number:
+            result.type = Solved::Type::Number;
+            result.number_result = interpreted.number_result;
+            break;
+        case Interpreted::String:
+            result.type = Solved::Type::Expression;
+            result.expression_result = makeConstantString(expr->location, interpreted.string_result);
+            break;
+    };
+
+    return result;
+};
+
+// solves that haven't returned yet on this thread
+thread_local int solve_depth = 0;
+
 Solved solve(AstExpr* expr, bool from_stat_expr) {
+    FoldTimer timer;
     expr = getRootExpr(expr);
     assert(isSolvable(expr, from_stat_expr));
+    countStats(solve_calls, 1);
+    solve_depth++;
 
     Solved result = {};
+    FoldRule rule = FoldRule::Count; // none
 
     if (AstExprConstantNumber* expr_number = expr->as<AstExprConstantNumber>()) {
         result.type = Solved::Type::Number;
@@ -432,21 +792,28 @@ Solved solve(AstExpr* expr, bool from_stat_expr) {
         switch (expr_unary->op) {
             case AstExprUnary::Op::Not:
                 if (isConstant(expr_unary->expr)) {
+                    rule = FoldRule::Not;
+                    // solved first, the operand can be a call that returns false or nil
+                    Solved operand = solve(expr_unary->expr);
                     result.type = Solved::Type::Bool;
-                    result.bool_result = isFalsey(getRootExpr(expr_unary->expr));
+                    result.bool_result = operand.type == Solved::Type::Bool ? !operand.bool_result
+                        : operand.type == Solved::Type::Expression && isFalsey(getRootExpr(operand.expression_result));
                 };
                 break;
             case AstExprUnary::Op::Minus:
                 if (isConstantNumber(expr_unary->expr)) {
+                    rule = FoldRule::Negate;
                     result.type = Solved::Type::Number;
                     result.number_result = -solve(expr_unary->expr).number_result;
                 };
                 break;
             case AstExprUnary::Op::Len:
                 if (isConstantString(expr_unary->expr)) {
+                    rule = FoldRule::StringLength;
                     result.type = Solved::Type::Number;
                     result.number_result = solve(expr_unary->expr).expression_result->as<AstExprConstantString>()->value.size;
                 } else if (isConstantTable(expr_unary->expr)) {
+                    rule = FoldRule::TableLength;
                     result.type = Solved::Type::Number;
 
                     auto table = getRootExpr(expr_unary->expr)->as<AstExprTable>();
@@ -462,10 +829,19 @@ Solved solve(AstExpr* expr, bool from_stat_expr) {
                 break;
         };
     } else if (AstExprBinary* expr_binary = expr->as<AstExprBinary>()) {
-        if (isConstantNumber(expr_binary->left) && isConstantNumber(expr_binary->right)) {
+        if (expr_binary->op == AstExprBinary::Op::Concat) {
+            rule = FoldRule::Concat;
+            result.type = Solved::Type::Expression;
+            result.expression_result = solveConcat(expr_binary);
+        } else if (isConstantNumber(expr_binary->left) && isConstantNumber(expr_binary->right)) {
             Solved left = solve(expr_binary->left);
             Solved right = solve(expr_binary->right);
 
+            if (expr_binary->op >= AstExprBinary::Op::CompareNe && expr_binary->op <= AstExprBinary::Op::CompareGe)
+                rule = FoldRule::Comparison;
+            else
+                rule = FoldRule::Arithmetic;
+
             switch (expr_binary->op) {
                 case AstExprBinary::Op::Add:
                     result.type = Solved::Type::Number;
@@ -490,15 +866,12 @@ Solved solve(AstExpr* expr, bool from_stat_expr) {
                     break;
                 case AstExprBinary::Op::Mod:
                     result.type = Solved::Type::Number;
-                    result.number_result = (int) left.number_result % (int) right.number_result;
+                    result.number_result = solveBinary(expr_binary->op, left.number_result, right.number_result);
                     break;
                 case AstExprBinary::Op::Pow:
                     result.type = Solved::Type::Number;
                     result.number_result = pow(left.number_result, right.number_result);
                     break;
-                case AstExprBinary::Op::Concat:
-                    // TODO: number concat
-                    break;
                 case AstExprBinary::Op::CompareNe:
                     result.type = Solved::Type::Bool;
                     result.bool_result = left.number_result != right.number_result;
@@ -536,10 +909,16 @@ Solved solve(AstExpr* expr, bool from_stat_expr) {
                     break;
             };
         } else if (isConstantString(expr_binary->left) && isConstantString(expr_binary->right)) {
-            char* left = getRootExpr(expr_binary->left)->as<AstExprConstantString>()->value.data;
-            char* right = getRootExpr(expr_binary->right)->as<AstExprConstantString>()->value.data;
+            // either side can be a folded chain or an and/or of strings, not just a literal
+            AstExpr* left = solve(expr_binary->left).expression_result;
+            AstExpr* right = solve(expr_binary->right).expression_result;
+
+            int res = compareStrings(left->as<AstExprConstantString>()->value, right->as<AstExprConstantString>()->value);
 
-            int res = strcmp(left, right);
+            if (expr_binary->op == AstExprBinary::Op::And || expr_binary->op == AstExprBinary::Op::Or)
+                rule = FoldRule::StringLogic;
+            else
+                rule = FoldRule::Comparison;
 
             switch (expr_binary->op) {
                 case AstExprBinary::Op::CompareNe:
@@ -569,11 +948,11 @@ Solved solve(AstExpr* expr, bool from_stat_expr) {
 
                 case AstExprBinary::Op::And:
                     result.type = Solved::Type::Expression;
-                    result.expression_result = getRootExpr(expr_binary->right);
+                    result.expression_result = right;
                     break;
                 case AstExprBinary::Op::Or:
                     result.type = Solved::Type::Expression;
-                    result.expression_result = getRootExpr(expr_binary->left);
+                    result.expression_result = left;
                     break;
 
                 default:
@@ -587,13 +966,52 @@ Solved solve(AstExpr* expr, bool from_stat_expr) {
         result.type = Solved::Type::Expression;
         result.expression_result = expr_bool;
     } else if (auto constant_wrap = testInlineNumberThroughStringLenFunction(expr, from_stat_expr)) {
+        rule = FoldRule::StringLenWrapper;
         result.type = Solved::Type::Number;
         result.number_result = solveBinary(constant_wrap->op, constant_wrap->length, constant_wrap->number);
+    } else if (const Interpreted* interpreted = testBoundLocal(expr)) {
+        rule = FoldRule::Propagate;
+        AstLocal* local = getRootExpr(expr)->as<AstExprLocal>()->local;
+        if (interpreted->type == Interpreted::String) {
+            auto it = bound_strings.find(local);
+            if (it == bound_strings.end())
+                it = bound_strings.emplace(local, makeConstantString(expr->location, interpreted->string_result)).first;
+
+            result.type = Solved::Type::Expression;
+            result.expression_result = it->second;
+        } else
+            result = solveInterpreted(expr, *interpreted);
+    } else if (const Interpreted* interpreted = testBoundIndex(expr)) {
+        rule = FoldRule::TableIndex;
+        if (interpreted->type == Interpreted::String) {
+            auto it = bound_item_strings.find(interpreted);
+            if (it == bound_item_strings.end())
+                it = bound_item_strings.emplace(interpreted, makeConstantString(expr->location, interpreted->string_result)).first;
+
+            result.type = Solved::Type::Expression;
+            result.expression_result = it->second;
+        } else
+            result = solveInterpreted(expr, *interpreted);
+    } else if (const ProxyFold* proxy_fold = testProxyCall(expr)) {
+        rule = FoldRule::Proxy;
+        if (proxy_fold->type == Inlined) {
+            result.type = Solved::Expression;
+            result.expression_result = proxy_fold->inlined;
+        } else
+            result = solve(proxy_fold->inlined);
+    } else if (const Interpreted* interpreted = testInterpretedCall(expr, from_stat_expr)) {
+        rule = FoldRule::Interpret;
+        result = solveInterpreted(expr, *interpreted);
     } else if (auto simple = testSimpleFunctionCall(expr, from_stat_expr)) {
+        rule = FoldRule::SimpleCall;
         result.type = Solved::Expression;
         result.expression_result = simple.value();
     }
 
+    // only the outermost solve replaces a node, the ones for its operands are part of that fold
+    if (--solve_depth == 0 && rule != FoldRule::Count)
+        countFold(rule);
+
     return result;
 };
 
@@ -631,4 +1049,54 @@ std::string convertNumber(double value) {
     };
 
     return result;
-};
\ No newline at end of file
+};
+
+std::string numberToString(double value) {
+    if (std::isnan(value))
+        return std::signbit(value) ? "-nan" : "nan";
+    if (std::isinf(value))
+        return value < 0 ? "-inf" : "inf";
+    if (value == 0)
+        return std::signbit(value) ? "-0" : "0";
+
+    // %.16e always reads back the same, the shortest that does is also the closest of its length
+    char buffer[32];
+    for (int precision = 0; precision <= 16; precision++) {
+        snprintf(buffer, sizeof(buffer), "%.*e", precision, value);
+        if (strtod(buffer, nullptr) == value)
+            break;
+    };
+
+    std::string result = value < 0 ? "-" : "";
+    std::string digits;
+    char* exponent = buffer;
+    for (; *exponent != 'e'; exponent++)
+        if (*exponent >= '0' && *exponent <= '9')
+            digits += *exponent;
+
+    while (digits.size() > 1 && digits.back() == '0')
+        digits.pop_back();
+
+    // where the decimal point goes, counted from the first digit
+    int dot = atoi(exponent + 1) + 1;
+    int length = (int) digits.size();
+
+    // luau's limits for fixed notation, outside of them it's d.ddde+dd
+    if (dot >= -5 && dot <= 21) {
+        if (dot <= 0)
+            result.append("0.").append(-dot, '0').append(digits);
+        else if (dot >= length)
+            result.append(digits).append(dot - length, '0');
+        else
+            result.append(digits, 0, dot).append(".").append(digits, dot);
+    } else {
+        result += digits[0];
+        if (length > 1)
+            result.append(".").append(digits, 1);
+
+        snprintf(buffer, sizeof(buffer), "e%c%02d", dot - 1 < 0 ? '-' : '+', abs(dot - 1));
+        result.append(buffer);
+    };
+
+    return result;
+};
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <optional>
+#include <string>
+
 #include "Luau/Ast.h"
 #include "Luau/Lexer.h"
+#include "Luau/TimeTrace.h"
 
 using namespace Luau;
 
@@ -16,10 +20,21 @@ struct Solved {
     AstExpr* expression_result;
 };
 
+constexpr uint32_t fold_trace_threshold = 10;
+
 AstExpr* getRootExpr(AstExpr* expr);
+// luau's result of a math operator on two numbers
+double solveBinary(AstExprBinary::Op op, double left, double right);
+// the # of a table constructor that only has constant list items, using the same boundary search as luau
+std::optional<size_t> getTableSize(AstExprTable* table);
 
+// folds shorter than fold_trace_threshold microseconds are left out of --trace, there are far too many
 #define appendSolve(expr, format) \
-Solved solved = solve(expr); \
+Solved solved; \
+{ \
+    LUAU_TIMETRACE_OPTIONAL_TAIL_SCOPE("fold", "fold", fold_trace_threshold); \
+    solved = solve(expr); \
+}; \
 switch (solved.type) { \
     case Solved::Type::Number: \
         result.append(convertNumber(solved.number_result)); \
@@ -34,8 +49,24 @@ switch (solved.type) { \
 
 bool isSolvable(AstExpr* expr, bool from_stat_expr = false);
 Solved solve(AstExpr* expr, bool from_stat_expr = false);
+// the time this thread spent in isSolvable and solve since the last call, only measured while enabled. calls
+// made by other calls are part of theirs
+void setFoldTiming(bool enabled);
+double takeFoldMilliseconds();
+// whether expr folds to a constant that's truthy, nullopt when it doesn't fold to a constant
+std::optional<bool> getTruthiness(AstExpr* expr);
 void setupSolve(bool nosolve, bool ignore_types);
 
 void setAllocator(Luau::Allocator* allocator);
+// the facts about the whole chunk folding relies on (which builtin libraries are never changed, what the
+// locals that are never reassigned hold), after setAllocator. returns a digest of the builtins, which has to
+// be part of the incremental seed, the rest is in the keys of the subtrees that read it
+uint64_t prepareSolve(AstStatBlock* root);
+// in incremental runs, a digest of what every local read in a statement or function is bound to and of the
+// proxy it is, by the declaration each read resolves to. nullopt for nodes the passes made, which have no
+// tokens of their own
+std::optional<uint64_t> getBindingsDigest(AstNode* node);
 
-std::string convertNumber(double value);
\ No newline at end of file
+std::string convertNumber(double value);
+// tostring(number) the way luau does it, the fewest digits that read back as the same double
+std::string numberToString(double value);
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cache.hpp"
+
+using namespace Luau;
+
+#define STATS_NODE_CLASSES(X) \
+X(AstAttr) X(AstExprGroup) X(AstExprConstantNil) X(AstExprConstantBool) X(AstExprConstantNumber) \
+X(AstExprConstantString) X(AstExprLocal) X(AstExprGlobal) X(AstExprVarargs) X(AstExprCall) \
+X(AstExprIndexName) X(AstExprIndexExpr) X(AstExprFunction) X(AstExprTable) X(AstExprUnary) \
+X(AstExprBinary) X(AstExprTypeAssertion) X(AstExprIfElse) X(AstExprInterpString) X(AstStatBlock) \
+X(AstStatIf) X(AstStatWhile) X(AstStatRepeat) X(AstStatBreak) X(AstStatContinue) X(AstStatReturn) \
+X(AstStatExpr) X(AstStatLocal) X(AstStatFor) X(AstStatForIn) X(AstStatAssign) X(AstStatCompoundAssign) \
+X(AstStatFunction) X(AstStatLocalFunction) X(AstStatTypeAlias) X(AstStatDeclareGlobal) \
+X(AstStatDeclareFunction) X(AstStatDeclareClass) X(AstTypeReference) X(AstTypeTable) X(AstTypeFunction) \
+X(AstTypeTypeof) X(AstTypeUnion) X(AstTypeIntersection) X(AstExprError) X(AstStatError) X(AstTypeError) \
+X(AstTypeSingletonBool) X(AstTypeSingletonString) X(AstTypePackExplicit) X(AstTypePackVariadic) \
+X(AstTypePackGeneric)
+
+const char* fold_rule_names[(int) FoldRule::Count] = { "not", "negate", "string_length", "table_length", "arithmetic",
+    "comparison", "string_logic", "string_len_wrapper", "simple_call", "concat", "interpret", "propagate",
+    "table_index", "proxy" };
+const char* pass_rule_names[(int) PassRule::Count] = { "unwrap_loop", "if_break", "if_else_expression", "dead_branch",
+    "unreachable", "unflatten", "opaque_predicate", "unused_proxy" };
+const char* stats_phase_names[(int) StatsPhase::Count] = { "read", "parse", "emit", "write" };
+
+std::mutex stats_mutex;
+// one entry per thread that counted anything, they outlive their threads so they can be merged at the end
+std::vector<std::unique_ptr<EngineStats>> thread_stats;
+thread_local EngineStats* current_stats = nullptr;
+
+void EngineStats::merge(const EngineStats& other) {
+    documents += other.documents;
+    for (int index = 0; index < stats_node_classes; index++)
+        nodes[index] += other.nodes[index];
+    solvable_calls += other.solvable_calls;
+    solve_calls += other.solve_calls;
+    for (int rule = 0; rule < (int) FoldRule::Count; rule++)
+        folds[rule] += other.folds[rule];
+    for (int rule = 0; rule < (int) PassRule::Count; rule++)
+        rewrites[rule] += other.rewrites[rule];
+    pass_rounds += other.pass_rounds;
+    allocator_pages += other.allocator_pages;
+    allocator_bytes += other.allocator_bytes;
+    name_table_entries += other.name_table_entries;
+    output_bytes += other.output_bytes;
+    largest_output_buffer = std::max(largest_output_buffer, other.largest_output_buffer);
+    for (int phase = 0; phase < (int) StatsPhase::Count; phase++) {
+        phase_ms[phase] += other.phase_ms[phase];
+        phase_peak_heap[phase] = std::max(phase_peak_heap[phase], other.phase_peak_heap[phase]);
+    }
+};
+
+void setStatsEnabled(bool enabled) {
+    stats_enabled = enabled;
+};
+
+EngineStats& getThreadStats() {
+    if (!current_stats) {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        thread_stats.push_back(std::make_unique<EngineStats>());
+        current_stats = thread_stats.back().get();
+    }
+
+    return *current_stats;
+};
+
+const char* getNodeClassName(int class_index) {
+    static std::vector<const char*> names = [] {
+        std::vector<const char*> names(stats_node_classes, nullptr);
+        #define nameClass(Class) names[Class::ClassIndex()] = #Class;
+        STATS_NODE_CLASSES(nameClass)
+        #undef nameClass
+        return names;
+    }();
+
+    return class_index >= 0 && class_index < stats_node_classes ? names[class_index] : nullptr;
+};
+
+struct NodeCountVisitor : AstVisitor {
+    size_t* nodes;
+
+    NodeCountVisitor(size_t* nodes)
+        : nodes(nodes) {}
+
+    bool visit(AstNode* node) override {
+        if (node->classIndex >= 0 && node->classIndex < stats_node_classes)
+            nodes[node->classIndex]++;
+        return true;
+    }
+
+    // types aren't visited by default
+    bool visit(AstType* type) override {
+        return visit(static_cast<AstNode*>(type));
+    }
+    bool visit(AstTypePack* type_pack) override {
+        return visit(static_cast<AstNode*>(type_pack));
+    }
+};
+
+void countDocument(AstNode* root) {
+    if (!stats_enabled)
+        return;
+
+    EngineStats& stats = getThreadStats();
+    stats.documents++;
+
+    NodeCountVisitor visitor(stats.nodes);
+    root->visit(&visitor);
+};
+
+size_t getFoldCount(const EngineStats& stats) {
+    size_t total = 0;
+    for (size_t count : stats.folds)
+        total += count;
+    return total;
+};
+
+void appendStatsCounters(std::string& out, const EngineStats& stats) {
+    char buffer[384];
+    snprintf(buffer, sizeof(buffer), "\"documents\":%zu,\"is_solvable_calls\":%zu,\"solve_calls\":%zu,\"folds\":%zu,\"output_bytes\":%zu,"
+        "\"largest_output_buffer\":%zu,\"allocator_pages\":%zu,\"allocator_bytes\":%zu,\"name_table_entries\":%zu,\"phase_ms\":{",
+        stats.documents, stats.solvable_calls, stats.solve_calls, getFoldCount(stats), stats.output_bytes,
+        stats.largest_output_buffer, stats.allocator_pages, stats.allocator_bytes, stats.name_table_entries);
+    out.append(buffer);
+
+    for (int phase = 0; phase < (int) StatsPhase::Count; phase++) {
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%.3f", phase == 0 ? "" : ",", stats_phase_names[phase], stats.phase_ms[phase]);
+        out.append(buffer);
+    }
+    out += '}';
+
+    if (!heap_counting)
+        return;
+
+    out.append(",\"phase_peak_heap\":{");
+    for (int phase = 0; phase < (int) StatsPhase::Count; phase++) {
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%zu", phase == 0 ? "" : ",", stats_phase_names[phase], stats.phase_peak_heap[phase]);
+        out.append(buffer);
+    }
+    out += '}';
+};
+
+void appendStatsJson(std::string& out) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+
+    EngineStats total;
+    for (const std::unique_ptr<EngineStats>& stats : thread_stats)
+        total.merge(*stats);
+
+    appendStatsCounters(out, total);
+
+    char buffer[128];
+    out.append(",\"nodes\":{");
+    bool first = true;
+    for (int index = 0; index < stats_node_classes; index++) {
+        if (total.nodes[index] == 0)
+            continue;
+
+        const char* name = getNodeClassName(index);
+        if (name)
+            snprintf(buffer, sizeof(buffer), "%s\"%s\":%zu", first ? "" : ",", name, total.nodes[index]);
+        else
+            snprintf(buffer, sizeof(buffer), "%s\"%d\":%zu", first ? "" : ",", index, total.nodes[index]);
+        out.append(buffer);
+        first = false;
+    }
+
+    out.append("},\"folds_by_rule\":{");
+    for (int rule = 0; rule < (int) FoldRule::Count; rule++) {
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%zu", rule == 0 ? "" : ",", fold_rule_names[rule], total.folds[rule]);
+        out.append(buffer);
+    }
+
+    out.append("},\"rewrites_by_pass\":{");
+    for (int rule = 0; rule < (int) PassRule::Count; rule++) {
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":%zu", rule == 0 ? "" : ",", pass_rule_names[rule], total.rewrites[rule]);
+        out.append(buffer);
+    }
+
+    IncrementalStats incremental = getIncrementalStats();
+    snprintf(buffer, sizeof(buffer), "},\"pass_rounds\":%zu,\"incremental_cache\":{\"hits\":%zu,\"misses\":%zu,\"entries\":%zu,\"bytes\":%zu}",
+        total.pass_rounds, incremental.hits, incremental.misses, incremental.entries, incremental.bytes);
+    out.append(buffer);
+
+    snprintf(buffer, sizeof(buffer), ",\"peak_rss_kb\":%ld", getPeakRssKb());
+    out.append(buffer);
+    if (heap_counting) {
+        snprintf(buffer, sizeof(buffer), ",\"heap\":{\"bytes\":%zu,\"peak_bytes\":%zu}", getHeapBytes(), getPeakHeapBytes());
+        out.append(buffer);
+    }
+
+    out.append(",\"workers\":[");
+    for (size_t index = 0; index < thread_stats.size(); index++) {
+        out.append(index == 0 ? "{" : ",{");
+        appendStatsCounters(out, *thread_stats[index]);
+        out += '}';
+    }
+    out += ']';
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+
+#include "memory.hpp"
+
+// --stats counters. every thread counts into its own EngineStats, nothing on the hot path is atomic,
+// and they are only merged once the threads are done. nothing is counted until stats are enabled
+
+// which of solve's rules folded an expression, counted once per node a fold replaces
+enum class FoldRule {
+    Not, // not <constant>
+    Negate, // -<number>
+    StringLength, // #"string"
+    TableLength, // #{ 1, 2, 3 }
+    Arithmetic, // <number> + <number>, and every other number operator
+    Comparison, // <number> < <number>, "a" == "b"
+    StringLogic, // "a" and "b"
+    StringLenWrapper, // (function(a) return #a - 9 end)("some string")
+    SimpleCall, // (function() return x end)()
+    Concat, // "a" .. 1 .. "b", once per chain
+    Interpret, // (function(s) ... end)("..."), evaluated by interpret.cpp
+    Propagate, // local a = 5 ... a, a local that is never assigned again
+    TableIndex, // local t = { "a", "b" } ... t[2], a list that is only ever indexed
+    Proxy, // local function f(a, b) return a + b end ... f(x, y), see proxies.hpp
+    Count
+};
+
+// which of the passes in passes.cpp rewrote a statement
+enum class PassRule {
+    UnwrapLoop, // for i = 1, 1 do <x> break end, with --extra1
+    IfBreak, // if a then <x> break end <y>, with --extra1
+    IfElseExpression, // local a = if b then c else d, with --replaceifelseexpr
+    DeadBranch, // if false then, while false do, a branch that always runs, an empty do block
+    Unreachable, // a statement after return, break or continue, each one counted
+    Unflatten, // local state = 1 while state ~= 0 do if state == 1 then ... end end, see unflatten.hpp
+    OpaquePredicate, // if (x * x) % 2 ~= 2 then, decided by the ranges of its locals, see predicates.hpp
+    UnusedProxy, // local function f(a, b) return a + b end, once every call of it was inlined
+    Count
+};
+
+enum class StatsPhase {
+    Read,
+    Parse,
+    Emit, // beautify or minify, passes and folding included
+    Write,
+    Count
+};
+
+// classIndex values are handed out per AST class, there are fewer than this
+constexpr int stats_node_classes = 64;
+
+struct EngineStats {
+    size_t documents = 0;
+    size_t nodes[stats_node_classes] = {};
+    size_t solvable_calls = 0;
+    size_t solve_calls = 0;
+    size_t folds[(int) FoldRule::Count] = {};
+    size_t rewrites[(int) PassRule::Count] = {};
+    size_t pass_rounds = 0;
+    size_t allocator_pages = 0;
+    size_t allocator_bytes = 0;
+    size_t name_table_entries = 0;
+    size_t output_bytes = 0;
+    size_t largest_output_buffer = 0; // capacity of the biggest string a document was printed into
+    double phase_ms[(int) StatsPhase::Count] = {};
+    // the most heap one run of the phase needed, only counted with heap counting (memory.hpp) on
+    size_t phase_peak_heap[(int) StatsPhase::Count] = {};
+
+    void merge(const EngineStats& other);
+};
+
+inline bool stats_enabled = false;
+void setStatsEnabled(bool enabled);
+
+// the calling thread's counters, created on first use
+EngineStats& getThreadStats();
+
+#define countStats(field, amount) \
+do { \
+    if (stats_enabled) \
+        getThreadStats().field += amount; \
+} while (false)
+
+#define countFold(rule) countStats(folds[(int) (rule)], 1)
+#define countPass(rule) countStats(rewrites[(int) PassRule::rule], 1)
+
+#define maxStats(field, value) \
+do { \
+    if (stats_enabled) { \
+        EngineStats& stats_ = getThreadStats(); \
+        stats_.field = std::max(stats_.field, (size_t) (value)); \
+    } \
+} while (false)
+
+// adds the time until it goes out of scope to phase, and the heap it needed to the phase's peak
+struct StatsTimer {
+    StatsPhase phase;
+    std::chrono::steady_clock::time_point start;
+    HeapScope heap;
+
+    StatsTimer(StatsPhase phase)
+        : phase(phase) {
+        if (stats_enabled)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~StatsTimer() {
+        size_t peak_heap = heap.end();
+        if (stats_enabled) {
+            EngineStats& stats = getThreadStats();
+            stats.phase_ms[(int) phase] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            stats.phase_peak_heap[(int) phase] = std::max(stats.phase_peak_heap[(int) phase], peak_heap);
+        }
+    }
+};
+
+// adds a parsed document and its nodes by class, before anything rewrites them
+void countDocument(Luau::AstNode* root);
+
+// the fields (without the braces) of a JSON object with the totals of every thread that counted
+// anything and a "workers" array with each one of them. the process' peak RSS is always in it, the
+// heap totals when heap counting is on
+void appendStatsJson(std::string& out);
@@ -0,0 +1,993 @@
+#include "unflatten.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Luau/TimeTrace.h"
+
+#include "passes.hpp"
+#include "solve.hpp"
+#include "stats.hpp"
+
+using namespace Luau;
+
+thread_local Allocator* unflatten_allocator = nullptr;
+
+AstArray<AstStat*> copyStats(const std::vector<AstStat*>& stats) {
+    AstStat** copy = (AstStat**) unflatten_allocator->allocate(sizeof(AstStat*) * stats.size());
+    std::copy(stats.begin(), stats.end(), copy);
+    return { copy, stats.size() };
+};
+
+std::optional<double> getConstantNumber(AstExpr* expr) {
+    expr = getRootExpr(expr);
+    if (AstExprConstantNumber* expr_number = expr->as<AstExprConstantNumber>())
+        return expr_number->value;
+    if (!isSolvable(expr))
+        return std::nullopt;
+
+    Solved solved = solve(expr);
+    if (solved.type == Solved::Type::Number)
+        return solved.number_result;
+    else if (solved.type == Solved::Type::Expression)
+        if (AstExprConstantNumber* expr_number = getRootExpr(solved.expression_result)->as<AstExprConstantNumber>())
+            return expr_number->value;
+
+    return std::nullopt;
+};
+
+bool isStateLocal(AstExpr* expr, AstLocal* state) {
+    AstExprLocal* expr_local = getRootExpr(expr)->as<AstExprLocal>();
+    return expr_local && expr_local->local == state;
+};
+
+// a condition of the dispatch with the state set to value: state compared to a number on either side, and
+// not, and, or of those. nullopt for anything else, whatever the value
+std::optional<bool> testState(AstExpr* expr, AstLocal* state, double value) {
+    expr = getRootExpr(expr);
+    if (AstExprUnary* expr_unary = expr->as<AstExprUnary>()) {
+        if (expr_unary->op != AstExprUnary::Op::Not)
+            return std::nullopt;
+
+        std::optional<bool> operand = testState(expr_unary->expr, state, value);
+        if (!operand)
+            return std::nullopt;
+        return !*operand;
+    };
+
+    AstExprBinary* expr_binary = expr->as<AstExprBinary>();
+    if (!expr_binary)
+        return std::nullopt;
+
+    if (expr_binary->op == AstExprBinary::Op::And || expr_binary->op == AstExprBinary::Op::Or) {
+        std::optional<bool> left = testState(expr_binary->left, state, value);
+        std::optional<bool> right = testState(expr_binary->right, state, value);
+        if (!left || !right)
+            return std::nullopt;
+        return expr_binary->op == AstExprBinary::Op::And ? *left && *right : *left || *right;
+    };
+
+    double left, right;
+    if (isStateLocal(expr_binary->left, state)) {
+        std::optional<double> number = getConstantNumber(expr_binary->right);
+        if (!number)
+            return std::nullopt;
+        left = value;
+        right = *number;
+    } else if (isStateLocal(expr_binary->right, state)) {
+        std::optional<double> number = getConstantNumber(expr_binary->left);
+        if (!number)
+            return std::nullopt;
+        left = *number;
+        right = value;
+    } else
+        return std::nullopt;
+
+    switch (expr_binary->op) {
+        case AstExprBinary::Op::CompareEq:
+            return left == right;
+        case AstExprBinary::Op::CompareNe:
+            return left != right;
+        case AstExprBinary::Op::CompareLt:
+            return left < right;
+        case AstExprBinary::Op::CompareLe:
+            return left <= right;
+        case AstExprBinary::Op::CompareGt:
+            return left > right;
+        case AstExprBinary::Op::CompareGe:
+            return left >= right;
+        default:
+            return std::nullopt;
+    };
+};
+
+// an if and its elseifs in the dispatch. the long flat chains are looked up in a hash map instead of being
+// tested link by link, so resolving every state stays linear
+struct DispatchChain {
+    std::vector<AstStatIf*> links;
+    AstStatBlock* else_block = nullptr;
+    // when every condition is state == <number>, the first link each number takes
+    bool is_switch = false;
+    std::unordered_map<double, size_t> cases;
+};
+
+struct Dispatcher {
+    AstLocal* state;
+    AstStatIf* root;
+    std::optional<double> exit_state; // while state ~= <number>
+    std::unordered_map<AstStatIf*, DispatchChain> chains;
+
+    // the if a block of the dispatch continues the dispatch with, when it holds nothing else
+    AstStatIf* getNestedDispatch(AstStatBlock* block) {
+        if (block->body.size != 1)
+            return nullptr;
+
+        AstStatIf* stat_if = block->body.data[0]->as<AstStatIf>();
+        return stat_if && testState(stat_if->condition, state, 0) ? stat_if : nullptr;
+    };
+
+    DispatchChain& getChain(AstStatIf* head) {
+        auto [found, inserted] = chains.try_emplace(head);
+        DispatchChain& chain = found->second;
+        if (!inserted)
+            return chain;
+
+        AstStat* link = head;
+        while (AstStatIf* stat_if = link ? link->as<AstStatIf>() : nullptr) {
+            chain.links.push_back(stat_if);
+            link = stat_if->elsebody;
+        };
+        chain.else_block = link ? link->as<AstStatBlock>() : nullptr;
+
+        chain.is_switch = true;
+        for (size_t index = 0; index < chain.links.size(); index++) {
+            AstExprBinary* expr_binary = getRootExpr(chain.links[index]->condition)->as<AstExprBinary>();
+            std::optional<double> number;
+            if (expr_binary && expr_binary->op == AstExprBinary::Op::CompareEq) {
+                if (isStateLocal(expr_binary->left, state))
+                    number = getConstantNumber(expr_binary->right);
+                else if (isStateLocal(expr_binary->right, state))
+                    number = getConstantNumber(expr_binary->left);
+            };
+
+            if (!number) {
+                chain.is_switch = false;
+                chain.cases.clear();
+                break;
+            };
+            chain.cases.try_emplace(*number, index);
+        };
+
+        return chain;
+    };
+
+    // the block that runs when the state is value, nullptr when none does or a condition isn't about the state
+    AstStatBlock* resolve(double value) {
+        AstStatIf* head = root;
+        while (true) {
+            DispatchChain& chain = getChain(head);
+            AstStatBlock* taken = chain.else_block;
+            if (chain.is_switch) {
+                auto found = chain.cases.find(value);
+                if (found != chain.cases.end())
+                    taken = chain.links[found->second]->thenbody;
+            } else {
+                for (AstStatIf* link : chain.links) {
+                    std::optional<bool> result = testState(link->condition, state, value);
+                    if (!result)
+                        return nullptr;
+                    else if (*result) {
+                        taken = link->thenbody;
+                        break;
+                    };
+                };
+            };
+
+            if (!taken)
+                return nullptr;
+
+            head = getNestedDispatch(taken);
+            if (!head)
+                return taken;
+        };
+    };
+};
+
+// the rest of a state block can't read or write the state, and can't break out of or continue the
+// dispatcher loop, only loops of its own
+struct StateUseVisitor : AstVisitor {
+    AstLocal* state;
+    size_t loops = 0;
+    bool valid = true;
+
+    StateUseVisitor(AstLocal* state)
+        : state(state) {};
+
+    void visitLoopBody(AstStatBlock* body) {
+        loops++;
+        body->visit(this);
+        loops--;
+    };
+
+    bool visit(AstExprLocal* expr_local) override {
+        if (expr_local->local == state)
+            valid = false;
+        return false;
+    };
+    bool visit(AstStatBreak* stat_break) override {
+        if (loops == 0)
+            valid = false;
+        return false;
+    };
+    bool visit(AstStatContinue* stat_continue) override {
+        if (loops == 0)
+            valid = false;
+        return false;
+    };
+
+    bool visit(AstStatWhile* stat_while) override {
+        stat_while->condition->visit(this);
+        visitLoopBody(stat_while->body);
+        return false;
+    };
+    bool visit(AstStatRepeat* stat_repeat) override {
+        visitLoopBody(stat_repeat->body);
+        stat_repeat->condition->visit(this);
+        return false;
+    };
+    bool visit(AstStatFor* stat_for) override {
+        stat_for->from->visit(this);
+        stat_for->to->visit(this);
+        if (stat_for->step)
+            stat_for->step->visit(this);
+        visitLoopBody(stat_for->body);
+        return false;
+    };
+    bool visit(AstStatForIn* stat_for_in) override {
+        for (AstExpr* value : stat_for_in->values)
+            value->visit(this);
+        visitLoopBody(stat_for_in->body);
+        return false;
+    };
+    bool visit(AstExprFunction* expr_function) override {
+        visitLoopBody(expr_function->body);
+        return false;
+    };
+};
+
+// in_loop when body isn't part of the dispatcher, and can break out of the loop it's in
+bool isStateFree(AstArray<AstStat*> body, AstLocal* state, bool in_loop = false) {
+    StateUseVisitor visitor(state);
+    visitor.loops = in_loop;
+    for (AstStat* stat : body)
+        stat->visit(&visitor);
+    return visitor.valid;
+};
+
+// a block of the dispatch and how it leaves: the state it sets next, one of two states depending on a
+// condition, out of the loop with a break, or out of the function
+struct StateBlock {
+    AstStatBlock* block;
+    AstArray<AstStat*> body = {}; // without the jump, unless it's a return
+    enum Jump {
+        Goto,
+        Branch,
+        Exit,
+        Return
+    } jump = Goto;
+    AstStat* jump_stat = nullptr;
+    AstExpr* condition = nullptr;
+    AstArray<AstStat*> branch_bodies[2] = {}; // what an if runs before setting the state in each branch
+    double targets[2] = {};
+    int successors[2] = { -1, -1 };
+};
+
+// what stat sets the state to, when that's all it does
+AstExpr* getStateValue(AstStat* stat, AstLocal* state) {
+    AstStatAssign* stat_assign = stat->as<AstStatAssign>();
+    if (!stat_assign || stat_assign->vars.size != 1 || stat_assign->values.size != 1 || !isStateLocal(stat_assign->vars.data[0], state))
+        return nullptr;
+    return stat_assign->values.data[0];
+};
+
+// state = <number>, state = c and <number> or <number>, if c then ... state = <number> else ... state = <number>
+// end (or state = <number> if c then ... state = <number> end), return, break
+bool analyzeJump(StateBlock& node, AstLocal* state) {
+    AstArray<AstStat*> body = node.block->body;
+    if (body.size == 0)
+        return false;
+
+    AstStat* last = body.data[body.size - 1];
+    node.body = { body.data, body.size - 1 };
+    node.jump_stat = last;
+
+    if (last->is<AstStatReturn>()) {
+        node.jump = StateBlock::Return;
+        node.body = body;
+        return isStateFree(node.body, state);
+    } else if (last->is<AstStatBreak>()) {
+        node.jump = StateBlock::Exit;
+        return isStateFree(node.body, state);
+    } else if (AstExpr* value = getStateValue(last, state)) {
+        if (std::optional<double> target = getConstantNumber(value)) {
+            node.jump = StateBlock::Goto;
+            node.targets[0] = *target;
+            return isStateFree(node.body, state);
+        };
+
+        AstExprBinary* either = getRootExpr(value)->as<AstExprBinary>();
+        AstExprBinary* both = either && either->op == AstExprBinary::Op::Or ? getRootExpr(either->left)->as<AstExprBinary>() : nullptr;
+        if (!both || both->op != AstExprBinary::Op::And)
+            return false;
+
+        std::optional<double> when_true = getConstantNumber(both->right);
+        std::optional<double> when_false = getConstantNumber(either->right);
+        if (!when_true || !when_false)
+            return false;
+
+        StateUseVisitor visitor(state);
+        both->left->visit(&visitor);
+        node.jump = StateBlock::Branch;
+        node.condition = both->left;
+        node.targets[0] = *when_true;
+        node.targets[1] = *when_false;
+        return visitor.valid && isStateFree(node.body, state);
+    };
+
+    AstStatIf* stat_if = last->as<AstStatIf>();
+    if (!stat_if || (stat_if->elsebody && !stat_if->elsebody->is<AstStatBlock>()))
+        return false;
+
+    auto splitBranch = [&](AstStatBlock* branch, int index) {
+        if (branch->body.size == 0)
+            return false;
+
+        AstExpr* value = getStateValue(branch->body.data[branch->body.size - 1], state);
+        std::optional<double> target = value ? getConstantNumber(value) : std::nullopt;
+        if (!target)
+            return false;
+
+        node.branch_bodies[index] = { branch->body.data, branch->body.size - 1 };
+        node.targets[index] = *target;
+        return isStateFree(node.branch_bodies[index], state);
+    };
+
+    if (!splitBranch(stat_if->thenbody, 0))
+        return false;
+
+    if (AstStatBlock* else_block = stat_if->elsebody ? stat_if->elsebody->as<AstStatBlock>() : nullptr) {
+        if (!splitBranch(else_block, 1))
+            return false;
+    } else {
+        AstExpr* value = body.size >= 2 ? getStateValue(body.data[body.size - 2], state) : nullptr;
+        std::optional<double> target = value ? getConstantNumber(value) : std::nullopt;
+        if (!target)
+            return false;
+
+        node.body.size--;
+        node.targets[1] = *target;
+    };
+
+    StateUseVisitor visitor(state);
+    stat_if->condition->visit(&visitor);
+    node.jump = StateBlock::Branch;
+    node.condition = stat_if->condition;
+    return visitor.valid && isStateFree(node.body, state);
+};
+
+// the state blocks reachable from the first state, then the code after the loop and the end of the function
+struct FlowGraph {
+    std::vector<StateBlock> nodes;
+    int entry = 0;
+    int exit_node = 0;
+    int end_node = 0;
+
+    std::vector<std::vector<int>> predecessors;
+    std::vector<int> post_dominators; // the immediate one, -1 for nodes that only return or loop forever
+    std::vector<int> loop_of; // the innermost loop a node is in, by its header
+    std::vector<int> loop_parents; // the loop a header's loop is nested in
+    std::vector<int> loop_exits; // the one node a loop leaves to, -1 when it doesn't
+    std::vector<char> is_header;
+
+    int getSuccessorCount(int node) const {
+        if (node == exit_node)
+            return 1;
+        else if (node == end_node)
+            return 0;
+
+        switch (nodes[node].jump) {
+            case StateBlock::Goto:
+            case StateBlock::Exit:
+                return 1;
+            case StateBlock::Branch:
+                return 2;
+            case StateBlock::Return:
+                break;
+        };
+        // returns lead nowhere, so they don't decide where the branches around them join
+        return 0;
+    };
+
+    int getSuccessor(int node, int index) const {
+        return node == exit_node ? end_node : nodes[node].successors[index];
+    };
+
+    bool isInLoop(int node, int header) const {
+        if (node < 0 || node >= (int) nodes.size())
+            return false;
+
+        for (int loop = loop_of[node]; loop != -1; loop = loop_parents[loop])
+            if (loop == header)
+                return true;
+        return false;
+    };
+};
+
+bool buildGraph(Dispatcher& dispatcher, double initial, FlowGraph& graph) {
+    constexpr int exit_marker = -2;
+    std::unordered_map<double, int> state_nodes;
+    std::unordered_map<AstStatBlock*, int> block_nodes;
+
+    auto getNode = [&](double value) -> std::optional<int> {
+        if (dispatcher.exit_state && value == *dispatcher.exit_state)
+            return exit_marker;
+
+        auto found = state_nodes.find(value);
+        if (found != state_nodes.end())
+            return found->second;
+
+        AstStatBlock* block = dispatcher.resolve(value);
+        if (!block)
+            return std::nullopt;
+
+        auto [node, inserted] = block_nodes.try_emplace(block, (int) graph.nodes.size());
+        if (inserted) {
+            graph.nodes.emplace_back();
+            graph.nodes.back().block = block;
+        };
+        state_nodes.emplace(value, node->second);
+        return node->second;
+    };
+
+    std::optional<int> entry = getNode(initial);
+    if (!entry)
+        return false;
+    graph.entry = *entry;
+
+    // nodes are added while they're walked, so they are only ever reached by index
+    for (size_t index = 0; index < graph.nodes.size(); index++) {
+        if (!analyzeJump(graph.nodes[index], dispatcher.state))
+            return false;
+
+        int count = 0;
+        switch (graph.nodes[index].jump) {
+            case StateBlock::Goto:
+                count = 1;
+                break;
+            case StateBlock::Branch:
+                count = 2;
+                break;
+            case StateBlock::Exit:
+                graph.nodes[index].successors[0] = exit_marker;
+                break;
+            case StateBlock::Return:
+                break;
+        };
+
+        for (int successor = 0; successor < count; successor++) {
+            std::optional<int> target = getNode(graph.nodes[index].targets[successor]);
+            if (!target)
+                return false;
+            graph.nodes[index].successors[successor] = *target;
+        };
+    };
+
+    graph.exit_node = (int) graph.nodes.size();
+    graph.end_node = graph.exit_node + 1;
+    if (graph.entry == exit_marker)
+        graph.entry = graph.exit_node;
+    for (StateBlock& node : graph.nodes)
+        for (int& successor : node.successors)
+            if (successor == exit_marker)
+                successor = graph.exit_node;
+
+    graph.predecessors.assign(graph.end_node + 1, {});
+    for (int node = 0; node <= graph.end_node; node++)
+        for (int index = 0; index < graph.getSuccessorCount(node); index++)
+            graph.predecessors[graph.getSuccessor(node, index)].push_back(node);
+
+    return true;
+};
+
+// cooper, harvey and kennedy's iterative dominators, on the reversed graph from the end of the function
+void findPostDominators(FlowGraph& graph) {
+    int size = graph.end_node + 1;
+    std::vector<int> postorder;
+    std::vector<int> numbers(size, -1);
+    std::vector<char> visited(size, false);
+    std::vector<std::pair<int, size_t>> stack = { { graph.end_node, 0 } };
+    visited[graph.end_node] = true;
+    while (!stack.empty()) {
+        auto& [node, next] = stack.back();
+        if (next < graph.predecessors[node].size()) {
+            int predecessor = graph.predecessors[node][next++];
+            if (!visited[predecessor]) {
+                visited[predecessor] = true;
+                stack.push_back({ predecessor, 0 });
+            };
+            continue;
+        };
+
+        numbers[node] = (int) postorder.size();
+        postorder.push_back(node);
+        stack.pop_back();
+    };
+
+    std::vector<int>& dominators = graph.post_dominators;
+    dominators.assign(size, -1);
+    dominators[graph.end_node] = graph.end_node;
+
+    auto intersect = [&](int left, int right) {
+        while (left != right) {
+            while (numbers[left] < numbers[right])
+                left = dominators[left];
+            while (numbers[right] < numbers[left])
+                right = dominators[right];
+        };
+        return left;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto node = postorder.rbegin(); node != postorder.rend(); node++) {
+            if (*node == graph.end_node)
+                continue;
+
+            int dominator = -1;
+            for (int index = 0; index < graph.getSuccessorCount(*node); index++) {
+                int successor = graph.getSuccessor(*node, index);
+                if (dominators[successor] == -1)
+                    continue;
+                dominator = dominator == -1 ? successor : intersect(successor, dominator);
+            };
+
+            if (dominator != dominators[*node]) {
+                dominators[*node] = dominator;
+                changed = true;
+            };
+        };
+    };
+};
+
+// natural loops, innermost first, with the nesting found the way havlak does it. false when the graph is
+// irreducible, or a loop leaves to more than one place
+bool findLoops(FlowGraph& graph) {
+    int size = graph.end_node + 1;
+    int state_count = (int) graph.nodes.size();
+    std::vector<int> preorder(size, -1);
+    std::vector<char> on_stack(size, false);
+    std::vector<std::vector<int>> latches(size);
+    std::vector<int> headers;
+
+    std::vector<std::pair<int, int>> stack = { { graph.entry, 0 } };
+    preorder[graph.entry] = 0;
+    on_stack[graph.entry] = true;
+    int visited = 1;
+    while (!stack.empty()) {
+        auto& [node, next] = stack.back();
+        if (next < graph.getSuccessorCount(node)) {
+            int successor = graph.getSuccessor(node, next++);
+            if (preorder[successor] == -1) {
+                preorder[successor] = visited++;
+                on_stack[successor] = true;
+                stack.push_back({ successor, 0 });
+            } else if (on_stack[successor]) {
+                if (latches[successor].empty())
+                    headers.push_back(successor);
+                latches[successor].push_back(node);
+            };
+            continue;
+        };
+
+        on_stack[node] = false;
+        stack.pop_back();
+    };
+
+    graph.loop_of.assign(size, -1);
+    graph.loop_parents.assign(size, -1);
+    graph.loop_exits.assign(size, -1);
+    graph.is_header.assign(size, false);
+
+    std::sort(headers.begin(), headers.end(), [&](int left, int right) {
+        return preorder[left] > preorder[right];
+    });
+
+    for (int header : headers) {
+        if (graph.loop_of[header] != -1)
+            return false;
+        graph.loop_of[header] = header;
+        graph.is_header[header] = true;
+
+        std::vector<int> work;
+        for (int latch : latches[header])
+            if (latch != header)
+                work.push_back(latch);
+
+        while (!work.empty()) {
+            int node = work.back();
+            work.pop_back();
+
+            if (graph.loop_of[node] != -1) {
+                // the whole of an inner loop, the way into it is through its header
+                int outer = graph.loop_of[node];
+                while (graph.loop_parents[outer] != -1)
+                    outer = graph.loop_parents[outer];
+                if (outer == header)
+                    continue;
+
+                graph.loop_parents[outer] = header;
+                node = outer;
+            } else
+                graph.loop_of[node] = header;
+
+            // a way into the loop that skips the header
+            if (node == graph.entry)
+                return false;
+
+            for (int predecessor : graph.predecessors[node])
+                if (predecessor != header)
+                    work.push_back(predecessor);
+        };
+    };
+
+    for (int node = 0; node < state_count; node++) {
+        if (graph.loop_of[node] == -1)
+            continue;
+
+        for (int index = 0; index < graph.getSuccessorCount(node); index++) {
+            int successor = graph.getSuccessor(node, index);
+            for (int loop = graph.loop_of[node]; loop != -1 && !graph.isInLoop(successor, loop); loop = graph.loop_parents[loop]) {
+                if (graph.loop_exits[loop] != -1 && graph.loop_exits[loop] != successor)
+                    return false;
+                graph.loop_exits[loop] = successor;
+            };
+        };
+    };
+
+    return true;
+};
+
+// a name the block declares that the code put in its scope uses for something else, a global or another local
+struct NameCaptureVisitor : AstVisitor {
+    std::vector<AstLocal*> declared;
+    bool captured = false;
+
+    bool isCaptured(AstName name, AstLocal* local) {
+        for (AstLocal* declared_local : declared)
+            if (declared_local->name == name && declared_local != local)
+                return true;
+        return false;
+    };
+
+    bool visit(AstExprLocal* expr_local) override {
+        captured |= isCaptured(expr_local->local->name, expr_local->local);
+        return false;
+    };
+    bool visit(AstExprGlobal* expr_global) override {
+        captured |= isCaptured(expr_global->name, nullptr);
+        return false;
+    };
+};
+
+bool capturesNames(AstStatBlock* scope, const std::vector<AstStat*>& stats) {
+    NameCaptureVisitor visitor;
+    for (AstStat* stat : scope->body) {
+        if (AstStatLocal* stat_local = stat->as<AstStatLocal>())
+            visitor.declared.insert(visitor.declared.end(), stat_local->vars.begin(), stat_local->vars.end());
+        else if (AstStatLocalFunction* stat_function = stat->as<AstStatLocalFunction>())
+            visitor.declared.push_back(stat_function->name);
+        else if (stat->is<AstStatTypeAlias>())
+            return true;
+    };
+
+    for (AstStat* stat : stats)
+        stat->visit(&visitor);
+    return visitor.captured;
+};
+
+// prints the graph back as structured code. every node is emitted once: reaching one that already was means
+// the graph needs a goto, and the whole dispatcher is left alone
+struct Emitter {
+    enum Flow {
+        FallsThrough, // reached the node the region stops at
+        Jumps, // every path returned, broke out or continued
+        Failed
+    };
+
+    const FlowGraph& graph;
+    std::vector<char> emitted;
+    std::vector<int> loops; // headers of the loops being emitted, innermost last
+    size_t nesting = 0;
+
+    Emitter(const FlowGraph& graph)
+        : graph(graph), emitted(graph.nodes.size(), false) {};
+
+    void appendBody(std::vector<AstStat*>& out, AstStatBlock* block, AstArray<AstStat*> body) {
+        if (body.size == 0)
+            return;
+
+        // the blocks were scopes of their own, their locals can't leak into what follows them
+        AstStatBlock* copy = unflatten_allocator->alloc<AstStatBlock>(block->location, body, true);
+        if (declaresLocals(copy))
+            out.push_back(copy);
+        else
+            out.insert(out.end(), body.data, body.data + body.size);
+    };
+
+    AstExpr* negate(AstExpr* condition) {
+        AstExpr* root = getRootExpr(condition);
+        if (AstExprUnary* expr_unary = root->as<AstExprUnary>(); expr_unary && expr_unary->op == AstExprUnary::Op::Not)
+            return getRootExpr(expr_unary->expr);
+
+        if (!root->is<AstExprLocal>() && !root->is<AstExprGlobal>() && !root->is<AstExprCall>() && !root->is<AstExprIndexName>()
+            && !root->is<AstExprIndexExpr>() && !root->is<AstExprGroup>())
+            condition = unflatten_allocator->alloc<AstExprGroup>(condition->location, condition);
+        return unflatten_allocator->alloc<AstExprUnary>(condition->location, AstExprUnary::Op::Not, condition);
+    };
+
+    AstStat* makeIf(const Location& location, AstExpr* condition, std::vector<AstStat*>& then_body, std::vector<AstStat*>& else_body) {
+        if (then_body.empty() && !else_body.empty()) {
+            condition = negate(condition);
+            std::swap(then_body, else_body);
+        };
+
+        AstStatBlock* then_block = unflatten_allocator->alloc<AstStatBlock>(location, copyStats(then_body), true);
+        AstStat* else_stat = nullptr;
+        if (else_body.size() == 1 && else_body[0]->is<AstStatIf>())
+            else_stat = else_body[0];
+        else if (!else_body.empty())
+            else_stat = unflatten_allocator->alloc<AstStatBlock>(location, copyStats(else_body), true);
+
+        return unflatten_allocator->alloc<AstStatIf>(location, condition, then_block, else_stat, std::nullopt, std::nullopt);
+    };
+
+    // while true do if c then break end ... end is while not c do ... end
+    AstStat* makeLoop(const Location& location, std::vector<AstStat*>& body) {
+        AstExpr* condition = unflatten_allocator->alloc<AstExprConstantBool>(location, true);
+        AstStatIf* first_if = body.empty() ? nullptr : body[0]->as<AstStatIf>();
+        if (first_if && !first_if->elsebody && first_if->thenbody->body.size == 1 && first_if->thenbody->body.data[0]->is<AstStatBreak>()) {
+            condition = negate(first_if->condition);
+            body.erase(body.begin());
+        };
+
+        AstStatBlock* loop_body = unflatten_allocator->alloc<AstStatBlock>(location, copyStats(body), true);
+        return unflatten_allocator->alloc<AstStatWhile>(location, condition, loop_body, true, location);
+    };
+
+    Flow emitLoop(int header, std::vector<AstStat*>& out) {
+        if (++nesting > unflatten_max_nesting)
+            return Failed;
+
+        loops.push_back(header);
+        std::vector<AstStat*> body;
+        Flow flow = emitRegion(header, header, body, true);
+        loops.pop_back();
+        nesting--;
+        if (flow == Failed)
+            return Failed;
+
+        out.push_back(makeLoop(graph.nodes[header].block->location, body));
+        return FallsThrough;
+    };
+
+    // the code from node up to stop, which isn't part of it
+    Flow emitRegion(int node, int stop, std::vector<AstStat*>& out, bool entering_loop = false) {
+        while (entering_loop || node != stop) {
+            if (!loops.empty() && !entering_loop) {
+                int header = loops.back();
+                if (node == header) {
+                    out.push_back(unflatten_allocator->alloc<AstStatContinue>(graph.nodes[header].block->location));
+                    return Jumps;
+                } else if (node == graph.loop_exits[header]) {
+                    out.push_back(unflatten_allocator->alloc<AstStatBreak>(graph.nodes[header].block->location));
+                    return Jumps;
+                } else if (!graph.isInLoop(node, header))
+                    return Failed;
+            };
+
+            // past the loop, but the code after it isn't ours to place
+            if (node == graph.exit_node || node == graph.end_node || emitted[node])
+                return Failed;
+
+            if (graph.is_header[node] && !entering_loop) {
+                if (emitLoop(node, out) == Failed)
+                    return Failed;
+
+                node = graph.loop_exits[node];
+                if (node == -1)
+                    return Jumps;
+                continue;
+            };
+
+            entering_loop = false;
+            emitted[node] = true;
+            const StateBlock& state_block = graph.nodes[node];
+            if (state_block.jump != StateBlock::Branch)
+                appendBody(out, state_block.block, state_block.body);
+
+            switch (state_block.jump) {
+                case StateBlock::Return:
+                    return Jumps;
+                case StateBlock::Goto:
+                case StateBlock::Exit:
+                    node = state_block.successors[0];
+                    break;
+                case StateBlock::Branch: {
+                    if (++nesting > unflatten_max_nesting)
+                        return Failed;
+
+                    // where both branches meet again, at most the end of what's being emitted
+                    int join = graph.post_dominators[node];
+                    if (join == -1 || join == graph.end_node || (!loops.empty() && !graph.isInLoop(join, loops.back())))
+                        join = stop;
+
+                    // the condition can read the locals of the block, then the if and the branches go in its scope
+                    AstStatBlock* scope = unflatten_allocator->alloc<AstStatBlock>(state_block.block->location, state_block.body, true);
+                    bool scoped = declaresLocals(scope);
+                    std::vector<AstStat*> scoped_body;
+                    std::vector<AstStat*>& target = scoped ? scoped_body : out;
+                    if (scoped)
+                        scoped_body.insert(scoped_body.end(), state_block.body.data, state_block.body.data + state_block.body.size);
+                    else
+                        appendBody(out, state_block.block, state_block.body);
+
+                    std::vector<AstStat*> bodies[2];
+                    Flow flows[2];
+                    for (int index = 0; index < 2; index++) {
+                        appendBody(bodies[index], state_block.block, state_block.branch_bodies[index]);
+                        flows[index] = emitRegion(state_block.successors[index], join, bodies[index]);
+                        if (flows[index] == Failed)
+                            return Failed;
+                    };
+                    nesting--;
+
+                    // a branch that never gets to the join goes first, the other one follows the if
+                    const Location& location = state_block.jump_stat->location;
+                    std::vector<AstStat*> none;
+                    if (flows[0] == Jumps && flows[1] == Jumps)
+                        target.push_back(makeIf(location, state_block.condition, bodies[0], bodies[1]));
+                    else if (flows[0] == Jumps) {
+                        target.push_back(makeIf(location, state_block.condition, bodies[0], none));
+                        target.insert(target.end(), bodies[1].begin(), bodies[1].end());
+                    } else if (flows[1] == Jumps) {
+                        target.push_back(makeIf(location, negate(state_block.condition), bodies[1], none));
+                        target.insert(target.end(), bodies[0].begin(), bodies[0].end());
+                    } else
+                        target.push_back(makeIf(location, state_block.condition, bodies[0], bodies[1]));
+
+                    if (scoped) {
+                        if (capturesNames(scope, { scoped_body.begin() + state_block.body.size, scoped_body.end() }))
+                            return Failed;
+                        out.push_back(unflatten_allocator->alloc<AstStatBlock>(state_block.block->location, copyStats(scoped_body), true));
+                    };
+
+                    if (flows[0] == Jumps && flows[1] == Jumps)
+                        return Jumps;
+                    node = join;
+                    break;
+                };
+            };
+        };
+
+        return FallsThrough;
+    };
+};
+
+// local state = <number>, a few statements that don't use it, then while true do <dispatch> end or while state ~=
+// <number> do <dispatch> end, where the dispatch is one if on the state. loop_index is where the while is. whether
+// the state is used after the loop is up to the caller
+std::optional<Dispatcher> matchDispatcher(AstArray<AstStat*> body, size_t index, double& initial, size_t& loop_index) {
+    AstStatLocal* stat_local = body.data[index]->as<AstStatLocal>();
+    if (!stat_local || stat_local->vars.size != 1 || stat_local->values.size != 1)
+        return std::nullopt;
+
+    AstStatWhile* stat_while = nullptr;
+    for (loop_index = index + 1; loop_index < body.size && loop_index <= index + unflatten_max_prologue + 1; loop_index++)
+        if ((stat_while = body.data[loop_index]->as<AstStatWhile>()))
+            break;
+    if (!stat_while)
+        return std::nullopt;
+
+    std::optional<double> number = getConstantNumber(stat_local->values.data[0]);
+    if (!number)
+        return std::nullopt;
+    initial = *number;
+
+    Dispatcher dispatcher;
+    dispatcher.state = stat_local->vars.data[0];
+    if (!isStateFree({ body.data + index + 1, loop_index - index - 1 }, dispatcher.state, true))
+        return std::nullopt;
+
+    AstExpr* condition = getRootExpr(stat_while->condition);
+    if (AstExprBinary* expr_binary = condition->as<AstExprBinary>(); expr_binary && expr_binary->op == AstExprBinary::Op::CompareNe) {
+        if (isStateLocal(expr_binary->left, dispatcher.state))
+            dispatcher.exit_state = getConstantNumber(expr_binary->right);
+        else if (isStateLocal(expr_binary->right, dispatcher.state))
+            dispatcher.exit_state = getConstantNumber(expr_binary->left);
+
+        if (!dispatcher.exit_state)
+            return std::nullopt;
+    } else if (AstExprConstantBool* expr_bool = condition->as<AstExprConstantBool>(); !expr_bool || !expr_bool->value)
+        return std::nullopt;
+
+    AstArray<AstStat*> loop_body = stat_while->body->body;
+    dispatcher.root = loop_body.size == 1 ? loop_body.data[0]->as<AstStatIf>() : nullptr;
+    if (!dispatcher.root || !testState(dispatcher.root->condition, dispatcher.state, initial))
+        return std::nullopt;
+
+    return dispatcher;
+};
+
+// the structured code for the dispatcher, and whether anything after the loop can still run
+std::optional<std::pair<std::vector<AstStat*>, bool>> unflatten(Dispatcher& dispatcher, double initial) {
+    FlowGraph graph;
+    if (!buildGraph(dispatcher, initial, graph) || !findLoops(graph))
+        return std::nullopt;
+    findPostDominators(graph);
+
+    std::vector<AstStat*> out;
+    Emitter emitter(graph);
+    Emitter::Flow flow = emitter.emitRegion(graph.entry, graph.exit_node, out);
+    if (flow == Emitter::Failed)
+        return std::nullopt;
+
+    return std::make_pair(std::move(out), flow == Emitter::FallsThrough);
+};
+
+bool unflattenDispatchers(Allocator& allocator, AstStatBlock* block) {
+    if (block->body.size < 2)
+        return false;
+
+    unflatten_allocator = &allocator;
+    std::vector<AstStat*> body;
+    bool changed = false;
+    for (size_t index = 0; index < block->body.size; index++) {
+        AstStat* stat = block->body.data[index];
+        double initial;
+        size_t loop_index;
+        std::optional<Dispatcher> dispatcher = matchDispatcher(block->body, index, initial, loop_index);
+        size_t after = loop_index + 1;
+        if (!dispatcher || !isStateFree({ block->body.data + after, block->body.size - after }, dispatcher->state, true)) {
+            body.push_back(stat);
+            continue;
+        };
+
+        LUAU_TIMETRACE_SCOPE("unflatten", "transform");
+        auto result = unflatten(*dispatcher, initial);
+        if (!result) {
+            body.push_back(stat);
+            continue;
+        };
+
+        // the local is gone, what ran between it and the loop stays where it was
+        countPass(Unflatten);
+        changed = true;
+        body.insert(body.end(), block->body.data + index + 1, block->body.data + loop_index);
+        body.insert(body.end(), result->first.begin(), result->first.end());
+        if (!result->second) {
+            // everything after the loop is unreachable, and a return has to be the last statement
+            countStats(rewrites[(int) PassRule::Unreachable], block->body.size - after);
+            break;
+        };
+        index = loop_index;
+    };
+
+    if (changed)
+        block->body = copyStats(body);
+    unflatten_allocator = nullptr;
+    return changed;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+
+// control flow flattening moves every block of a function behind one dispatcher loop:
+//     local state = 4
+//     while state ~= 0 do
+//         if state < 7 then
+//             if state == 4 then <a> state = 9 elseif state == 2 then <b> state = 0 end
+//         elseif state == 9 then
+//             if <c> then state = 2 else state = 12 end
+//         ...
+// each state is resolved to the block that handles it, the jumps between the blocks make a graph, and the
+// graph is printed as the straight-line code, ifs and loops it was made from. a dispatcher whose graph
+// doesn't come apart into those is left as it is
+constexpr size_t unflatten_max_nesting = 128; // ifs and loops nested in the recovered code
+constexpr size_t unflatten_max_prologue = 8; // statements between local state and the loop
+
+// replaces the dispatchers that are statements of block, returns whether it found any. new nodes are made
+// in allocator
+bool unflattenDispatchers(Luau::Allocator& allocator, Luau::AstStatBlock* block);
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+#include "Luau/ParseResult.h"
+
+#include "FileUtils.h"
+
+#include "beautify.hpp"
+#include "memory.hpp"
+#include "minify.hpp"
+#include "passes.hpp"
+#include "solve.hpp"
+
+#include "corpus.hpp"
+#include "kernels.hpp"
+#include "handle.hpp"
+#include "shard.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// expressions are folded while they're printed. fold is prepareSolve and the folds made while beautifying, which
+// beautify leaves out. minify folds the same expressions again, that stays part of minify
+enum Phase {
+    Lex,
+    Parse,
+    Fold,
+    Passes,
+    Beautify,
+    Minify,
+    PhaseCount
+};
+const char* phase_names[PhaseCount] = { "lex", "parse", "fold", "passes", "beautify", "minify" };
+
+struct BenchOptions {
+    uint64_t seed = 1;
+    unsigned scale = 1;
+    unsigned iterations = 5;
+    std::vector<CorpusShape> shapes;
+    std::vector<std::string> inputs; // real files to time instead of (or along with) the corpus
+    const char* out_path = nullptr;
+    const char* dump_dir = nullptr;
+    bool kernels = false;
+    std::string kernel_filter;
+};
+
+struct PhaseResult {
+    double best_ms = std::numeric_limits<double>::infinity();
+    double total_ms = 0;
+    size_t output_bytes = 0;
+};
+
+struct DocumentResult {
+    std::string name;
+    size_t bytes = 0;
+    size_t nodes = 0;
+    size_t tokens = 0;
+    size_t folded = 0;
+    size_t peak_heap = 0; // of one more run with heap counting on, outside the timed ones
+    PhaseResult phases[PhaseCount];
+};
+
+struct CountVisitor : AstVisitor {
+    size_t nodes = 0;
+
+    bool visit(AstNode*) override {
+        nodes++;
+        return true;
+    }
+};
+
+// counts the expressions the printer will fold, without folding them
+struct FoldVisitor : AstVisitor {
+    size_t folded = 0;
+
+    bool visit(AstExpr* expr) override {
+        if (!isSolvable(expr))
+            return true;
+
+        folded++;
+        return false;
+    }
+};
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+};
+
+void addTiming(PhaseResult& phase, double ms) {
+    phase.best_ms = std::min(phase.best_ms, ms);
+    phase.total_ms += ms;
+};
+
+// lexes, parses and prints source once, adding the timings to document. the first run also counts
+void runDocument(const std::string& name, const std::string& source, DocumentResult& document, bool first) {
+    {
+        Allocator allocator;
+        AstNameTable names(allocator);
+        Lexer lexer(source.data(), source.size(), names);
+
+        size_t tokens = 0;
+        Clock::time_point start = Clock::now();
+        while (lexer.next().type != Lexeme::Eof)
+            tokens++;
+        addTiming(document.phases[Lex], millisecondsSince(start));
+        document.tokens = tokens;
+    }
+
+    Allocator allocator;
+    AstNameTable names(allocator);
+
+    Clock::time_point start = Clock::now();
+    ParseResult result = parseInto(source.data(), source.size(), names, allocator);
+    addTiming(document.phases[Parse], millisecondsSince(start));
+
+    if (!result.errors.empty()) {
+        fprintf(stderr, "%s: %s at %s\n", name.c_str(), result.errors[0].getMessage().c_str(),
+            locationToString(result.errors[0].getLocation()).c_str());
+        exit(1);
+    }
+
+    if (first) {
+        CountVisitor counter;
+        result.root->visit(&counter);
+        document.nodes = counter.nodes;
+    }
+
+    setAllocator(&allocator);
+    start = Clock::now();
+    prepareSolve(result.root);
+    double prepare_ms = millisecondsSince(start);
+
+    setupSolve(false, false);
+    start = Clock::now();
+    // minify prints the same tree, and it doesn't inline proxies
+    runPasses(allocator, result.root, false, false, false, false);
+    addTiming(document.phases[Passes], millisecondsSince(start));
+
+    if (first) {
+        FoldVisitor folder;
+        result.root->visit(&folder);
+        document.folded = folder.folded;
+    }
+
+    setFoldTiming(true);
+    takeFoldMilliseconds();
+    start = Clock::now();
+    std::string beautified = beautifyRoot(result.root, false, false);
+    double beautify_ms = millisecondsSince(start);
+    double fold_ms = takeFoldMilliseconds();
+    setFoldTiming(false);
+    addTiming(document.phases[Fold], prepare_ms + fold_ms);
+    addTiming(document.phases[Beautify], beautify_ms - fold_ms);
+    document.phases[Beautify].output_bytes = beautified.size();
+
+    start = Clock::now();
+    std::string minified = minifyRoot(result.root, false, false);
+    addTiming(document.phases[Minify], millisecondsSince(start));
+    document.phases[Minify].output_bytes = minified.size();
+
+    setAllocator(nullptr);
+};
+
+DocumentResult benchDocument(const std::string& name, const std::string& source, unsigned iterations) {
+    DocumentResult document;
+    document.name = name;
+    document.bytes = source.size();
+
+    for (unsigned iteration = 0; iteration < iterations; iteration++)
+        runDocument(name, source, document, iteration == 0);
+
+    // counting slows every allocation down, so it's only on for a run whose timings are thrown away
+    DocumentResult untimed;
+    setHeapCounting(true);
+    HeapScope heap;
+    runDocument(name, source, untimed, false);
+    document.peak_heap = heap.end();
+    setHeapCounting(false);
+
+    return document;
+};
+
+void appendDocumentJson(std::string& out, const DocumentResult& document, unsigned iterations) {
+    out.append("{\"name\":");
+    appendJsonString(out, document.name);
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), ",\"bytes\":%zu,\"nodes\":%zu,\"tokens\":%zu,\"folded\":%zu,\"peak_heap\":%zu,\"phases\":{",
+        document.bytes, document.nodes, document.tokens, document.folded, document.peak_heap);
+    out.append(buffer);
+
+    for (int phase = 0; phase < PhaseCount; phase++) {
+        const PhaseResult& result = document.phases[phase];
+        double seconds = result.best_ms / 1000;
+
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":{\"best_ms\":%.3f,\"mean_ms\":%.3f,\"mb_per_s\":%.2f,\"ns_per_node\":%.2f,\"output_bytes\":%zu}",
+            phase == 0 ? "" : ",", phase_names[phase], result.best_ms, result.total_ms / iterations,
+            seconds > 0 ? document.bytes / seconds / 1e6 : 0.0, document.nodes > 0 ? result.best_ms * 1e6 / document.nodes : 0.0,
+            result.output_bytes);
+        out.append(buffer);
+    }
+
+    out.append("}}");
+};
+
+// to path, or stdout without one
+bool writeJson(const char* path, const std::string& json) {
+    if (!path) {
+        fwrite(json.data(), 1, json.size(), stdout);
+        return true;
+    }
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file && fwrite(json.data(), 1, json.size(), file) == json.size();
+    if (file)
+        ok = fclose(file) == 0 && ok;
+
+    if (!ok)
+        fprintf(stderr, "failed to write file %s\n", path);
+    return ok;
+};
+
+void displayHelp(const char* path) {
+    printf("Usage: %s [options] [files]\n\n", path);
+    printf("Times lexing, parsing, folding, the tree passes, beautify and minify separately and prints the results as JSON.\n");
+    printf("Folding happens while printing, the folds beautify makes are timed as fold, minify's stay part of minify.\n");
+    printf("peak_heap is what one document needs on its own, peak_rss_kb at the end is the whole process.\n");
+    printf("Without files, a generated corpus is used.\n\n");
+    printf("Options:\n");
+    printf("  --seed <n>: corpus seed (defaults to 1)\n");
+    printf("  --scale <n>: corpus documents are roughly n megabytes each (defaults to 1)\n");
+    printf("  --shape <name>: only generate this shape, can be repeated (arithmetic, constant_table, long_string, dispatcher, elseif_chain)\n");
+    printf("  --iterations <n>: runs of every phase, the best one is reported (defaults to 5)\n");
+    printf("  --out <file>: writes the JSON there instead of stdout\n");
+    printf("  --dump <dir>: writes the corpus out as .luau files and exits\n");
+    printf("  --kernels: runs the microbenchmarks of the printer's kernels instead (cycles per call and per byte)\n");
+    printf("  --kernel <name>: only runs the kernels whose name contains this, implies --kernels\n");
+};
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "--help") == 0) {
+            displayHelp(argv[0]);
+            return 0;
+        } else if (strcmp(arg, "--seed") == 0 && has_value)
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--scale") == 0 && has_value)
+            options.scale = std::max(1u, (unsigned) strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(arg, "--iterations") == 0 && has_value)
+            options.iterations = std::max(1u, (unsigned) strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(arg, "--shape") == 0 && has_value) {
+            CorpusShape shape;
+            if (!parseCorpusShape(argv[++i], shape)) {
+                fprintf(stderr, "Error: unknown shape '%s'\n\n", argv[i]);
+                displayHelp(argv[0]);
+                return 1;
+            }
+            options.shapes.push_back(shape);
+        } else if (strcmp(arg, "--out") == 0 && has_value)
+            options.out_path = argv[++i];
+        else if (strcmp(arg, "--dump") == 0 && has_value)
+            options.dump_dir = argv[++i];
+        else if (strcmp(arg, "--kernels") == 0)
+            options.kernels = true;
+        else if (strcmp(arg, "--kernel") == 0 && has_value) {
+            options.kernels = true;
+            options.kernel_filter = argv[++i];
+        }
+        else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Error: unrecognized option '%s'\n\n", arg);
+            displayHelp(argv[0]);
+            return 1;
+        } else
+            options.inputs.push_back(arg);
+    }
+
+    if (options.kernels) {
+        std::string json;
+        runKernelBenchmarks(options.kernel_filter, json);
+        return writeJson(options.out_path, json) ? 0 : 1;
+    }
+
+    if (options.shapes.empty() && options.inputs.empty())
+        options.shapes = getCorpusShapes();
+
+    std::vector<std::pair<std::string, std::string>> documents;
+    for (CorpusShape shape : options.shapes)
+        documents.push_back({ getCorpusShapeName(shape), generateCorpusSource(shape, options.seed, options.scale) });
+
+    if (options.dump_dir) {
+        for (const auto& [name, source] : documents) {
+            std::string path = joinPaths(options.dump_dir, name + ".luau");
+            FILE* file = fopen(path.c_str(), "wb");
+            if (!file || fwrite(source.data(), 1, source.size(), file) != source.size()) {
+                fprintf(stderr, "failed to write file %s\n", path.c_str());
+                return 1;
+            }
+            fclose(file);
+        }
+        return 0;
+    }
+
+    for (const std::string& input : options.inputs) {
+        std::optional<std::string> source = readFile(input);
+        if (!source) {
+            fprintf(stderr, "failed to read file %s\n", input.c_str());
+            return 1;
+        }
+        documents.push_back({ input, *source });
+    }
+
+    std::string json;
+    char header[160];
+    snprintf(header, sizeof(header), "{\"seed\":%llu,\"scale\":%u,\"iterations\":%u,\"documents\":[",
+        (unsigned long long) options.seed, options.scale, options.iterations);
+    json.append(header);
+
+    for (size_t index = 0; index < documents.size(); index++) {
+        DocumentResult document = benchDocument(documents[index].first, documents[index].second, options.iterations);
+        if (index > 0)
+            json += ',';
+        appendDocumentJson(json, document, options.iterations);
+
+        fprintf(stderr, "%s: %zu bytes, %zu nodes, beautify %.3fms\n", document.name.c_str(), document.bytes, document.nodes,
+            document.phases[Beautify].best_ms);
+    }
+
+    char footer[64];
+    snprintf(footer, sizeof(footer), "],\"peak_rss_kb\":%ld}\n", getPeakRssKb());
+    json.append(footer);
+
+    return writeJson(options.out_path, json) ? 0 : 1;
+};
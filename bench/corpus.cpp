@@ -0,0 +1,445 @@
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// the parser gives up past 1000 levels of nesting (elseif counts as one too), so nothing here goes near that
+constexpr unsigned max_arithmetic_depth = 120;
+constexpr unsigned max_elseif_chain = 800;
+
+constexpr size_t document_size = 1024 * 1024;
+
+// splitmix64, so the corpus doesn't depend on how a standard library implements its distributions
+struct CorpusRandom {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t value = (state += 0x9e3779b97f4a7c15);
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+        return value ^ (value >> 31);
+    }
+
+    // in [0, bound)
+    uint64_t below(uint64_t bound) {
+        return next() % bound;
+    }
+
+    bool chance(unsigned percent) {
+        return below(100) < percent;
+    }
+};
+
+const char* identifier_characters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+
+void appendNumber(std::string& out, CorpusRandom& random) {
+    char buffer[64];
+    switch (random.below(4)) {
+        case 0:
+            snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long) random.below(1000));
+            break;
+        case 1:
+            snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long) random.below(1ull << 40));
+            break;
+        case 2:
+            snprintf(buffer, sizeof(buffer), "0x%llX", (unsigned long long) random.below(1ull << 32));
+            break;
+        default:
+            snprintf(buffer, sizeof(buffer), "%llu.%llu", (unsigned long long) random.below(10000), (unsigned long long) random.below(1000));
+            break;
+    }
+    out.append(buffer);
+};
+
+// names like the ones obfuscators pick, IlIlIl and friends included
+void appendName(std::string& out, CorpusRandom& random) {
+    size_t length = 3 + random.below(10);
+    if (random.chance(30)) {
+        for (size_t i = 0; i < length; i++)
+            out += random.chance(50) ? 'I' : 'l';
+        return;
+    }
+
+    static const char* keywords[] = { "and", "break", "continue", "else", "elseif", "end", "false", "for", "function",
+        "local", "nil", "not", "repeat", "return", "then", "true", "type", "until", "while" };
+
+    std::string name;
+    for (size_t i = 0; i < length; i++)
+        name += identifier_characters[random.below(53)];
+
+    for (const char* keyword : keywords)
+        if (name == keyword)
+            name.insert(name.begin(), '_');
+
+    out.append(name);
+};
+
+// escape_percent of the characters come out as one of the escapes luau understands
+void appendStringBody(std::string& out, CorpusRandom& random, size_t length, unsigned escape_percent) {
+    for (size_t i = 0; i < length; i++) {
+        if (!random.chance(escape_percent)) {
+            char c = (char) (' ' + random.below(95));
+            if (c == '"' || c == '\\')
+                c = '.';
+            out += c;
+            continue;
+        }
+
+        char buffer[8];
+        switch (random.below(6)) {
+            case 0:
+                out.append("\\n");
+                break;
+            case 1:
+                out.append("\\t");
+                break;
+            case 2:
+                out.append(random.chance(50) ? "\\\"" : "\\\\");
+                break;
+            case 3:
+                snprintf(buffer, sizeof(buffer), "\\x%02X", (unsigned) random.below(256));
+                out.append(buffer);
+                break;
+            default:
+                // always three digits, so a digit after it can't be read as part of the escape
+                snprintf(buffer, sizeof(buffer), "\\%03u", (unsigned) random.below(256));
+                out.append(buffer);
+                break;
+        }
+    }
+};
+
+void appendString(std::string& out, CorpusRandom& random, size_t length, unsigned escape_percent) {
+    out += '"';
+    appendStringBody(out, random, length, escape_percent);
+    out += '"';
+};
+
+void appendArithmetic(std::string& out, CorpusRandom& random, unsigned depth) {
+    if (depth == 0) {
+        if (random.chance(10)) {
+            // string lengths get folded too
+            out += '#';
+            appendString(out, random, random.below(16), 0);
+        } else
+            appendNumber(out, random);
+        return;
+    }
+
+    static const char* operators[] = { " + ", " - ", " * ", " / ", " % " };
+
+    if (random.chance(10)) {
+        out.append("-(");
+        appendArithmetic(out, random, depth - 1);
+        out += ')';
+        return;
+    }
+
+    out += '(';
+    appendArithmetic(out, random, depth - 1);
+    out.append(operators[random.below(5)]);
+    appendArithmetic(out, random, random.below(depth));
+    out += ')';
+};
+
+std::string generateArithmetic(CorpusRandom& random, size_t size) {
+    std::string out;
+    unsigned index = 0;
+
+    while (out.size() < size) {
+        out.append("local v").append(std::to_string(index++)).append(" = ");
+
+        if (random.chance(5)) {
+            // a single long left-leaning chain, the kind that makes the printer recurse the deepest
+            unsigned length = 20 + (unsigned) random.below(max_arithmetic_depth - 20);
+            out.append(length, '(');
+            appendNumber(out, random);
+            for (unsigned i = 0; i < length; i++) {
+                out.append(random.chance(50) ? " + " : " * ");
+                appendNumber(out, random);
+                out += ')';
+            }
+        } else
+            appendArithmetic(out, random, 4 + (unsigned) random.below(8));
+
+        out.append("\n");
+    }
+
+    return out;
+};
+
+void appendTableValue(std::string& out, CorpusRandom& random, unsigned depth) {
+    uint64_t kind = random.below(depth > 0 ? 6 : 5);
+    switch (kind) {
+        case 0:
+        case 1:
+            appendNumber(out, random);
+            break;
+        case 2:
+            appendString(out, random, random.below(24), 20);
+            break;
+        case 3:
+            out.append(random.chance(50) ? "true" : "false");
+            break;
+        case 4:
+            appendArithmetic(out, random, 2);
+            break;
+        default: {
+            out += '{';
+            size_t count = random.below(8);
+            for (size_t i = 0; i < count; i++) {
+                if (i > 0)
+                    out.append(", ");
+                appendTableValue(out, random, depth - 1);
+            }
+            out += '}';
+            break;
+        }
+    }
+};
+
+std::string generateConstantTable(CorpusRandom& random, size_t size) {
+    std::string out;
+    unsigned index = 0;
+
+    while (out.size() < size) {
+        out.append("local T").append(std::to_string(index++)).append(" = {\n");
+
+        // either a flat array or keyed entries, with values nested a few levels deep
+        size_t count = 2000 + random.below(20000);
+        bool keyed = random.chance(40);
+        for (size_t i = 0; i < count && out.size() < size; i++) {
+            out.append("    ");
+            if (keyed) {
+                switch (random.below(3)) {
+                    case 0:
+                        out += '[';
+                        appendNumber(out, random);
+                        out.append("] = ");
+                        break;
+                    case 1:
+                        out += '[';
+                        appendString(out, random, 1 + random.below(12), 30);
+                        out.append("] = ");
+                        break;
+                    default:
+                        appendName(out, random);
+                        out.append(" = ");
+                        break;
+                }
+            }
+            appendTableValue(out, random, 3);
+            out.append(",\n");
+        }
+
+        out.append("}\n");
+    }
+
+    return out;
+};
+
+std::string generateLongString(CorpusRandom& random, size_t size) {
+    std::string out;
+    unsigned index = 0;
+
+    while (out.size() < size) {
+        out.append("local s").append(std::to_string(index++)).append(" = ");
+
+        size_t length = std::min<size_t>(size - out.size() + 16, 256 * 1024 + random.below(768 * 1024));
+        if (random.chance(20)) {
+            // long brackets don't have escapes, but can hold anything else (that can't close them)
+            out.append("[==[");
+            for (size_t i = 0; i < length; i++) {
+                char c = random.chance(2) ? '\n' : (char) (' ' + random.below(95));
+                out += c == ']' ? '.' : c;
+            }
+            out.append("]==]");
+        } else
+            appendString(out, random, length, (unsigned) random.below(60));
+
+        out.append("\n");
+    }
+
+    return out;
+};
+
+void appendStateBody(std::string& out, CorpusRandom& random, const std::string& indent, const std::vector<uint32_t>& states, size_t index) {
+    // a couple of junk statements, then the jump to the next state
+    size_t count = 1 + random.below(3);
+    for (size_t i = 0; i < count; i++) {
+        out.append(indent);
+        switch (random.below(3)) {
+            case 0:
+                out.append("acc = acc + ");
+                appendArithmetic(out, random, 2);
+                break;
+            case 1:
+                out.append("env[");
+                appendString(out, random, 4 + random.below(8), 50);
+                out.append("] = acc");
+                break;
+            default:
+                out.append("print(acc, ");
+                appendNumber(out, random);
+                out += ')';
+                break;
+        }
+        out += '\n';
+    }
+
+    out.append(indent).append("state = ");
+    if (index + 1 < states.size())
+        out.append(std::to_string(states[index + 1]));
+    else
+        out += '0';
+    out += '\n';
+};
+
+// the states are checked with a binary search of nested ifs, like most flattening obfuscators emit
+void appendDispatch(std::string& out, CorpusRandom& random, std::string indent, const std::vector<uint32_t>& sorted, size_t from, size_t to,
+    const std::vector<uint32_t>& states, const std::vector<size_t>& order) {
+    if (to - from <= 4) {
+        for (size_t i = from; i < to; i++) {
+            out.append(indent).append(i == from ? "if" : "elseif").append(" state == ").append(std::to_string(sorted[i])).append(" then\n");
+            appendStateBody(out, random, indent + "    ", states, order[i]);
+        }
+        out.append(indent).append("end\n");
+        return;
+    }
+
+    size_t middle = from + (to - from) / 2;
+    out.append(indent).append("if state < ").append(std::to_string(sorted[middle])).append(" then\n");
+    appendDispatch(out, random, indent + "    ", sorted, from, middle, states, order);
+    out.append(indent).append("else\n");
+    appendDispatch(out, random, indent + "    ", sorted, middle, to, states, order);
+    out.append(indent).append("end\n");
+};
+
+std::string generateDispatcher(CorpusRandom& random, size_t size) {
+    std::string out;
+    unsigned index = 0;
+
+    while (out.size() < size) {
+        size_t count = 200 + random.below(3000);
+
+        // distinct random state numbers, visited in a random order
+        std::vector<uint32_t> states;
+        for (size_t i = 0; i < count; i++)
+            states.push_back((uint32_t) (i * 7919 + random.below(7919)) + 1);
+        for (size_t i = count - 1; i > 0; i--)
+            std::swap(states[i], states[random.below(i + 1)]);
+
+        std::vector<std::pair<uint32_t, size_t>> by_state;
+        for (size_t i = 0; i < count; i++)
+            by_state.push_back({ states[i], i });
+        std::sort(by_state.begin(), by_state.end());
+
+        std::vector<uint32_t> sorted;
+        std::vector<size_t> order;
+        for (const auto& [state, position] : by_state) {
+            sorted.push_back(state);
+            order.push_back(position);
+        }
+
+        out.append("local function dispatch").append(std::to_string(index++)).append("(env)\n");
+        out.append("    local acc = 0\n");
+        out.append("    local state = ").append(std::to_string(states[0])).append("\n");
+        out.append("    while state ~= 0 do\n");
+        appendDispatch(out, random, "        ", sorted, 0, count, states, order);
+        out.append("    end\n");
+        out.append("    return acc\n");
+        out.append("end\n");
+    }
+
+    return out;
+};
+
+std::string generateElseifChain(CorpusRandom& random, size_t size) {
+    std::string out;
+    unsigned index = 0;
+
+    while (out.size() < size) {
+        out.append("local function chain").append(std::to_string(index++)).append("(x)\n");
+
+        size_t count = 50 + random.below(max_elseif_chain - 50);
+        for (size_t i = 0; i < count; i++) {
+            out.append(i == 0 ? "    if x == " : "    elseif x == ");
+            if (random.chance(30))
+                appendString(out, random, 1 + random.below(10), 10);
+            else
+                appendNumber(out, random);
+            out.append(" then\n        return ");
+            appendTableValue(out, random, 1);
+            out += '\n';
+        }
+
+        out.append("    else\n        return nil\n    end\nend\n");
+    }
+
+    return out;
+};
+
+const std::vector<CorpusShape>& getCorpusShapes() {
+    static const std::vector<CorpusShape> shapes = {
+        CorpusShape::Arithmetic,
+        CorpusShape::ConstantTable,
+        CorpusShape::LongString,
+        CorpusShape::Dispatcher,
+        CorpusShape::ElseifChain
+    };
+    return shapes;
+};
+
+const char* getCorpusShapeName(CorpusShape shape) {
+    switch (shape) {
+        case CorpusShape::Arithmetic:
+            return "arithmetic";
+        case CorpusShape::ConstantTable:
+            return "constant_table";
+        case CorpusShape::LongString:
+            return "long_string";
+        case CorpusShape::Dispatcher:
+            return "dispatcher";
+        case CorpusShape::ElseifChain:
+            return "elseif_chain";
+    }
+    return "unknown";
+};
+
+bool parseCorpusShape(const char* name, CorpusShape& shape) {
+    for (CorpusShape candidate : getCorpusShapes()) {
+        if (strcmp(name, getCorpusShapeName(candidate)) == 0) {
+            shape = candidate;
+            return true;
+        }
+    }
+    return false;
+};
+
+std::string generateCorpusSource(CorpusShape shape, uint64_t seed, unsigned scale) {
+    // every shape gets its own stream, so adding a shape doesn't change the others
+    CorpusRandom random { seed * 31 + (uint64_t) shape };
+    size_t size = document_size * (scale == 0 ? 1 : scale);
+
+    switch (shape) {
+        case CorpusShape::Arithmetic:
+            return generateArithmetic(random, size);
+        case CorpusShape::ConstantTable:
+            return generateConstantTable(random, size);
+        case CorpusShape::LongString:
+            return generateLongString(random, size);
+        case CorpusShape::Dispatcher:
+            return generateDispatcher(random, size);
+        case CorpusShape::ElseifChain:
+            return generateElseifChain(random, size);
+    }
+    return "";
+};
+
+std::vector<CorpusDocument> generateCorpus(uint64_t seed, unsigned scale) {
+    std::vector<CorpusDocument> corpus;
+    for (CorpusShape shape : getCorpusShapes())
+        corpus.push_back({ shape, getCorpusShapeName(shape), generateCorpusSource(shape, seed, scale) });
+    return corpus;
+};
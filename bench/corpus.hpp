@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// synthetic sources shaped like the obfuscated scripts we see in production. the same seed and
+// scale always give the same bytes, so numbers from different runs and machines are comparable
+enum class CorpusShape {
+    Arithmetic, // deeply nested constant arithmetic
+    ConstantTable, // giant tables of constants, some nested
+    LongString, // megabyte string literals full of escapes
+    Dispatcher, // control flow flattened into a while loop over a state variable
+    ElseifChain // long if / elseif chains
+};
+
+struct CorpusDocument {
+    CorpusShape shape;
+    std::string name;
+    std::string source;
+};
+
+const std::vector<CorpusShape>& getCorpusShapes();
+const char* getCorpusShapeName(CorpusShape shape);
+bool parseCorpusShape(const char* name, CorpusShape& shape);
+
+// scale 1 gives documents of roughly a megabyte each
+std::string generateCorpusSource(CorpusShape shape, uint64_t seed, unsigned scale);
+std::vector<CorpusDocument> generateCorpus(uint64_t seed, unsigned scale);
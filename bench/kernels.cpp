@@ -0,0 +1,299 @@
+#include "kernels.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define KERNEL_CYCLES 1
+#endif
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+#include "Luau/ParseResult.h"
+
+#include "beautify.hpp"
+#include "solve.hpp"
+
+#include "handle.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// every batch runs for at least this long, and the best of the repetitions is kept
+constexpr double kernel_batch_ms = 10;
+constexpr int kernel_repetitions = 5;
+
+template<typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+uint64_t readTicks() {
+#if defined(KERNEL_CYCLES)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+#endif
+};
+
+// ticks per call of body, which is called with how many times to run
+template<typename Body>
+double measureKernel(Body&& body) {
+    size_t calls = 1;
+    while (true) {
+        Clock::time_point start = Clock::now();
+        body(calls);
+        if (std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= kernel_batch_ms || calls >= (size_t(1) << 40))
+            break;
+        calls *= 2;
+    }
+
+    double best = std::numeric_limits<double>::infinity();
+    for (int repetition = 0; repetition < kernel_repetitions; repetition++) {
+        uint64_t start = readTicks();
+        body(calls);
+        best = std::min(best, double(readTicks() - start) / calls);
+    }
+    return best;
+};
+
+struct KernelReport {
+    std::string& out;
+    const std::string& filter;
+    bool first = true;
+
+    bool wants(const char* kernel) {
+        return filter.empty() || strstr(kernel, filter.c_str()) != nullptr;
+    }
+
+    // params is the inside of a JSON object, per_unit divides the cost per call by the input size when it isn't 0
+    void add(const char* kernel, const std::string& params, double per_call, double units = 0) {
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer), "%s\n{\"kernel\":\"%s\",\"params\":{%s},\"per_call\":%.2f", first ? "" : ",", kernel, params.c_str(), per_call);
+        out.append(buffer);
+        if (units > 0) {
+            snprintf(buffer, sizeof(buffer), ",\"per_byte\":%.3f", per_call / units);
+            out.append(buffer);
+        }
+        out += '}';
+        first = false;
+
+        fprintf(stderr, "%-16s %-40s %12.2f\n", kernel, params.c_str(), per_call);
+    }
+};
+
+// printable text with escape_percent of it being characters fixString has to escape
+std::vector<char> makeStringBytes(size_t length, unsigned escape_percent) {
+    static const char escaped[] = { '\n', '\t', '"', '\\', '\0', '\x7f', '\x01', '\xff' };
+
+    std::vector<char> bytes(length);
+    uint64_t state = 0x2545f4914f6cdd1d;
+    for (size_t i = 0; i < length; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        if (state % 100 < escape_percent)
+            bytes[i] = escaped[(state >> 8) % sizeof(escaped)];
+        else
+            bytes[i] = (char) ('a' + (state >> 8) % 26);
+    }
+    return bytes;
+};
+
+void benchFixString(KernelReport& report) {
+    for (size_t length : { 16, 1024, 65536 }) {
+        for (unsigned escape_percent : { 0, 10, 50 }) {
+            std::vector<char> bytes = makeStringBytes(length, escape_percent);
+            Luau::AstArray<char> value { bytes.data(), bytes.size() };
+
+            double per_call = measureKernel([&](size_t calls) {
+                for (size_t i = 0; i < calls; i++)
+                    doNotOptimize(fixString(value));
+            });
+
+            report.add("fixString", "\"length\":" + std::to_string(length) + ",\"escape_percent\":" + std::to_string(escape_percent), per_call, (double) length);
+        }
+    }
+};
+
+void benchConvertNumber(KernelReport& report) {
+    struct NumberCase {
+        const char* name;
+        double value;
+    };
+    NumberCase cases[] = {
+        { "small_integer", 42 },
+        { "large_integer", 9007199254740991.0 },
+        { "fraction", 0.1 },
+        { "long_fraction", 3.14159265358979 },
+        { "exponent", 1e300 },
+        { "huge", std::numeric_limits<double>::infinity() },
+        { "nan", std::numeric_limits<double>::quiet_NaN() }
+    };
+
+    for (const NumberCase& number_case : cases) {
+        double value = number_case.value;
+        double per_call = measureKernel([&](size_t calls) {
+            for (size_t i = 0; i < calls; i++) {
+                doNotOptimize(value);
+                doNotOptimize(convertNumber(value));
+            }
+        });
+
+        report.add("convertNumber", std::string("\"value\":\"") + number_case.name + "\"", per_call);
+    }
+};
+
+void benchIndents(KernelReport& report) {
+    for (int depth : { 1, 8, 32 }) {
+        std::string params = "\"depth\":" + std::to_string(depth);
+
+        if (report.wants("getIndents")) {
+            double per_call = measureKernel([&](size_t calls) {
+                for (size_t i = 0; i < calls; i++)
+                    doNotOptimize(benchGetIndents(depth));
+            });
+            report.add("getIndents", params, per_call);
+        }
+
+        if (report.wants("addIndents")) {
+            std::string result;
+            result.reserve(1 << 20);
+            double per_call = measureKernel([&](size_t calls) {
+                for (size_t i = 0; i < calls; i++) {
+                    // keeps the string at a steady size instead of growing it for the whole run
+                    if (result.size() > (1 << 19))
+                        result.clear();
+                    benchAddIndents(result, depth);
+                }
+                doNotOptimize(result);
+            });
+            report.add("addIndents", params, per_call);
+        }
+    }
+};
+
+void benchOptionalNewline(KernelReport& report) {
+    for (size_t trailing : { 0, 4, 64 }) {
+        for (int depth : { 1, 8 }) {
+            // optionalNewline scans back over trailing whitespace before deciding whether to add a newline
+            std::string result = "local x = 1";
+            result.append(trailing, ' ');
+            size_t base = result.size();
+
+            double per_call = measureKernel([&](size_t calls) {
+                for (size_t i = 0; i < calls; i++) {
+                    result.resize(base);
+                    benchOptionalNewline(result, depth);
+                }
+                doNotOptimize(result);
+            });
+
+            report.add("optionalNewline", "\"trailing_spaces\":" + std::to_string(trailing) + ",\"depth\":" + std::to_string(depth), per_call);
+        }
+    }
+};
+
+// parses source and hands the expression of its first statement (a return) to body
+template<typename Body>
+void withReturnedExpr(const std::string& source, Body&& body) {
+    Luau::Allocator allocator;
+    Luau::AstNameTable names(allocator);
+    Luau::ParseResult result = parseInto(source.data(), source.size(), names, allocator);
+    if (!result.errors.empty() || result.root->body.size == 0) {
+        fprintf(stderr, "kernel input didn't parse: %s\n", source.substr(0, 80).c_str());
+        return;
+    }
+
+    Luau::AstStatReturn* stat_return = result.root->body.data[0]->as<Luau::AstStatReturn>();
+    setAllocator(&allocator);
+    body(stat_return->list.data[0]);
+    setAllocator(nullptr);
+};
+
+void benchGetRootExpr(KernelReport& report) {
+    for (bool ignore_types : { false, true }) {
+        for (int depth : { 1, 16, 128 }) {
+            // groups, and with ignore_types, type assertions in between them
+            std::string source = "return ";
+            for (int i = 0; i < depth; i++)
+                source += '(';
+            source += 'x';
+            for (int i = 0; i < depth; i++)
+                source.append(ignore_types && i % 2 == 0 ? " :: any)" : ")");
+
+            withReturnedExpr(source, [&](Luau::AstExpr* expr) {
+                setupSolve(false, ignore_types);
+                double per_call = measureKernel([&](size_t calls) {
+                    for (size_t i = 0; i < calls; i++) {
+                        doNotOptimize(expr);
+                        doNotOptimize(getRootExpr(expr));
+                    }
+                });
+
+                report.add("getRootExpr", "\"depth\":" + std::to_string(depth) + ",\"ignore_types\":" + (ignore_types ? "true" : "false"), per_call);
+            });
+        }
+    }
+};
+
+void benchGetTableSize(KernelReport& report) {
+    for (size_t size : { 16, 1024, 65536 }) {
+        // trailing nil is what sends it into the boundary search, otherwise it's just the item count
+        for (bool trailing_nil : { false, true }) {
+            std::string source = "return {";
+            for (size_t i = 0; i < size; i++) {
+                if (i > 0)
+                    source += ',';
+                source.append(trailing_nil && i >= size / 2 ? "nil" : std::to_string(i));
+            }
+            source += '}';
+
+            withReturnedExpr(source, [&](Luau::AstExpr* expr) {
+                Luau::AstExprTable* table = expr->as<Luau::AstExprTable>();
+                setupSolve(false, false);
+                double per_call = measureKernel([&](size_t calls) {
+                    for (size_t i = 0; i < calls; i++) {
+                        doNotOptimize(table);
+                        doNotOptimize(getTableSize(table));
+                    }
+                });
+
+                report.add("getTableSize", "\"size\":" + std::to_string(size) + ",\"trailing_nil\":" + (trailing_nil ? "true" : "false"), per_call);
+            });
+        }
+    }
+};
+
+void runKernelBenchmarks(const std::string& filter, std::string& out) {
+#if defined(KERNEL_CYCLES)
+    out.append("{\"unit\":\"cycles\",\"kernels\":[");
+#else
+    out.append("{\"unit\":\"ns\",\"kernels\":[");
+#endif
+
+    KernelReport report { out, filter };
+
+    if (report.wants("fixString"))
+        benchFixString(report);
+    if (report.wants("convertNumber"))
+        benchConvertNumber(report);
+    if (report.wants("getIndents") || report.wants("addIndents"))
+        benchIndents(report);
+    if (report.wants("optionalNewline"))
+        benchOptionalNewline(report);
+    if (report.wants("getRootExpr"))
+        benchGetRootExpr(report);
+    if (report.wants("getTableSize"))
+        benchGetTableSize(report);
+
+    out.append("\n]}\n");
+};
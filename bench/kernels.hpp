@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// microbenchmarks of the printer's inner loops (fixString, convertNumber, getIndents, addIndents,
+// optionalNewline, getRootExpr, getTableSize) over a range of inputs, so a slowdown in beautify can be
+// pinned on a kernel or on the tree walk. appends one JSON document to out, costs are in cycles
+// where the cpu has a cycle counter and in nanoseconds otherwise
+// filter, when not empty, only runs kernels whose name contains it
+void runKernelBenchmarks(const std::string& filter, std::string& out);
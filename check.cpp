@@ -0,0 +1,65 @@
+#include "check.hpp"
+
+#include <algorithm>
+
+struct CheckState {
+    const std::string* source;
+    size_t offset = 0;
+    // position of source[offset]
+    unsigned line = 1;
+    unsigned column = 1;
+    bool mismatch = false;
+
+    void advance(size_t count) {
+        for (size_t i = offset; i < offset + count; i++) {
+            if ((*source)[i] == '\n') {
+                line++;
+                column = 1;
+            } else
+                column++;
+        }
+        offset += count;
+    }
+};
+
+bool checkChunk(const std::string& chunk, void* data) {
+    CheckState* state = (CheckState*) data;
+    if (state->mismatch)
+        return false;
+
+    const std::string& source = *state->source;
+    size_t available = source.size() - state->offset;
+    size_t length = std::min(chunk.size(), available);
+
+    size_t same = 0;
+    while (same < length && chunk[same] == source[state->offset + same])
+        same++;
+
+    state->advance(same);
+
+    if (same < chunk.size()) {
+        state->mismatch = true;
+        return false;
+    }
+
+    return true;
+};
+
+bool checkSource(const std::string& source, const HandleOptions& options, CheckResult& result, std::string& error) {
+    CheckState state;
+    state.source = &source;
+
+    std::string scratch;
+    if (!handleSourceStreaming(source, options, checkChunk, &state, scratch, error))
+        return false;
+
+    // the output ended before the source did
+    if (!state.mismatch && state.offset != source.size())
+        state.mismatch = true;
+
+    result.formatted = !state.mismatch;
+    result.line = state.line;
+    result.column = state.column;
+
+    return true;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "handle.hpp"
+
+struct CheckResult {
+    bool formatted = true;
+    // first difference between the source and its output, 1-based
+    unsigned line = 0;
+    unsigned column = 0;
+};
+
+// compares the output against the source as it is printed, stopping at the first difference. only top-level
+// statements are handed over as they're printed, anything nested is printed whole with the statement holding it
+bool checkSource(const std::string& source, const HandleOptions& options, CheckResult& result, std::string& error);
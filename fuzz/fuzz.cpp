@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#if !defined(LUAU_BEAUTIFY_LIBFUZZER)
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "FileUtils.h"
+
+#include "generator.hpp"
+#include "handle.hpp"
+#include "memory.hpp"
+#include "reduce.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// how long formatting takes and how much memory it needs per byte of a program without anything slow
+// in it. a fuzz case is compared against factor times that
+struct Baseline {
+    double ns_per_byte = 0;
+    double kb_per_byte = 0;
+};
+
+// shorter programs are dominated by fixed costs, they are never called slow
+constexpr size_t default_min_bytes = 4096;
+
+struct FuzzOptions {
+    uint64_t seed = 1;
+    unsigned runs = 1000;
+    size_t max_len = 4096;
+    double factor = 50;
+    unsigned timeout_ms = 5000;
+    size_t memory_mb = 2048;
+    size_t min_bytes = default_min_bytes;
+    const char* out_dir = "fuzz-findings";
+    bool reduce = true;
+    size_t reduce_attempts = 2000;
+    HandleOptions handle; // for the files given on the command line
+    std::vector<std::string> inputs;
+};
+
+// memory needed on top of the baseline before a case counts as using too much, so the allocator's
+// first pages and small scripts don't trip it
+constexpr double memory_slack_kb = 16 * 1024;
+// the size of the program the baseline is measured on
+constexpr size_t baseline_bytes = 256 * 1024;
+
+// formats source in this process, returns false when it didn't parse
+bool formatTimed(const std::string& source, const HandleOptions& options, double& ms) {
+    std::string out, error;
+    Clock::time_point start = Clock::now();
+    bool parsed = handleSource(source, options, out, error);
+    ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return parsed;
+};
+
+double timeBudgetMs(const Baseline& baseline, double factor, size_t bytes) {
+    // a few milliseconds on top so timer noise on small cases doesn't count
+    return factor * baseline.ns_per_byte * bytes / 1e6 + 5;
+};
+
+double memoryBudgetKb(const Baseline& baseline, double factor, size_t bytes) {
+    return factor * baseline.kb_per_byte * bytes + memory_slack_kb;
+};
+
+#if defined(LUAU_BEAUTIFY_LIBFUZZER)
+
+// under libFuzzer crashes, -timeout and -rss_limit_mb are its job (and -minimize_crash=1 shrinks what
+// it finds), only the time against the baseline is checked here
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static double factor = getenv("LUAU_BEAUTIFY_FUZZ_FACTOR") ? atof(getenv("LUAU_BEAUTIFY_FUZZ_FACTOR")) : 50;
+    static Baseline baseline = [] {
+        std::string linear = generateLinearSource(baseline_bytes);
+        double best = 0;
+        for (int i = 0; i < 3; i++) {
+            double ms;
+            formatTimed(linear, HandleOptions(), ms);
+            best = i == 0 ? ms : std::min(best, ms);
+        }
+        return Baseline { best * 1e6 / linear.size(), 0 };
+    }();
+
+    FuzzCase fuzz_case = generateFuzzCase(data, size);
+    if (fuzz_case.source.size() < default_min_bytes)
+        return 0;
+
+    double ms;
+    formatTimed(fuzz_case.source, fuzz_case.options, ms);
+
+    double budget = timeBudgetMs(baseline, factor, fuzz_case.source.size());
+    if (ms > budget) {
+        fprintf(stderr, "slow: %.1fms for %zu bytes, budget %.1fms (%.1fns per byte, factor %g), options%s\n", ms,
+            fuzz_case.source.size(), budget, baseline.ns_per_byte, factor, describeOptions(fuzz_case.options).c_str());
+        abort();
+    }
+    return 0;
+};
+
+#else
+
+enum class Outcome {
+    Ok,
+    ParseError,
+    Slow,
+    Memory,
+    Timeout,
+    Crash
+};
+const char* outcome_names[] = { "ok", "parse-error", "slow", "memory", "timeout", "crash" };
+
+struct RunResult {
+    Outcome outcome = Outcome::Ok;
+    int signal = 0;
+    double ms = 0;
+    double rss_kb = 0;
+};
+
+// what the child sends back through the pipe
+struct ChildReport {
+    double ms;
+    long rss_kb;
+    bool parsed;
+    bool out_of_memory;
+};
+
+// formats (or only parses) source in a child process, so crashes, timeouts and runaway allocations
+// take down the child and get reported instead. budgets are only checked by classify
+RunResult runIsolated(const std::string& source, const HandleOptions& options, const FuzzOptions& fuzz_options, bool parse_only) {
+    RunResult result;
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        struct rlimit limit;
+        limit.rlim_cur = limit.rlim_max = (rlim_t) fuzz_options.memory_mb * 1024 * 1024;
+        setrlimit(RLIMIT_AS, &limit);
+
+        // the default action of SIGALRM kills the child, which the parent reports as a timeout
+        struct itimerval timer = {};
+        timer.it_value.tv_sec = fuzz_options.timeout_ms / 1000;
+        timer.it_value.tv_usec = (fuzz_options.timeout_ms % 1000) * 1000;
+        setitimer(ITIMER_REAL, &timer, nullptr);
+
+        ChildReport report = {};
+        long rss_before = getPeakRssKb();
+        try {
+            if (parse_only) {
+                Luau::Allocator allocator;
+                Luau::AstNameTable names(allocator);
+                Clock::time_point start = Clock::now();
+                report.parsed = parseInto(source.data(), source.size(), names, allocator).errors.empty();
+                report.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            } else
+                report.parsed = formatTimed(source, options, report.ms);
+        } catch (const std::bad_alloc&) {
+            report.out_of_memory = true;
+        }
+        report.rss_kb = getPeakRssKb() - rss_before;
+
+        ssize_t written = write(fds[1], &report, sizeof(report));
+        _exit(written == sizeof(report) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ChildReport report = {};
+    ssize_t received = read(fds[0], &report, sizeof(report));
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    if (WIFSIGNALED(status)) {
+        result.signal = WTERMSIG(status);
+        result.outcome = result.signal == SIGALRM ? Outcome::Timeout : Outcome::Crash;
+        if (result.outcome == Outcome::Timeout)
+            report.ms = fuzz_options.timeout_ms;
+    } else if (received != sizeof(report) || WEXITSTATUS(status) != 0)
+        result.outcome = Outcome::Crash;
+    else if (report.out_of_memory)
+        result.outcome = Outcome::Memory;
+    else if (!report.parsed)
+        result.outcome = Outcome::ParseError;
+
+    result.ms = report.ms;
+    result.rss_kb = (double) report.rss_kb;
+    return result;
+};
+
+// turns an Ok run into Slow or Memory when it is over budget for its size
+void classify(RunResult& result, size_t bytes, const Baseline& baseline, const FuzzOptions& options) {
+    if (result.outcome != Outcome::Ok || bytes < options.min_bytes)
+        return;
+    if (result.ms > timeBudgetMs(baseline, options.factor, bytes))
+        result.outcome = Outcome::Slow;
+    else if (result.rss_kb > memoryBudgetKb(baseline, options.factor, bytes))
+        result.outcome = Outcome::Memory;
+};
+
+RunResult runCase(const std::string& source, const HandleOptions& handle, const Baseline& baseline, const FuzzOptions& options) {
+    RunResult result = runIsolated(source, handle, options, false);
+    classify(result, source.size(), baseline, options);
+
+    // a slow run has to be slow twice, a busy machine shouldn't be a finding
+    if (result.outcome == Outcome::Slow) {
+        RunResult again = runIsolated(source, handle, options, false);
+        classify(again, source.size(), baseline, options);
+        if (again.outcome != Outcome::Slow)
+            return again;
+        result.ms = std::min(result.ms, again.ms);
+    }
+    return result;
+};
+
+Baseline calibrate(const FuzzOptions& options) {
+    std::string linear = generateLinearSource(baseline_bytes);
+    Baseline baseline;
+    for (int i = 0; i < 3; i++) {
+        RunResult result = runIsolated(linear, HandleOptions(), options, false);
+        if (result.outcome != Outcome::Ok) {
+            fprintf(stderr, "Error: the baseline program failed (%s), can't calibrate\n", outcome_names[(int) result.outcome]);
+            exit(1);
+        }
+
+        double ns_per_byte = result.ms * 1e6 / linear.size();
+        baseline.ns_per_byte = i == 0 ? ns_per_byte : std::min(baseline.ns_per_byte, ns_per_byte);
+        baseline.kb_per_byte = std::max(baseline.kb_per_byte, result.rss_kb / linear.size());
+    }
+    return baseline;
+};
+
+uint64_t hashSource(const std::string& source) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : source)
+        hash = (hash ^ (uint8_t) c) * 1099511628211ull;
+    return hash;
+};
+
+bool writeSource(const std::string& path, const std::string& source) {
+    FILE* file = fopen(path.c_str(), "wb");
+    bool ok = file && fwrite(source.data(), 1, source.size(), file) == source.size();
+    if (file)
+        ok = fclose(file) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "failed to write file %s\n", path.c_str());
+    return ok;
+};
+
+// saves source (and a reduced copy of it) to the findings directory and reports it
+void reportFinding(const std::string& source, const HandleOptions& handle, const RunResult& result, const Baseline& baseline, const FuzzOptions& options) {
+    mkdir(options.out_dir, 0755);
+
+    char name[96];
+    snprintf(name, sizeof(name), "%s-%016llx-%s", outcome_names[(int) result.outcome], (unsigned long long) hashSource(source),
+        optionsSuffix(handle).c_str());
+    std::string path = joinPaths(options.out_dir, std::string(name) + ".luau");
+    writeSource(path, source);
+
+    fprintf(stderr, "%s: %s, %zu bytes, %.1fms (budget %.1fms), %.0fKB", outcome_names[(int) result.outcome], path.c_str(), source.size(),
+        result.ms, timeBudgetMs(baseline, options.factor, source.size()), result.rss_kb);
+    if (result.signal)
+        fprintf(stderr, ", signal %d (%s)", result.signal, strsignal(result.signal));
+    fprintf(stderr, ", options%s\n", describeOptions(handle).c_str());
+
+    if (!options.reduce || result.outcome == Outcome::ParseError)
+        return;
+
+    // a parser crash would take the reducer down with it when it parses, so that only deletes lines
+    RunResult parse = runIsolated(source, handle, options, true);
+    bool parse_safe = parse.outcome != Outcome::Crash && parse.outcome != Outcome::Timeout;
+
+    std::string reduced = reduceSource(source, [&](const std::string& candidate) {
+        RunResult candidate_result = runIsolated(candidate, handle, options, false);
+        classify(candidate_result, candidate.size(), baseline, options);
+        return candidate_result.outcome == result.outcome && candidate_result.signal == result.signal;
+    }, parse_safe, options.reduce_attempts);
+
+    std::string reduced_path = joinPaths(options.out_dir, std::string(name) + ".min.luau");
+    if (writeSource(reduced_path, reduced))
+        fprintf(stderr, "    reduced to %zu bytes: %s\n", reduced.size(), reduced_path.c_str());
+};
+
+void displayHelp(const char* path) {
+    printf("Usage: %s [options] [files]\n\n", path);
+    printf("Generates Luau programs and flags every one whose formatting crashes, times out, or takes more time or\n");
+    printf("memory than factor times what a plain program of the same size does. findings are saved with a reduced copy.\n");
+    printf("Files given are checked instead: .lua and .luau files are formatted as they are, anything else is read\n");
+    printf("as fuzzer bytes (a libFuzzer crash file for example) and turned into a program first.\n\n");
+    printf("Options:\n");
+    printf("  --seed <n>: seed of the generated inputs (defaults to 1)\n");
+    printf("  --runs <n>: number of generated programs (defaults to 1000)\n");
+    printf("  --max-len <n>: most fuzzer bytes a program is generated from (defaults to 4096)\n");
+    printf("  --factor <n>: how many times slower or bigger than the baseline is flagged (defaults to 50)\n");
+    printf("  --min-bytes <n>: programs shorter than this are never flagged as slow (defaults to 4096)\n");
+    printf("  --timeout <ms>: a run taking longer is a timeout (defaults to 5000)\n");
+    printf("  --memory <mb>: address space limit of a run (defaults to 2048)\n");
+    printf("  --out <dir>: where findings are saved (defaults to fuzz-findings)\n");
+    printf("  --no-reduce: only save findings, don't reduce them\n");
+    printf("  --reduce-attempts <n>: most runs spent reducing one finding (defaults to 2000)\n");
+    printf("  --minify, --nosolve, --ignoretypes, --replaceifelseexpr, --extra1: options for .lua and .luau files\n");
+};
+
+int main(int argc, char** argv) {
+    FuzzOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "--help") == 0) {
+            displayHelp(argv[0]);
+            return 0;
+        } else if (strcmp(arg, "--seed") == 0 && has_value)
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--runs") == 0 && has_value)
+            options.runs = (unsigned) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--max-len") == 0 && has_value)
+            options.max_len = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+        else if (strcmp(arg, "--factor") == 0 && has_value)
+            options.factor = atof(argv[++i]);
+        else if (strcmp(arg, "--min-bytes") == 0 && has_value)
+            options.min_bytes = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--timeout") == 0 && has_value)
+            options.timeout_ms = std::max(1u, (unsigned) strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(arg, "--memory") == 0 && has_value)
+            options.memory_mb = std::max<size_t>(64, strtoull(argv[++i], nullptr, 10));
+        else if (strcmp(arg, "--out") == 0 && has_value)
+            options.out_dir = argv[++i];
+        else if (strcmp(arg, "--no-reduce") == 0)
+            options.reduce = false;
+        else if (strcmp(arg, "--reduce-attempts") == 0 && has_value)
+            options.reduce_attempts = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--minify") == 0)
+            options.handle.minify = true;
+        else if (strcmp(arg, "--nosolve") == 0)
+            options.handle.nosolve = true;
+        else if (strcmp(arg, "--ignoretypes") == 0)
+            options.handle.ignore_types = true;
+        else if (strcmp(arg, "--replaceifelseexpr") == 0)
+            options.handle.replace_if_expressions = true;
+        else if (strcmp(arg, "--extra1") == 0)
+            options.handle.extra1 = true;
+        else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Error: unrecognized option '%s'\n\n", arg);
+            displayHelp(argv[0]);
+            return 1;
+        } else
+            options.inputs.push_back(arg);
+    }
+
+    Baseline baseline = calibrate(options);
+    fprintf(stderr, "baseline: %.1fns and %.3fKB per byte, flagging past %gx\n", baseline.ns_per_byte, baseline.kb_per_byte, options.factor);
+
+    size_t findings = 0;
+    auto check = [&](const std::string& source, const HandleOptions& handle) {
+        RunResult result = runCase(source, handle, baseline, options);
+        if (result.outcome != Outcome::Ok && result.outcome != Outcome::ParseError) {
+            findings++;
+            reportFinding(source, handle, result, baseline, options);
+        }
+        return result;
+    };
+
+    if (!options.inputs.empty()) {
+        for (const std::string& input : options.inputs) {
+            std::optional<std::string> contents = readFile(input);
+            if (!contents) {
+                fprintf(stderr, "failed to read file %s\n", input.c_str());
+                return 1;
+            }
+
+            RunResult result;
+            if (hasSourceExtension(input))
+                result = check(*contents, options.handle);
+            else {
+                FuzzCase fuzz_case = generateFuzzCase((const uint8_t*) contents->data(), contents->size());
+                result = check(fuzz_case.source, fuzz_case.options);
+            }
+            fprintf(stderr, "%s: %s, %.1fms\n", input.c_str(), outcome_names[(int) result.outcome], result.ms);
+        }
+        return findings == 0 ? 0 : 1;
+    }
+
+    std::mt19937_64 random(options.seed);
+    std::vector<uint8_t> bytes;
+    size_t parse_errors = 0;
+    for (unsigned run = 0; run < options.runs; run++) {
+        bytes.resize(1 + random() % options.max_len);
+        for (uint8_t& byte : bytes)
+            byte = (uint8_t) random();
+
+        FuzzCase fuzz_case = generateFuzzCase(bytes.data(), bytes.size());
+        if (check(fuzz_case.source, fuzz_case.options).outcome == Outcome::ParseError)
+            parse_errors++;
+    }
+
+    // the generator should only build valid programs, these are bugs in it (or in the parser)
+    if (parse_errors > 0)
+        fprintf(stderr, "%zu generated programs didn't parse\n", parse_errors);
+    fprintf(stderr, "%u runs, %zu findings\n", options.runs, findings);
+    return findings == 0 ? 0 : 1;
+};
+
+#endif
@@ -0,0 +1,507 @@
+#include "generator.hpp"
+
+#include <cstdio>
+
+// the parser gives up past 1000 levels of nesting. a block costs a few of them, an elseif or an
+// expression level (a group in a chain included) one or two, so nesting stays well under it
+constexpr unsigned max_block_depth = 12;
+constexpr unsigned max_expr_depth = 96;
+constexpr unsigned max_nesting = 160;
+// generation winds down to the smallest productions past this, so repeats can't run away
+constexpr size_t max_source_size = 1024 * 1024;
+
+struct FuzzBytes {
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+
+    bool empty() const {
+        return position >= size;
+    }
+
+    // 0 once the bytes run out, which is always the smallest production
+    uint8_t byte() {
+        return position < size ? data[position++] : 0;
+    }
+
+    // in [0, bound)
+    unsigned below(unsigned bound) {
+        unsigned value = byte();
+        if (bound > 256)
+            value |= (unsigned) byte() << 8;
+        return value % bound;
+    }
+};
+
+static const char* fuzz_binary_operators[] = { "+", "-", "*", "/", "//", "%", "^", "..", "~=", "==", "<", "<=", ">", ">=", "and", "or" };
+static const char* fuzz_escapes[] = { "\\n", "\\t", "\\\"", "\\\\", "\\x7F", "\\000", "\\255", "\\u{48}" };
+
+struct FuzzGenerator {
+    FuzzBytes bytes;
+    std::string out;
+    unsigned next_local = 0;
+    // blocks, elseifs and expression levels that are open, across function bodies too
+    unsigned nesting = 0;
+
+    bool exhausted() const {
+        return bytes.empty() || out.size() > max_source_size || nesting >= max_nesting;
+    }
+
+    void number() {
+        char buffer[64];
+        switch (bytes.below(4)) {
+            case 0:
+                snprintf(buffer, sizeof(buffer), "%u", bytes.below(1000));
+                break;
+            case 1:
+                snprintf(buffer, sizeof(buffer), "0x%X", bytes.below(65536) * 65521u);
+                break;
+            case 2:
+                snprintf(buffer, sizeof(buffer), "%u.%u", bytes.below(10000), bytes.below(1000));
+                break;
+            default:
+                snprintf(buffer, sizeof(buffer), "%ue%u", bytes.below(100), bytes.below(320));
+                break;
+        }
+        out.append(buffer);
+    }
+
+    void string() {
+        out += '"';
+        unsigned length = bytes.below(24);
+        for (unsigned i = 0; i < length; i++) {
+            uint8_t choice = bytes.byte();
+            if (choice < 32)
+                out.append(fuzz_escapes[choice % 8]);
+            else
+                out += (char) ('a' + choice % 26);
+        }
+        out += '"';
+    }
+
+    void local() {
+        out += 'v';
+        out.append(std::to_string(next_local == 0 ? 0 : bytes.below(next_local)));
+    }
+
+    void newLocal() {
+        out += 'v';
+        out.append(std::to_string(next_local++));
+    }
+
+    void exprList(unsigned depth, unsigned count) {
+        for (unsigned i = 0; i < count; i++) {
+            if (i > 0)
+                out.append(", ");
+            expr(depth);
+        }
+    }
+
+    void expr(unsigned depth) {
+        if (depth >= max_expr_depth || exhausted()) {
+            out.append("1");
+            return;
+        }
+
+        nesting++;
+        exprBody(depth);
+        nesting--;
+    }
+
+    void exprBody(unsigned depth) {
+        switch (bytes.below(20)) {
+            case 0:
+                number();
+                break;
+            case 1:
+                string();
+                break;
+            case 2: {
+                static const char* constants[] = { "nil", "true", "false" };
+                out.append(constants[bytes.below(3)]);
+                break;
+            }
+            case 3:
+                local();
+                break;
+            case 4: {
+                // the space keeps "- -1" from being read as a comment
+                static const char* unary[] = { "- ", "not ", "#" };
+                out.append(unary[bytes.below(3)]);
+                expr(depth + 1);
+                break;
+            }
+            case 5:
+            case 6:
+                out += '(';
+                expr(depth + 1);
+                out += ' ';
+                out.append(fuzz_binary_operators[bytes.below(16)]);
+                out += ' ';
+                expr(depth + 1);
+                out += ')';
+                break;
+            case 7: {
+                // a chain of groups, getRootExpr and getSolveResultType walk the whole thing every time
+                unsigned chain = 1 + bytes.below(32);
+                if (depth + chain >= max_expr_depth || nesting + chain >= max_nesting)
+                    chain = 1;
+                out.append(chain, '(');
+                nesting += chain;
+                expr(depth + chain);
+                nesting -= chain;
+                out.append(chain, ')');
+                break;
+            }
+            case 8: {
+                out += '{';
+                unsigned count = bytes.below(12);
+                for (unsigned i = 0; i < count; i++) {
+                    if (i > 0)
+                        out.append(", ");
+                    switch (bytes.below(4)) {
+                        case 0:
+                            expr(depth + 1);
+                            break;
+                        case 1:
+                            out.append("nil");
+                            break;
+                        case 2:
+                            out.append("field");
+                            out.append(std::to_string(i));
+                            out.append(" = ");
+                            expr(depth + 1);
+                            break;
+                        default:
+                            out += '[';
+                            expr(depth + 1);
+                            out.append("] = ");
+                            expr(depth + 1);
+                            break;
+                    }
+                }
+                out += '}';
+                break;
+            }
+            case 9:
+                // the wrapper testInlineNumberThroughStringLenFunction folds
+                out.append("(function(a) return #a ");
+                out.append(fuzz_binary_operators[bytes.below(6)]);
+                out += ' ';
+                expr(depth + 1);
+                out.append(" end)(");
+                string();
+                out += ')';
+                break;
+            case 10:
+                // testSimpleFunctionCall, getConstantList follows these into the returned expression
+                out.append("(function() return ");
+                expr(depth + 1);
+                out.append(" end)()");
+                break;
+            case 11: {
+                out.append("if ");
+                expr(depth + 1);
+                out.append(" then ");
+                expr(depth + 1);
+                unsigned elseifs = bytes.below(8);
+                for (unsigned i = 0; i < elseifs; i++) {
+                    out.append(" elseif ");
+                    expr(depth + 1);
+                    out.append(" then ");
+                    expr(depth + 1);
+                }
+                out.append(" else ");
+                expr(depth + 1);
+                break;
+            }
+            case 12:
+                // the spaces keep a table from making it a "{{", which interpolated strings reject
+                out.append("`a{ ");
+                expr(depth + 1);
+                out.append(" }b`");
+                break;
+            case 13:
+                local();
+                if (bytes.below(2) == 0) {
+                    out.append(".field");
+                    out.append(std::to_string(bytes.below(8)));
+                } else {
+                    out += '[';
+                    expr(depth + 1);
+                    out += ']';
+                }
+                break;
+            case 14:
+                local();
+                out.append(bytes.below(2) == 0 ? "(" : ":method(");
+                exprList(depth + 1, bytes.below(4));
+                out += ')';
+                break;
+            case 15:
+                out.append("function(a, ...)\n");
+                block(max_block_depth - 1);
+                out.append("end");
+                break;
+            case 16: {
+                unsigned count = 2 + bytes.below(16);
+                for (unsigned i = 0; i < count; i++) {
+                    if (i > 0)
+                        out.append(" .. ");
+                    if (bytes.below(2) == 0)
+                        string();
+                    else
+                        number();
+                }
+                break;
+            }
+            case 17: {
+                // long flat arithmetic, every level of it is a binary node
+                unsigned count = 2 + bytes.below(64);
+                for (unsigned i = 0; i < count; i++) {
+                    if (i > 0) {
+                        out += ' ';
+                        out.append(fuzz_binary_operators[bytes.below(7)]);
+                        out += ' ';
+                    }
+                    number();
+                }
+                break;
+            }
+            case 18: {
+                out.append("#{");
+                unsigned count = bytes.below(16);
+                exprList(depth + 1, count);
+                if (bytes.below(2) == 0)
+                    out.append(count > 0 ? ", nil" : "nil");
+                out += '}';
+                break;
+            }
+            default:
+                expr(depth + 1);
+                out.append(bytes.below(2) == 0 ? " == " : " < ");
+                expr(depth + 1);
+                break;
+        }
+    }
+
+    void stat(unsigned depth) {
+        if (exhausted()) {
+            out.append("local ");
+            newLocal();
+            out.append(" = 1\n");
+            return;
+        }
+
+        unsigned kind = bytes.below(14);
+        // nested blocks past the limit only get the simple statements
+        if (depth >= max_block_depth && kind >= 3)
+            kind = 0;
+
+        switch (kind) {
+            case 0:
+                out.append("local ");
+                newLocal();
+                out.append(" = ");
+                expr(0);
+                out += '\n';
+                break;
+            case 1:
+                local();
+                out.append(" = ");
+                expr(0);
+                out += '\n';
+                break;
+            case 2:
+                local();
+                out.append(" += ");
+                expr(0);
+                out += '\n';
+                break;
+            case 3: {
+                out.append("if ");
+                expr(0);
+                out.append(" then\n");
+                block(depth + 1);
+                unsigned elseifs = bytes.below(32);
+                unsigned nesting_before = nesting;
+                for (unsigned i = 0; i < elseifs; i++) {
+                    // the parser nests every elseif in the one before it
+                    nesting++;
+                    out.append("elseif ");
+                    expr(0);
+                    out.append(" then\n");
+                    block(depth + 1);
+                }
+                if (bytes.below(2) == 0) {
+                    out.append("else\n");
+                    block(depth + 1);
+                }
+                nesting = nesting_before;
+                out.append("end\n");
+                break;
+            }
+            case 4:
+                out.append("while ");
+                expr(0);
+                out.append(" do\n");
+                block(depth + 1);
+                out.append("end\n");
+                break;
+            case 5: {
+                // with the break at the end this is the loop DummyForLoopVisitor unwraps under --extra1
+                out.append("for i = ");
+                expr(0);
+                out.append(", ");
+                expr(0);
+                out.append(" do\n");
+                block(depth + 1, bytes.below(2) == 0 ? "break\n" : nullptr);
+                out.append("end\n");
+                break;
+            }
+            case 6:
+                out.append("for k, v in pairs(");
+                expr(0);
+                out.append(") do\n");
+                block(depth + 1);
+                out.append("end\n");
+                break;
+            case 7:
+                out.append("local function ");
+                newLocal();
+                out.append("(a, b)\n");
+                block(depth + 1, "return a\n");
+                out.append("end\n");
+                break;
+            case 8:
+                out.append("print(");
+                exprList(0, bytes.below(4));
+                out.append(")\n");
+                break;
+            case 9: {
+                // the same statement over and over, for inputs far bigger than the bytes behind them
+                unsigned count = 1 + bytes.below(512);
+                size_t start = out.size();
+                stat(depth);
+                std::string copy = out.substr(start);
+                for (unsigned i = 1; i < count && out.size() + copy.size() <= max_source_size; i++)
+                    out.append(copy);
+                break;
+            }
+            case 10:
+                out.append("do\n");
+                block(depth + 1);
+                out.append("end\n");
+                break;
+            case 11:
+                // what --replaceifelseexpr rewrites into if statements
+                out.append("local ");
+                newLocal();
+                out.append(" = ");
+                for (unsigned nested = bytes.below(16); nested > 0; nested--) {
+                    out.append("if ");
+                    expr(0);
+                    out.append(" then ");
+                    expr(0);
+                    out.append(" else ");
+                }
+                expr(0);
+                out += '\n';
+                break;
+            case 12: {
+                // control flow flattened into a state machine
+                out.append("local state = 1\nwhile true do\n");
+                unsigned states = 1 + bytes.below(32);
+                for (unsigned i = 1; i <= states; i++) {
+                    out.append(i == 1 ? "if state == " : "elseif state == ");
+                    out.append(std::to_string(i));
+                    out.append(" then\n");
+                    block(depth + 1, nullptr);
+                    out.append("state = ");
+                    out.append(std::to_string(i + 1));
+                    out += '\n';
+                }
+                out.append("else\nbreak\nend\nend\n");
+                break;
+            }
+            default:
+                out.append("local ");
+                newLocal();
+                out.append(", ");
+                newLocal();
+                out.append(" = ");
+                exprList(0, 2);
+                out += '\n';
+                break;
+        }
+    }
+
+    // last is appended as the final statement (break and return have to be last)
+    void block(unsigned depth, const char* last = nullptr) {
+        nesting += 2;
+        unsigned count = exhausted() ? 0 : bytes.below(8);
+        for (unsigned i = 0; i < count; i++)
+            stat(depth);
+        if (last)
+            out.append(last);
+        nesting -= 2;
+    }
+};
+
+FuzzCase generateFuzzCase(const uint8_t* data, size_t size) {
+    FuzzCase fuzz_case;
+
+    FuzzGenerator generator { { data, size } };
+    uint8_t flags = generator.bytes.byte();
+    fuzz_case.options.minify = flags & 1;
+    fuzz_case.options.nosolve = flags & 2;
+    fuzz_case.options.ignore_types = flags & 4;
+    fuzz_case.options.replace_if_expressions = flags & 8;
+    fuzz_case.options.extra1 = flags & 16;
+
+    unsigned count = 1 + generator.bytes.below(64);
+    for (unsigned i = 0; i < count; i++)
+        generator.stat(0);
+
+    fuzz_case.source = std::move(generator.out);
+    return fuzz_case;
+};
+
+std::string describeOptions(const HandleOptions& options) {
+    std::string flags;
+    if (options.minify)
+        flags.append(" --minify");
+    if (options.nosolve)
+        flags.append(" --nosolve");
+    if (options.ignore_types)
+        flags.append(" --ignoretypes");
+    if (options.replace_if_expressions)
+        flags.append(" --replaceifelseexpr");
+    if (options.extra1)
+        flags.append(" --extra1");
+    return flags;
+};
+
+std::string optionsSuffix(const HandleOptions& options) {
+    std::string suffix;
+    for (char c : describeOptions(options)) {
+        if (c == ' ')
+            suffix += '-';
+        else if (c != '-')
+            suffix += c;
+    }
+    return suffix.empty() ? "default" : suffix.substr(1);
+};
+
+std::string generateLinearSource(size_t size) {
+    std::string source;
+    unsigned index = 0;
+    while (source.size() < size) {
+        std::string name = "v" + std::to_string(index);
+        source.append("local " + name + " = " + std::to_string(index % 97) + " + " + std::to_string(index % 13) + "\n");
+        source.append("if " + name + " > 10 then\n    print(\"value\", " + name + ", {1, 2, 3})\nelse\n    " + name + " = " + name + " * 2\nend\n");
+        source.append("local function f" + std::to_string(index) + "(a, b)\n    return a.field[b] .. \"text\\n\"\nend\n");
+        index++;
+    }
+    return source;
+};
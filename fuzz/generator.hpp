@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "handle.hpp"
+
+// a Luau program and the options it is formatted with, built from fuzzer bytes. every byte is a choice
+// of the grammar (which statement, which expression, how many times to repeat something), so mutations
+// of the bytes stay valid programs, and running out of bytes only picks the smallest productions
+struct FuzzCase {
+    std::string source;
+    HandleOptions options;
+};
+
+FuzzCase generateFuzzCase(const uint8_t* data, size_t size);
+
+// the command line flags for options, " --minify --extra1" and so on
+std::string describeOptions(const HandleOptions& options);
+// the same flags as a file name suffix, "minify-extra1", "default" without any
+std::string optionsSuffix(const HandleOptions& options);
+
+// a program with the same mix of statements as real scripts and none of the slow constructs, the
+// baseline every fuzz case is compared against. roughly size bytes
+std::string generateLinearSource(size_t size);
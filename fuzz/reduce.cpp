@@ -0,0 +1,280 @@
+#include "reduce.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+#include "Luau/ParseResult.h"
+
+#include "handle.hpp"
+
+using namespace Luau;
+
+// byte ranges to cut out of the source, or to replace with other text
+struct Edit {
+    size_t begin;
+    size_t end;
+    std::string replacement;
+};
+
+struct SourceReducer {
+    std::string source;
+    const std::function<bool(const std::string&)>& interesting;
+    size_t attempts_left;
+
+    // the start of every line, Luau locations are (line, byte column)
+    std::vector<size_t> line_starts;
+
+    bool exhausted() const {
+        return attempts_left == 0;
+    }
+
+    void indexLines() {
+        line_starts.assign(1, 0);
+        for (size_t index = 0; index < source.size(); index++)
+            if (source[index] == '\n')
+                line_starts.push_back(index + 1);
+    }
+
+    size_t offset(const Position& position) const {
+        if (position.line >= line_starts.size())
+            return source.size();
+        return std::min(source.size(), line_starts[position.line] + position.column);
+    }
+
+    std::string text(const Location& location) const {
+        size_t begin = offset(location.begin);
+        return source.substr(begin, offset(location.end) - begin);
+    }
+
+    // edits must not overlap, commits them when the result is still interesting
+    bool attempt(std::vector<Edit> edits) {
+        if (exhausted())
+            return false;
+
+        std::sort(edits.begin(), edits.end(), [](const Edit& a, const Edit& b) {
+            return a.begin < b.begin;
+        });
+
+        std::string candidate;
+        size_t position = 0;
+        for (const Edit& edit : edits) {
+            if (edit.begin < position || edit.end < edit.begin)
+                return false;
+            candidate.append(source, position, edit.begin - position);
+            candidate.append(edit.replacement);
+            position = edit.end;
+        }
+        candidate.append(source, position, std::string::npos);
+
+        if (candidate.size() >= source.size())
+            return false;
+
+        attempts_left--;
+        if (!interesting(candidate))
+            return false;
+
+        source = std::move(candidate);
+        return true;
+    }
+
+    // chunks of the ranges are deleted, then everything but a chunk, with more and smaller chunks
+    // each round (generateSpans and deleteChildStatements in Reduce.cpp). returns true once one stuck,
+    // the ranges are stale after that
+    bool deleteChunks(const std::vector<std::pair<size_t, size_t>>& ranges) {
+        size_t size = ranges.size();
+        if (size == 0)
+            return false;
+
+        for (size_t chunks = size == 1 ? 1 : 2; chunks <= size && !exhausted(); chunks *= 2) {
+            size_t length = std::max<size_t>(1, size / chunks);
+            for (size_t first = 0; first < size; first += length) {
+                size_t last = std::min(first + length, size);
+
+                if (attempt({ { ranges[first].first, ranges[last - 1].second, "" } }))
+                    return true;
+
+                std::vector<Edit> keep_only;
+                if (first > 0)
+                    keep_only.push_back({ ranges[0].first, ranges[first].first, "" });
+                if (last < size)
+                    keep_only.push_back({ ranges[last - 1].second, ranges[size - 1].second, "" });
+                if (!keep_only.empty() && attempt(keep_only))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool reduceLines() {
+        indexLines();
+        std::vector<std::pair<size_t, size_t>> lines;
+        for (size_t line = 0; line < line_starts.size(); line++)
+            lines.push_back({ line_starts[line], line + 1 < line_starts.size() ? line_starts[line + 1] : source.size() });
+        return deleteChunks(lines);
+    }
+
+    std::vector<std::pair<size_t, size_t>> statementRanges(AstStatBlock* block) const {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (AstStat* stat : block->body)
+            ranges.push_back({ offset(stat->location.begin), offset(stat->location.end) });
+        return ranges;
+    }
+
+    // the blocks whose statements can take the place of stat (getNestedStats in Reduce.cpp)
+    std::vector<AstStatBlock*> nestedBlocks(AstStat* stat) const {
+        std::vector<AstStatBlock*> blocks;
+        if (AstStatBlock* block = stat->as<AstStatBlock>())
+            blocks.push_back(block);
+        else if (AstStatIf* stat_if = stat->as<AstStatIf>()) {
+            blocks.push_back(stat_if->thenbody);
+            if (stat_if->elsebody) {
+                if (AstStatBlock* else_block = stat_if->elsebody->as<AstStatBlock>())
+                    blocks.push_back(else_block);
+                else if (AstStatIf* else_if = stat_if->elsebody->as<AstStatIf>()) {
+                    for (AstStatBlock* block : nestedBlocks(else_if))
+                        blocks.push_back(block);
+                }
+            }
+        } else if (AstStatWhile* stat_while = stat->as<AstStatWhile>())
+            blocks.push_back(stat_while->body);
+        else if (AstStatRepeat* stat_repeat = stat->as<AstStatRepeat>())
+            blocks.push_back(stat_repeat->body);
+        else if (AstStatFor* stat_for = stat->as<AstStatFor>())
+            blocks.push_back(stat_for->body);
+        else if (AstStatForIn* stat_for_in = stat->as<AstStatForIn>())
+            blocks.push_back(stat_for_in->body);
+        else if (AstStatFunction* stat_function = stat->as<AstStatFunction>())
+            blocks.push_back(stat_function->func->body);
+        else if (AstStatLocalFunction* stat_local_function = stat->as<AstStatLocalFunction>())
+            blocks.push_back(stat_local_function->func->body);
+        return blocks;
+    }
+
+    bool promoteStatements(AstStatBlock* block) {
+        for (AstStat* stat : block->body) {
+            std::vector<AstStatBlock*> nested = nestedBlocks(stat);
+            if (nested.empty() || nested[0] == stat)
+                continue;
+
+            std::string replacement;
+            for (AstStatBlock* nested_block : nested) {
+                if (nested_block->body.size == 0)
+                    continue;
+                Location inner(nested_block->body.data[0]->location.begin, nested_block->body.data[nested_block->body.size - 1]->location.end);
+                replacement.append(text(inner));
+                replacement += '\n';
+            }
+
+            if (attempt({ { offset(stat->location.begin), offset(stat->location.end), replacement } }))
+                return true;
+        }
+        return false;
+    }
+
+    // the operands an expression could be replaced by
+    static std::vector<AstExpr*> operands(AstExpr* expr) {
+        if (AstExprGroup* expr_group = expr->as<AstExprGroup>())
+            return { expr_group->expr };
+        if (AstExprUnary* expr_unary = expr->as<AstExprUnary>())
+            return { expr_unary->expr };
+        if (AstExprBinary* expr_binary = expr->as<AstExprBinary>())
+            return { expr_binary->left, expr_binary->right };
+        if (AstExprIfElse* expr_if_else = expr->as<AstExprIfElse>())
+            return { expr_if_else->trueExpr, expr_if_else->falseExpr };
+        if (AstExprTypeAssertion* expr_type_assertion = expr->as<AstExprTypeAssertion>())
+            return { expr_type_assertion->expr };
+        if (AstExprIndexExpr* expr_index_expr = expr->as<AstExprIndexExpr>())
+            return { expr_index_expr->expr, expr_index_expr->index };
+        if (AstExprCall* expr_call = expr->as<AstExprCall>()) {
+            std::vector<AstExpr*> result(expr_call->args.begin(), expr_call->args.end());
+            result.push_back(expr_call->func);
+            return result;
+        }
+        if (AstExprTable* expr_table = expr->as<AstExprTable>()) {
+            std::vector<AstExpr*> result;
+            for (const AstExprTable::Item& item : expr_table->items)
+                result.push_back(item.value);
+            return result;
+        }
+        return {};
+    }
+
+    struct ExprCollector : AstVisitor {
+        std::vector<AstExpr*> exprs;
+
+        bool visit(AstExpr* expr) override {
+            exprs.push_back(expr);
+            return true;
+        }
+    };
+
+    bool hoistExpressions(AstStatBlock* root) {
+        ExprCollector collector;
+        root->visit(&collector);
+
+        // outermost first, replacing those removes the most at once
+        for (AstExpr* expr : collector.exprs) {
+            size_t begin = offset(expr->location.begin);
+            size_t end = offset(expr->location.end);
+            for (AstExpr* operand : operands(expr)) {
+                if (attempt({ { begin, end, text(operand->location) } }))
+                    return true;
+            }
+
+            // tables and functions are often the bulk of an expression on their own
+            if (expr->is<AstExprTable>() && end - begin > 2 && attempt({ { begin, end, "{}" } }))
+                return true;
+            if (expr->is<AstExprFunction>() && attempt({ { begin, end, "function() end" } }))
+                return true;
+        }
+        return false;
+    }
+
+    struct BlockCollector : AstVisitor {
+        std::vector<AstStatBlock*> blocks;
+
+        bool visit(AstStatBlock* block) override {
+            blocks.push_back(block);
+            return true;
+        }
+    };
+
+    // one change to the tree, false when nothing that was tried stuck
+    bool reduceTree() {
+        indexLines();
+
+        Allocator allocator;
+        AstNameTable names(allocator);
+        ParseResult result = parseInto(source.data(), source.size(), names, allocator);
+        if (!result.errors.empty())
+            return false;
+
+        BlockCollector collector;
+        result.root->visit(&collector);
+
+        for (AstStatBlock* block : collector.blocks) {
+            if (deleteChunks(statementRanges(block)))
+                return true;
+            if (promoteStatements(block))
+                return true;
+            if (exhausted())
+                return false;
+        }
+
+        return hoistExpressions(result.root);
+    }
+};
+
+std::string reduceSource(std::string source, const std::function<bool(const std::string&)>& interesting, bool parse_safe, size_t max_attempts) {
+    SourceReducer reducer { std::move(source), interesting, max_attempts };
+
+    while (!reducer.exhausted() && reducer.reduceLines()) {}
+    if (parse_safe)
+        while (!reducer.exhausted() && reducer.reduceTree()) {}
+
+    return reducer.source;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// shrinks source while interesting still holds for it, the way Luau/CLI/Reduce.cpp does: chunks of
+// statements are deleted (or kept on their own) with a growing number of chunks, statements are
+// replaced by the blocks nested in them, and here also expressions by one of their operands. it works
+// on the text, cutting out the ranges of the parsed nodes, so the rest of the file stays exactly as is
+// interesting gets called at most max_attempts times. parse_safe says the source can be parsed in this
+// process, when the parser is what crashes only whole lines are deleted
+std::string reduceSource(std::string source, const std::function<bool(const std::string&)>& interesting, bool parse_safe, size_t max_attempts);
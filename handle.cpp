@@ -1,15 +1,19 @@
 #include "handle.hpp"
 
 #include "Luau/Ast.h"
+#include "Luau/Common.h"
 #include "Luau/Lexer.h"
 #include "Luau/ParseOptions.h"
 #include "Luau/ParseResult.h"
 #include "Luau/Parser.h"
-#include "Luau/ToString.h"
+#include "Luau/TimeTrace.h"
 
 #include "beautify.hpp"
+#include "cache.hpp"
 #include "minify.hpp"
+#include "passes.hpp"
 #include "solve.hpp"
+#include "stats.hpp"
 
 #if defined(__EMSCRIPTEN__)
 #include <emscripten/bind.h>
@@ -38,27 +42,59 @@
 // };
 
 
-std::string handleSource(std::string source, bool minify, bool nosolve, bool ignore_types, bool replace_if_expressions, bool extra1) {
-    Luau::Allocator allocator;
-    Luau::AstNameTable names(allocator);
+// same format as Luau::toString(Location), which would pull in all of Analysis
+std::string locationToString(const Luau::Location& location) {
+    return "(" + std::to_string(location.begin.line) + ", " + std::to_string(location.begin.column) + ") - ("
+        + std::to_string(location.end.line) + ", " + std::to_string(location.end.column) + ")";
+};
+
+// lookahead() drops a brace pushed or popped while peeking without this, so "`{ {x} }`" (a table item that
+// starts with a name, inside an interpolated string) failed to parse
+LUAU_FASTFLAG(LuauLexerLookaheadRemembersBraceType)
+
+Luau::ParseResult parseInto(const char* source, size_t size, Luau::AstNameTable& names, Luau::Allocator& allocator) {
+    LUAU_TIMETRACE_SCOPE("parse", "parse");
+    StatsTimer timer(StatsPhase::Parse);
+
+    static bool flags_set = (FFlag::LuauLexerLookaheadRemembersBraceType.value = true);
+    (void) flags_set;
 
     Luau::ParseOptions options;
     options.captureComments = true;
     options.allowDeclarationSyntax = true;
 
-    Luau::ParseResult parse_result = Luau::Parser::parse(source.data(), source.size(), names, allocator, options);
+    Luau::ParseResult result = Luau::Parser::parse(source, size, names, allocator, options);
+    countStats(name_table_entries, names.size());
+    return result;
+};
 
-    if (parse_result.errors.size() > 0) {
-        fprintf(stderr, "Parse errors were encountered\n");
-        for (const Luau::ParseError& error : parse_result.errors) {
-            fprintf(stderr, "   %s - %s\n", Luau::toString(error.getLocation()).c_str(), error.getMessage().c_str());
+std::unique_ptr<ParsedSource> parseSource(std::string source, std::string& error) {
+    std::unique_ptr<ParsedSource> parsed = std::make_unique<ParsedSource>();
+    parsed->source = std::move(source);
+
+    parsed->result = parseInto(parsed->source.data(), parsed->source.size(), parsed->names, parsed->allocator);
+
+    if (parsed->result.errors.size() > 0) {
+        for (const Luau::ParseError& error_in : parsed->result.errors) {
+            error.append("   ")
+                .append(locationToString(error_in.getLocation()))
+                .append(" - ")
+                .append(error_in.getMessage());
+            error += '\n';
         };
-        fprintf(stderr, "\n");
 
-        exit(1);
+        return nullptr;
     };
 
-    Luau::AstStatBlock* root = parse_result.root;
+    return parsed;
+};
+
+void formatResult(Luau::ParseResult& result, const char* source, size_t size, Luau::Allocator& allocator, const HandleOptions& handle_options, OutputSink* sink, void* data, std::string& out) {
+    Luau::AstStatBlock* root = result.root;
+    countDocument(root);
+
+    StatsTimer timer(StatsPhase::Emit);
+    size_t out_start = out.size();
 
     // left here for demonstration purposes
     // Data d;
@@ -66,24 +102,100 @@ std::string handleSource(std::string source, bool minify, bool nosolve, bool ign
     // setupInjectCallback(comment_callback, &d);
 
     setAllocator(&allocator);
-
-    if (minify)
-        return minifyRoot(root, nosolve, ignore_types);
-    else {
-        std::string preface;
-
-        for (Luau::HotComment hot_comment : parse_result.hotcomments) {
-            preface.append("--!")
+    setupOutputSink(sink, data);
+    uint64_t solve_context = prepareSolve(root);
+    setupSolve(handle_options.nosolve, handle_options.ignore_types);
+
+    // --replaceifelseexpr and --extra1 only ever applied to beautify, and only beautify inlines proxies
+    bool beautify = !handle_options.minify;
+    runPasses(allocator, root, handle_options.nosolve, beautify && handle_options.replace_if_expressions, beautify && handle_options.extra1, beautify);
+
+    if (handle_options.minify) {
+        LUAU_TIMETRACE_SCOPE("minify", "emit");
+        out.append(minifyRoot(root, handle_options.nosolve, handle_options.ignore_types));
+    } else {
+        for (Luau::HotComment hot_comment : result.hotcomments) {
+            out.append("--!")
                 .append(hot_comment.content);
-            preface += '\n';
+            out += '\n';
         }
 
-        return preface.append(beautifyRoot(root, nosolve, ignore_types, replace_if_expressions, extra1));
+        if (!emitOutput(out)) {
+            setupOutputSink(nullptr);
+            setAllocator(nullptr);
+            return;
+        }
+
+        bool incremental = isIncremental();
+        if (incremental) {
+            LUAU_TIMETRACE_SCOPE("prepareIncremental", "emit");
+            prepareIncremental(source, size, handle_options.nosolve | handle_options.ignore_types << 1
+                | handle_options.replace_if_expressions << 2 | handle_options.extra1 << 3 | solve_context << 4);
+        };
+
+        {
+            LUAU_TIMETRACE_SCOPE("beautify", "emit");
+            out.append(beautifyRoot(root, handle_options.nosolve, handle_options.ignore_types));
+        };
+
+        if (incremental)
+            finishIncremental();
     };
+
+    // anything printed after the last top-level statement
+    if (!out.empty())
+        emitOutput(out);
+
+    if (!sink)
+        countStats(output_bytes, out.size() - out_start);
+    maxStats(largest_output_buffer, out.capacity());
+    countStats(allocator_pages, allocator.getPageCount());
+    countStats(allocator_bytes, allocator.getPageBytes());
+
+    setupOutputSink(nullptr);
+    setAllocator(nullptr);
+};
+
+void formatParsed(ParsedSource& parsed, const HandleOptions& handle_options, OutputSink* sink, void* data, std::string& out) {
+    formatResult(parsed.result, parsed.source.data(), parsed.source.size(), parsed.allocator, handle_options, sink, data, out);
+};
+
+bool handleSourceStreaming(const std::string& source, const HandleOptions& handle_options, OutputSink* sink, void* data, std::string& out, std::string& error) {
+    std::unique_ptr<ParsedSource> parsed = parseSource(source, error);
+    if (!parsed)
+        return false;
+
+    formatParsed(*parsed, handle_options, sink, data, out);
+    return true;
+};
+
+bool handleSource(const std::string& source, const HandleOptions& options, std::string& out, std::string& error) {
+    return handleSourceStreaming(source, options, nullptr, nullptr, out, error);
+};
+
+std::string handleSource(std::string source, bool minify, bool nosolve, bool ignore_types, bool replace_if_expressions, bool extra1) {
+    HandleOptions options;
+    options.minify = minify;
+    options.nosolve = nosolve;
+    options.ignore_types = ignore_types;
+    options.replace_if_expressions = replace_if_expressions;
+    options.extra1 = extra1;
+
+    std::string result;
+    std::string error;
+    if (!handleSource(source, options, result, error)) {
+        fprintf(stderr, "Parse errors were encountered\n");
+        fprintf(stderr, "%s\n", error.c_str());
+
+        exit(1);
+    };
+
+    return result;
 };
 
 #if defined(__EMSCRIPTEN__)
 EMSCRIPTEN_BINDINGS(my_module) {
     emscripten::function("handleSource", &handleSource);
+    emscripten::function("setIncremental", &setIncremental);
 }
 #endif
\ No newline at end of file
@@ -1,3 +1,43 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
 #include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+#include "Luau/ParseResult.h"
+
+#include "beautify.hpp"
+
+struct HandleOptions {
+    bool minify = false;
+    bool nosolve = false;
+    bool ignore_types = false;
+    bool replace_if_expressions = false;
+    bool extra1 = false;
+};
+
+// a parsed document that owns its source and AST, so it can be parsed and formatted on different threads
+struct ParsedSource {
+    std::string source;
+    Luau::Allocator allocator;
+    Luau::AstNameTable names { allocator };
+    Luau::ParseResult result;
+};
+
+// lower level versions of parseSource and formatParsed for callers that manage the allocator and name
+// table themselves. allocator has to outlive the result, and formatting can append more nodes to it
+Luau::ParseResult parseInto(const char* source, size_t size, Luau::AstNameTable& names, Luau::Allocator& allocator);
+void formatResult(Luau::ParseResult& result, const char* source, size_t size, Luau::Allocator& allocator, const HandleOptions& options, OutputSink* sink, void* data, std::string& out);
+// "(line, column) - (line, column)", 0-based like the rest of Luau
+std::string locationToString(const Luau::Location& location);
+
+// returns nullptr and fills error (one line per parse error) when the source doesn't parse
+std::unique_ptr<ParsedSource> parseSource(std::string source, std::string& error);
+void formatParsed(ParsedSource& parsed, const HandleOptions& options, OutputSink* sink, void* data, std::string& out);
 
-std::string handleSource(std::string source, bool minify, bool nosolve, bool ignore_types, bool replace_if_expressions, bool extra1);
\ No newline at end of file
+// returns false and fills error (one line per parse error) instead of exiting
+bool handleSource(const std::string& source, const HandleOptions& options, std::string& out, std::string& error);
+// hands the output to sink one top-level statement at a time, out is only used as scratch space
+bool handleSourceStreaming(const std::string& source, const HandleOptions& options, OutputSink* sink, void* data, std::string& out, std::string& error);
+std::string handleSource(std::string source, bool minify, bool nosolve, bool ignore_types, bool replace_if_expressions, bool extra1);
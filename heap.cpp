@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#include "memory.hpp"
+
+// the counting allocator hook behind --memory. the size of a block is asked from malloc itself on both
+// ends instead of being stored with it, so blocks allocated before counting was turned on are still freed
+// normally (they only make the current total dip below what is really live)
+
+size_t getBlockSize(void* block) {
+#if defined(_WIN32)
+    return _msize(block);
+#elif defined(__APPLE__)
+    return malloc_size(block);
+#else
+    return malloc_usable_size(block);
+#endif
+};
+
+void* operator new(size_t size) {
+    for (;;) {
+        if (void* block = malloc(size == 0 ? 1 : size)) {
+            if (heap_counting)
+                countHeapAlloc(getBlockSize(block));
+            return block;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+};
+
+void* operator new[](size_t size) {
+    return operator new(size);
+};
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+};
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+};
+
+void operator delete(void* block) noexcept {
+    if (!block)
+        return;
+
+    if (heap_counting)
+        countHeapFree(getBlockSize(block));
+    free(block);
+};
+
+void operator delete[](void* block) noexcept {
+    operator delete(block);
+};
+
+void operator delete(void* block, size_t) noexcept {
+    operator delete(block);
+};
+
+void operator delete[](void* block, size_t) noexcept {
+    operator delete(block);
+};
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+    operator delete(block);
+};
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+    operator delete(block);
+};
+
+#if defined(__cpp_aligned_new)
+
+// over-aligned types are allocated through these. on Windows their blocks have to be freed with
+// _aligned_free, so they can't share malloc and free with the plain ones
+
+void* allocateAligned(size_t size, size_t alignment) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void* block = nullptr;
+    return posix_memalign(&block, alignment, size) == 0 ? block : nullptr;
+#endif
+};
+
+size_t getAlignedBlockSize(void* block, size_t alignment) {
+#if defined(_WIN32)
+    return _aligned_msize(block, alignment, 0);
+#else
+    (void) alignment;
+    return getBlockSize(block);
+#endif
+};
+
+void freeAligned(void* block) {
+#if defined(_WIN32)
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+};
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    // posix_memalign needs at least the alignment of a pointer
+    size_t align = std::max((size_t) alignment, sizeof(void*));
+
+    for (;;) {
+        if (void* block = allocateAligned(size == 0 ? 1 : size, align)) {
+            if (heap_counting)
+                countHeapAlloc(getAlignedBlockSize(block, align));
+            return block;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+};
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+};
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+};
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return operator new(size, alignment, std::nothrow);
+};
+
+void operator delete(void* block, std::align_val_t alignment) noexcept {
+    if (!block)
+        return;
+
+    if (heap_counting)
+        countHeapFree(getAlignedBlockSize(block, std::max((size_t) alignment, sizeof(void*))));
+    freeAligned(block);
+};
+
+void operator delete[](void* block, std::align_val_t alignment) noexcept {
+    operator delete(block, alignment);
+};
+
+void operator delete(void* block, size_t, std::align_val_t alignment) noexcept {
+    operator delete(block, alignment);
+};
+
+void operator delete[](void* block, size_t, std::align_val_t alignment) noexcept {
+    operator delete(block, alignment);
+};
+
+void operator delete(void* block, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete(block, alignment);
+};
+
+void operator delete[](void* block, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete(block, alignment);
+};
+
+#endif
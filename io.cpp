@@ -0,0 +1,687 @@
+#include "io.hpp"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "FileUtils.h"
+#include "Luau/TimeTrace.h"
+
+#include "output.hpp"
+#include "pool.hpp"
+#include "stats.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class ThreadBatchIo : public BatchIo {
+    WorkerPool pool;
+
+    public:
+    ThreadBatchIo(unsigned io_threads)
+        : pool(io_threads) {}
+
+    ~ThreadBatchIo() override {
+        pool.wait();
+    }
+
+    void read(const std::string& path, std::function<void(std::optional<std::string>)> done) override {
+        pool.push([path, done = std::move(done)] {
+            std::optional<std::string> contents;
+            {
+                LUAU_TIMETRACE_SCOPE("read", "io");
+                LUAU_TIMETRACE_ARGUMENT("file", path.c_str());
+                StatsTimer timer(StatsPhase::Read);
+                contents = readFile(path);
+            };
+            done(std::move(contents));
+        });
+    }
+
+    void write(const std::string& path, std::string data, std::function<void(bool)> done) override {
+        pool.push([path, data = std::move(data), done = std::move(done)] {
+            bool written;
+            {
+                LUAU_TIMETRACE_SCOPE("write", "io");
+                LUAU_TIMETRACE_ARGUMENT("file", path.c_str());
+                StatsTimer timer(StatsPhase::Write);
+                written = replaceFile(path, data);
+            };
+            done(written);
+        });
+    }
+
+    const char* name() const override {
+        return "threads";
+    }
+};
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+
+constexpr unsigned uring_entries = 256;
+// reads and writes are issued in pieces of at most this
+constexpr size_t uring_chunk_size = 1 << 20;
+// times io_uring_enter is retried while it refuses more work and nothing is in flight to wait for
+constexpr unsigned uring_retries = 64;
+// temp names tried before a write gives up, each one that already exists (left by a crashed run) is skipped
+constexpr unsigned uring_temp_attempts = 16;
+
+int uringSetup(unsigned entries, io_uring_params* params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+};
+
+int uringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+};
+
+int uringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, count);
+};
+
+// one read or write, driven through its steps by the completions of the operations it queues
+struct UringRequest {
+    enum Kind {
+        Read,
+        Write
+    } kind;
+
+    enum Step {
+        Wake, // the eventfd read that wakes the ring up for new requests
+        Stat,
+        Open,
+        Transfer,
+        Close,
+        Rename
+    };
+
+    std::string path;
+    std::string temp_path;
+    std::string data;
+
+    std::function<void(std::optional<std::string>)> read_done;
+    std::function<void(bool)> write_done;
+
+    struct statx stat_result = {};
+    int fd = -1;
+    int stat_status = 0;
+    int open_status = 0;
+    int waiting = 0; // statx and openat that haven't completed yet
+    unsigned temp_attempts = 0;
+    size_t offset = 0;
+    bool failed = false;
+};
+
+// user_data of every sqe, so a completion knows which request and step it belongs to
+struct UringOperation {
+    UringRequest* request;
+    UringRequest::Step step;
+};
+
+class UringBatchIo : public BatchIo {
+    int ring_fd = -1;
+    int wake_fd = -1;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned* sq_array;
+    io_uring_sqe* sqes;
+    unsigned sq_entries;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe* cqes;
+    unsigned cq_entries;
+
+    void* sq_map = MAP_FAILED;
+    size_t sq_map_size = 0;
+    void* cq_map = MAP_FAILED;
+    size_t cq_map_size = 0;
+    void* sqe_map = MAP_FAILED;
+    size_t sqe_map_size = 0;
+
+    bool has_rename = false;
+    uint64_t temp_counter = 0;
+
+    unsigned to_submit = 0;
+    unsigned operations = 0; // queued and not taken off the cq yet
+    bool wake_armed = false; // one of the operations is the eventfd read, which only completes with a new request
+    std::deque<std::pair<UringOperation*, int>> completed; // taken off the cq, not handled yet
+    size_t in_flight = 0; // requests that haven't called back yet
+    std::unordered_set<UringRequest*> live; // started and not finished, what abandon has to redo
+    bool broken = false; // io_uring_enter failed for good, see abandon
+    uint64_t wake_value;
+    UringOperation wake_operation { nullptr, UringRequest::Wake };
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::condition_variable wake; // what the loop waits on instead of the ring once it's broken
+    std::deque<UringRequest*> incoming;
+    size_t outstanding = 0; // requests pushed but not finished, guarded by mutex
+    bool stopping = false;
+    std::thread loop_thread;
+
+    // nullptr once the ring is broken
+    io_uring_sqe* getSqe(const UringOperation* operation) {
+        // a full sq is handed to the kernel first. the kernel never gets more operations than the cq has room for
+        // completions either, older kernels drop the ones that don't fit
+        while (!broken && *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == sq_entries)
+            submit(false);
+        while (!broken && operations >= cq_entries)
+            submit(true);
+        if (broken)
+            return nullptr;
+
+        unsigned tail = *sq_tail;
+        unsigned index = tail & sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->user_data = (uint64_t) (uintptr_t) operation;
+        sq_array[index] = index;
+
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+        operations++;
+
+        return sqe;
+    }
+
+    // moves the completions off the cq so the kernel can post more, loop handles them
+    size_t reap() {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        size_t count = tail - head;
+        for (; head != tail; head++) {
+            io_uring_cqe* cqe = &cqes[head & cq_mask];
+            completed.emplace_back((UringOperation*) (uintptr_t) cqe->user_data, cqe->res);
+            wake_armed &= completed.back().first != &wake_operation;
+        }
+
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        operations -= (unsigned) count;
+        return count;
+    }
+
+    // hands the queued sqes to the kernel, with wait until at least one more completion was taken off the cq. false
+    // once the ring is broken
+    bool submit(bool wait) {
+        size_t reaped = 0;
+        unsigned retries = 0;
+        while (!broken) {
+            bool block = wait && reaped == 0;
+            int result = uringEnter(ring_fd, to_submit, block ? 1 : 0, block ? IORING_ENTER_GETEVENTS : 0);
+            if (result >= 0)
+                to_submit -= std::min((unsigned) result, to_submit);
+            else if (errno == EBUSY || errno == EAGAIN) {
+                // the kernel takes nothing more until the cq has room, or until something it's doing frees memory.
+                // that can be waited for when there's more in flight than the eventfd read
+                size_t count = reap();
+                reaped += count;
+                if (count == 0 && operations - wake_armed > to_submit)
+                    uringEnter(ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+                else if (count == 0 && ++retries > uring_retries)
+                    breakRing("io_uring_enter keeps failing with nothing left to wait for");
+                else if (count == 0)
+                    std::this_thread::yield();
+            } else if (errno != EINTR)
+                breakRing(strerror(errno));
+
+            reaped += reap();
+            if (to_submit == 0 && (!wait || reaped > 0))
+                return true;
+        }
+
+        return false;
+    }
+
+    void breakRing(const char* reason) {
+        fprintf(stderr, "Error: io_uring failed (%s), finishing with blocking I/O\n", reason);
+        broken = true;
+    }
+
+    // redoes a request with blocking calls
+    void runBlocking(UringRequest* request) {
+        if (request->kind == UringRequest::Read)
+            request->read_done(readFile(request->path));
+        else {
+            if (!request->temp_path.empty())
+                unlink(request->temp_path.c_str());
+            request->write_done(replaceFile(request->path, request->data));
+        }
+    }
+
+    // once the ring is broken its operations can't be waited for, so the requests they belong to are redone with
+    // blocking calls. they stay allocated, the kernel could still be reading or writing their buffers. a file one
+    // already opened is closed first, the kernel holds its own reference for an operation still in flight
+    void abandon() {
+        for (UringRequest* request : live) {
+            if (request->fd >= 0) {
+                close(request->fd);
+                request->fd = -1;
+            }
+            runBlocking(request);
+            release();
+        }
+
+        live.clear();
+    }
+
+    void queue(UringRequest* request, UringRequest::Step step) {
+        UringOperation* operation = new UringOperation { request, step };
+        io_uring_sqe* sqe = getSqe(operation);
+        if (!sqe) {
+            // the request is left to abandon
+            delete operation;
+            return;
+        }
+
+        switch (step) {
+            case UringRequest::Stat:
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uint64_t) (uintptr_t) request->path.c_str();
+                sqe->len = STATX_SIZE | STATX_MODE;
+                sqe->off = (uint64_t) (uintptr_t) &request->stat_result;
+                break;
+            case UringRequest::Open:
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                if (request->kind == UringRequest::Read) {
+                    sqe->addr = (uint64_t) (uintptr_t) request->path.c_str();
+                    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                } else {
+                    sqe->addr = (uint64_t) (uintptr_t) request->temp_path.c_str();
+                    sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+                    // an existing file keeps its mode (minus the umask, which openat always applies)
+                    sqe->len = request->stat_status == 0 ? (request->stat_result.stx_mode & 07777) : 0666;
+                }
+                break;
+            case UringRequest::Transfer: {
+                size_t size = std::min(uring_chunk_size, request->data.size() - request->offset);
+                sqe->opcode = request->kind == UringRequest::Read ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe->fd = request->fd;
+                sqe->addr = (uint64_t) (uintptr_t) (request->data.data() + request->offset);
+                sqe->len = (unsigned) size;
+                sqe->off = request->offset;
+                break;
+            }
+            case UringRequest::Close:
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = request->fd;
+                // the ring closes it now, abandon mustn't close it again
+                request->fd = -1;
+                break;
+            case UringRequest::Rename:
+#if defined(IORING_OP_RENAMEAT)
+                sqe->opcode = IORING_OP_RENAMEAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uint64_t) (uintptr_t) request->temp_path.c_str();
+                sqe->len = AT_FDCWD;
+                sqe->off = (uint64_t) (uintptr_t) request->path.c_str();
+#endif
+                break;
+            case UringRequest::Wake:
+                break;
+        }
+    }
+
+    // the pid keeps concurrent runs apart, the counter the requests of this one
+    void makeTempPath(UringRequest* request) {
+        request->temp_path = request->path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(temp_counter++);
+    }
+
+    void armWake() {
+        io_uring_sqe* sqe = getSqe(&wake_operation);
+        if (!sqe)
+            return;
+
+        wake_armed = true;
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = wake_fd;
+        sqe->addr = (uint64_t) (uintptr_t) &wake_value;
+        sqe->len = sizeof(wake_value);
+    }
+
+    void start(UringRequest* request) {
+        in_flight++;
+
+        if (broken) {
+            runBlocking(request);
+            delete request;
+            return release();
+        }
+
+        live.insert(request);
+
+        if (request->kind == UringRequest::Read) {
+            // the size is needed to allocate the buffer, the open can happen at the same time
+            request->waiting = 2;
+            queue(request, UringRequest::Stat);
+            queue(request, UringRequest::Open);
+        } else {
+            std::optional<std::string> parent = getParentPath(request->path);
+            if (parent && !createDirectories(*parent))
+                return finish(request, false);
+
+            queue(request, UringRequest::Stat);
+        }
+    }
+
+    void finish(UringRequest* request, bool ok) {
+        if (request->kind == UringRequest::Read) {
+            if (ok)
+                request->read_done(std::move(request->data));
+            else
+                request->read_done(std::nullopt);
+        } else {
+            if (!ok && !request->temp_path.empty())
+                unlink(request->temp_path.c_str());
+            request->write_done(ok);
+        }
+
+        live.erase(request);
+        delete request;
+        release();
+    }
+
+    // a request has called back
+    void release() {
+        in_flight--;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        outstanding--;
+        if (outstanding == 0)
+            idle.notify_all();
+    }
+
+    void complete(UringOperation* operation, int result) {
+        UringRequest* request = operation->request;
+        UringRequest::Step step = operation->step;
+        delete operation;
+
+        switch (step) {
+            case UringRequest::Stat:
+                request->stat_status = result;
+                if (request->kind == UringRequest::Write) {
+                    // a missing target is fine, it just gets the default mode
+                    makeTempPath(request);
+                    queue(request, UringRequest::Open);
+                    return;
+                }
+                break;
+
+            case UringRequest::Open:
+                request->open_status = result;
+                if (result >= 0)
+                    request->fd = result;
+                if (request->kind == UringRequest::Write) {
+                    if (result == -EEXIST && ++request->temp_attempts < uring_temp_attempts) {
+                        makeTempPath(request);
+                        return queue(request, UringRequest::Open);
+                    }
+                    if (result < 0) {
+                        // the temp file isn't ours to remove
+                        request->temp_path.clear();
+                        return finish(request, false);
+                    }
+                    if (request->data.empty())
+                        return queue(request, UringRequest::Close);
+                    return queue(request, UringRequest::Transfer);
+                }
+                break;
+
+            case UringRequest::Transfer:
+                if (result < 0)
+                    request->failed = true;
+                else if (result == 0 && request->kind == UringRequest::Read)
+                    request->data.resize(request->offset); // the file shrank since the statx
+                else {
+                    request->offset += result;
+                    if (request->offset < request->data.size())
+                        return queue(request, UringRequest::Transfer);
+                }
+                return queue(request, UringRequest::Close);
+
+            case UringRequest::Close:
+                if (result < 0)
+                    request->failed = true;
+                if (request->kind == UringRequest::Read || request->failed)
+                    return finish(request, !request->failed);
+
+                if (!has_rename)
+                    return finish(request, rename(request->temp_path.c_str(), request->path.c_str()) == 0);
+                return queue(request, UringRequest::Rename);
+
+            case UringRequest::Rename:
+                if (result == -EINVAL || result == -EOPNOTSUPP) {
+                    // the probe lied or the filesystem doesn't support it, do it the slow way from now on
+                    has_rename = false;
+                    return finish(request, rename(request->temp_path.c_str(), request->path.c_str()) == 0);
+                }
+                return finish(request, result == 0);
+
+            case UringRequest::Wake:
+                break;
+        }
+
+        // reads wait for both the statx and the openat before reading anything
+        if (--request->waiting > 0)
+            return;
+
+        if (request->stat_status < 0 || request->open_status < 0) {
+            if (request->fd >= 0) {
+                request->failed = true;
+                return queue(request, UringRequest::Close);
+            }
+            return finish(request, false);
+        }
+
+        request->data.resize(request->stat_result.stx_size);
+        if (request->data.empty())
+            return queue(request, UringRequest::Close);
+        queue(request, UringRequest::Transfer);
+    }
+
+    void loop() {
+        armWake();
+
+        while (true) {
+            std::deque<UringRequest*> requests;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                requests.swap(incoming);
+                if (stopping && requests.empty() && in_flight == 0)
+                    break;
+            }
+
+            for (UringRequest* request : requests)
+                start(request);
+
+            // wait for at least one completion, the eventfd read completes whenever a new request comes in
+            if (!broken)
+                submit(completed.empty());
+
+            while (!completed.empty()) {
+                auto [operation, result] = completed.front();
+                completed.pop_front();
+
+                if (operation == &wake_operation)
+                    armWake();
+                else
+                    complete(operation, result);
+            }
+
+            if (broken) {
+                abandon();
+
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return !incoming.empty() || stopping; });
+            }
+        }
+    }
+
+    void push(UringRequest* request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            incoming.push_back(request);
+            outstanding++;
+        }
+        wake.notify_one();
+
+        uint64_t one = 1;
+        ::write(wake_fd, &one, sizeof(one));
+    }
+
+    public:
+    ~UringBatchIo() override {
+        if (loop_thread.joinable()) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                idle.wait(lock, [this] { return outstanding == 0; });
+                stopping = true;
+            }
+            wake.notify_one();
+
+            uint64_t one = 1;
+            ::write(wake_fd, &one, sizeof(one));
+            loop_thread.join();
+        }
+
+        if (sqe_map != MAP_FAILED)
+            munmap(sqe_map, sqe_map_size);
+        if (cq_map != MAP_FAILED && cq_map != sq_map)
+            munmap(cq_map, cq_map_size);
+        if (sq_map != MAP_FAILED)
+            munmap(sq_map, sq_map_size);
+        if (ring_fd >= 0)
+            close(ring_fd);
+        if (wake_fd >= 0)
+            close(wake_fd);
+    }
+
+    // false with error set when io_uring (or one of the operations we need) isn't available
+    bool setup(std::string& error) {
+        // errno is read right at the failing call, anything after it could overwrite it
+        auto fail = [&](const char* call) {
+            error = std::string(call) + ": " + strerror(errno);
+            return false;
+        };
+
+        io_uring_params params = {};
+        ring_fd = uringSetup(uring_entries, &params);
+        if (ring_fd < 0)
+            return fail("io_uring_setup");
+
+        sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_map)
+            sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+        sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_map == MAP_FAILED)
+            return fail("mmap");
+
+        cq_map = single_map ? sq_map : mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_map == MAP_FAILED)
+            return fail("mmap");
+
+        sqe_map_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqe_map = mmap(nullptr, sqe_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqe_map == MAP_FAILED)
+            return fail("mmap");
+
+        char* sq = (char*) sq_map;
+        sq_head = (unsigned*) (sq + params.sq_off.head);
+        sq_tail = (unsigned*) (sq + params.sq_off.tail);
+        sq_mask = *(unsigned*) (sq + params.sq_off.ring_mask);
+        sq_array = (unsigned*) (sq + params.sq_off.array);
+        sq_entries = params.sq_entries;
+        sqes = (io_uring_sqe*) sqe_map;
+
+        char* cq = (char*) cq_map;
+        cq_head = (unsigned*) (cq + params.cq_off.head);
+        cq_tail = (unsigned*) (cq + params.cq_off.tail);
+        cq_mask = *(unsigned*) (cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*) (cq + params.cq_off.cqes);
+        cq_entries = params.cq_entries;
+
+        // every opcode we use has to be supported, renameat is optional
+        constexpr unsigned probe_ops = 64;
+        std::vector<char> probe_buffer(sizeof(io_uring_probe) + probe_ops * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = (io_uring_probe*) probe_buffer.data();
+        if (uringRegister(ring_fd, IORING_REGISTER_PROBE, probe, probe_ops) < 0)
+            return fail("io_uring_register");
+
+        auto supported = [&](unsigned op) {
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        for (unsigned op : { IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE })
+            if (!supported(op)) {
+                error = "operation " + std::to_string(op) + " is unsupported";
+                return false;
+            }
+#if defined(IORING_OP_RENAMEAT)
+        has_rename = supported(IORING_OP_RENAMEAT);
+#endif
+
+        wake_fd = eventfd(0, EFD_CLOEXEC);
+        if (wake_fd < 0)
+            return fail("eventfd");
+
+        loop_thread = std::thread(&UringBatchIo::loop, this);
+        return true;
+    }
+
+    void read(const std::string& path, std::function<void(std::optional<std::string>)> done) override {
+        UringRequest* request = new UringRequest();
+        request->kind = UringRequest::Read;
+        request->path = path;
+        request->read_done = std::move(done);
+        push(request);
+    }
+
+    void write(const std::string& path, std::string data, std::function<void(bool)> done) override {
+        UringRequest* request = new UringRequest();
+        request->kind = UringRequest::Write;
+        request->path = path;
+        request->data = std::move(data);
+        request->write_done = std::move(done);
+        push(request);
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+};
+
+#endif
+
+std::unique_ptr<BatchIo> createBatchIo(bool prefer_uring, unsigned io_threads) {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    if (prefer_uring) {
+        std::unique_ptr<UringBatchIo> uring = std::make_unique<UringBatchIo>();
+        std::string error;
+        if (uring->setup(error))
+            return uring;
+
+        fprintf(stderr, "io_uring is unavailable (%s), falling back to blocking I/O threads\n", error.c_str());
+    }
+#endif
+
+    return std::make_unique<ThreadBatchIo>(io_threads);
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+// asynchronous file I/O for batch runs, so reads can be queued ahead of the formatting
+// workers and writes batched behind them. callbacks run on an I/O thread and should be quick
+class BatchIo {
+    public:
+    virtual ~BatchIo() = default;
+
+    // contents is nullopt when path couldn't be read (or doesn't exist)
+    virtual void read(const std::string& path, std::function<void(std::optional<std::string>)> done) = 0;
+    // atomically replaces path with data (see replaceFile)
+    virtual void write(const std::string& path, std::string data, std::function<void(bool)> done) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// io_uring on linux when the kernel allows it, otherwise blocking calls on a pool of io_threads
+std::unique_ptr<BatchIo> createBatchIo(bool prefer_uring, unsigned io_threads);
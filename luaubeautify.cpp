@@ -0,0 +1,229 @@
+#include "luaubeautify.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Luau/Ast.h"
+#include "Luau/Lexer.h"
+#include "Luau/ParseResult.h"
+
+#include "handle.hpp"
+
+// the allocator never frees or reuses a page, so every call adds its own. once a session's pages take up this
+// much the allocator is replaced, which bounds what a long session holds on to
+constexpr size_t session_reset_bytes = 4 * 1024 * 1024;
+
+struct luaubeautify_session {
+    HandleOptions options;
+
+    std::unique_ptr<Luau::Allocator> allocator;
+
+    std::string output;
+    bool has_output = false;
+
+    std::vector<std::string> messages; // owns the strings errors point to
+    std::vector<luaubeautify_error> errors;
+};
+
+static bool readOptions(const luaubeautify_options* options, HandleOptions& handle_options) {
+    if (options == nullptr) {
+        handle_options = HandleOptions();
+        return true;
+    }
+
+    // older callers can pass a smaller struct, anything past its end keeps the default
+    if (options->struct_size < offsetof(luaubeautify_options, minify))
+        return false;
+
+    luaubeautify_options full;
+    luaubeautify_options_init(&full);
+    memcpy(&full, options, std::min<size_t>(options->struct_size, sizeof(full)));
+
+    handle_options.minify = full.minify != 0;
+    handle_options.nosolve = full.nosolve != 0;
+    handle_options.ignore_types = full.ignore_types != 0;
+    handle_options.replace_if_expressions = full.replace_if_expressions != 0;
+    handle_options.extra1 = full.extra1 != 0;
+    return true;
+};
+
+static void resetSession(luaubeautify_session* session) {
+    session->allocator = std::make_unique<Luau::Allocator>();
+};
+
+static void addError(luaubeautify_session* session, const Luau::Location& location, std::string message) {
+    session->messages.push_back(std::move(message));
+    session->errors.push_back({ location.begin.line, location.begin.column, location.end.line, location.end.column, nullptr });
+};
+
+static luaubeautify_status copyOutput(const std::string& output, char* out, size_t out_capacity, size_t* out_size) {
+    if (out_size != nullptr)
+        *out_size = output.size();
+
+    if (output.size() > out_capacity)
+        return LUAUBEAUTIFY_BUFFER_TOO_SMALL;
+
+    if (!output.empty())
+        memcpy(out, output.data(), output.size());
+    return LUAUBEAUTIFY_OK;
+};
+
+static luaubeautify_status failInternal(luaubeautify_session* session, const char* message) {
+    session->output.clear();
+    session->has_output = false;
+    session->messages.clear();
+    session->errors.clear();
+    addError(session, Luau::Location(), message);
+
+    // whatever was being built is in an unknown state
+    resetSession(session);
+    return LUAUBEAUTIFY_INTERNAL_ERROR;
+};
+
+extern "C" {
+
+int luaubeautify_abi_version(void) {
+    return LUAUBEAUTIFY_ABI_VERSION;
+};
+
+const char* luaubeautify_status_string(luaubeautify_status status) {
+    switch (status) {
+        case LUAUBEAUTIFY_OK:
+            return "ok";
+        case LUAUBEAUTIFY_PARSE_ERROR:
+            return "parse error";
+        case LUAUBEAUTIFY_BUFFER_TOO_SMALL:
+            return "buffer too small";
+        case LUAUBEAUTIFY_INVALID_ARGUMENT:
+            return "invalid argument";
+        case LUAUBEAUTIFY_INTERNAL_ERROR:
+            return "internal error";
+    }
+
+    return "unknown status";
+};
+
+void luaubeautify_options_init(luaubeautify_options* options) {
+    if (options == nullptr)
+        return;
+
+    HandleOptions defaults;
+    options->struct_size = sizeof(luaubeautify_options);
+    options->minify = defaults.minify;
+    options->nosolve = defaults.nosolve;
+    options->ignore_types = defaults.ignore_types;
+    options->replace_if_expressions = defaults.replace_if_expressions;
+    options->extra1 = defaults.extra1;
+};
+
+luaubeautify_session* luaubeautify_session_create(const luaubeautify_options* options) {
+    try {
+        std::unique_ptr<luaubeautify_session> session = std::make_unique<luaubeautify_session>();
+        if (!readOptions(options, session->options))
+            return nullptr;
+
+        resetSession(session.get());
+        return session.release();
+    } catch (...) {
+        return nullptr;
+    }
+};
+
+void luaubeautify_session_destroy(luaubeautify_session* session) {
+    delete session;
+};
+
+luaubeautify_status luaubeautify_session_set_options(luaubeautify_session* session, const luaubeautify_options* options) {
+    if (session == nullptr)
+        return LUAUBEAUTIFY_INVALID_ARGUMENT;
+
+    HandleOptions handle_options;
+    if (!readOptions(options, handle_options))
+        return LUAUBEAUTIFY_INVALID_ARGUMENT;
+
+    session->options = handle_options;
+    return LUAUBEAUTIFY_OK;
+};
+
+luaubeautify_status luaubeautify_format(luaubeautify_session* session, const char* source, size_t source_size,
+    char* out, size_t out_capacity, size_t* out_size) {
+    if (session == nullptr || (source == nullptr && source_size > 0) || (out == nullptr && out_capacity > 0))
+        return LUAUBEAUTIFY_INVALID_ARGUMENT;
+
+    session->output.clear();
+    session->has_output = false;
+    session->messages.clear();
+    session->errors.clear();
+    if (out_size != nullptr)
+        *out_size = 0;
+
+    luaubeautify_status status = LUAUBEAUTIFY_OK;
+
+    try {
+        if (session->allocator->getPageBytes() > session_reset_bytes)
+            resetSession(session);
+
+        // the parser adds its own names to the table every time, so that one can't be shared between calls
+        Luau::AstNameTable names(*session->allocator);
+
+        const char* text = source == nullptr ? "" : source;
+        Luau::ParseResult result = parseInto(text, source_size, names, *session->allocator);
+
+        if (!result.errors.empty()) {
+            for (const Luau::ParseError& error : result.errors)
+                addError(session, error.getLocation(), error.getMessage());
+            status = LUAUBEAUTIFY_PARSE_ERROR;
+        } else {
+            formatResult(result, text, source_size, *session->allocator, session->options, nullptr, nullptr, session->output);
+            session->has_output = true;
+            status = copyOutput(session->output, out, out_capacity, out_size);
+        }
+    } catch (const std::exception& exception) {
+        status = failInternal(session, exception.what());
+    } catch (...) {
+        status = failInternal(session, "unknown exception");
+    }
+
+    // the strings can't move anymore once every error is in
+    for (size_t index = 0; index < session->errors.size(); index++)
+        session->errors[index].message = session->messages[index].c_str();
+
+    return status;
+};
+
+luaubeautify_status luaubeautify_session_output(luaubeautify_session* session, char* out, size_t out_capacity, size_t* out_size) {
+    if (session == nullptr || (out == nullptr && out_capacity > 0))
+        return LUAUBEAUTIFY_INVALID_ARGUMENT;
+
+    if (!session->has_output) {
+        if (out_size != nullptr)
+            *out_size = 0;
+        return LUAUBEAUTIFY_INVALID_ARGUMENT;
+    }
+
+    return copyOutput(session->output, out, out_capacity, out_size);
+};
+
+luaubeautify_status luaubeautify_session_output_view(const luaubeautify_session* session, const char** data, size_t* size) {
+    if (session == nullptr || data == nullptr || size == nullptr || !session->has_output)
+        return LUAUBEAUTIFY_INVALID_ARGUMENT;
+
+    *data = session->output.data();
+    *size = session->output.size();
+    return LUAUBEAUTIFY_OK;
+};
+
+size_t luaubeautify_session_error_count(const luaubeautify_session* session) {
+    return session == nullptr ? 0 : session->errors.size();
+};
+
+const luaubeautify_error* luaubeautify_session_errors(const luaubeautify_session* session) {
+    return session == nullptr || session->errors.empty() ? nullptr : session->errors.data();
+};
+
+}
@@ -0,0 +1,96 @@
+#ifndef LUAUBEAUTIFY_H
+#define LUAUBEAUTIFY_H
+
+/*
+ * C interface of libluaubeautify, for calling the beautifier from other languages without
+ * going through the CLI. nothing here prints or exits, failures come back as a status code
+ * plus error records on the session
+ *
+ * a session is not thread safe, but sessions on different threads are independent of each other
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(LUAUBEAUTIFY_BUILDING)
+#define LUAUBEAUTIFY_API __declspec(dllexport)
+#else
+#define LUAUBEAUTIFY_API
+#endif
+#else
+#define LUAUBEAUTIFY_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped whenever something below changes incompatibly */
+#define LUAUBEAUTIFY_ABI_VERSION 1
+
+typedef enum luaubeautify_status {
+    LUAUBEAUTIFY_OK = 0,
+    LUAUBEAUTIFY_PARSE_ERROR = 1,       /* the source didn't parse, see luaubeautify_session_errors */
+    LUAUBEAUTIFY_BUFFER_TOO_SMALL = 2,  /* out_size holds the size needed, the output is kept for luaubeautify_session_output */
+    LUAUBEAUTIFY_INVALID_ARGUMENT = 3,
+    LUAUBEAUTIFY_INTERNAL_ERROR = 4     /* anything else that went wrong, with a single error record */
+} luaubeautify_status;
+
+typedef struct luaubeautify_options {
+    /* set to sizeof(luaubeautify_options), so fields can be added without breaking older callers */
+    uint32_t struct_size;
+
+    int minify;
+    int nosolve;
+    int ignore_types;
+    int replace_if_expressions;
+    int extra1;
+} luaubeautify_options;
+
+/* one per parse error, lines and columns are 0-based and the end is exclusive */
+typedef struct luaubeautify_error {
+    uint32_t begin_line;
+    uint32_t begin_column;
+    uint32_t end_line;
+    uint32_t end_column;
+    const char* message;
+} luaubeautify_error;
+
+typedef struct luaubeautify_session luaubeautify_session;
+
+LUAUBEAUTIFY_API int luaubeautify_abi_version(void);
+LUAUBEAUTIFY_API const char* luaubeautify_status_string(luaubeautify_status status);
+
+/* fills options with the same defaults the CLI uses */
+LUAUBEAUTIFY_API void luaubeautify_options_init(luaubeautify_options* options);
+
+/* options can be NULL for the defaults. returns NULL when out of memory or options is invalid */
+LUAUBEAUTIFY_API luaubeautify_session* luaubeautify_session_create(const luaubeautify_options* options);
+LUAUBEAUTIFY_API void luaubeautify_session_destroy(luaubeautify_session* session);
+LUAUBEAUTIFY_API luaubeautify_status luaubeautify_session_set_options(luaubeautify_session* session, const luaubeautify_options* options);
+
+/*
+ * formats source_size bytes of source into out. out_size is always set to the full size of the
+ * output (when there is one), and the output isn't NUL terminated. out can be NULL with an
+ * out_capacity of 0 to just measure, the result can then be copied out with
+ * luaubeautify_session_output without formatting again
+ */
+LUAUBEAUTIFY_API luaubeautify_status luaubeautify_format(luaubeautify_session* session, const char* source, size_t source_size,
+    char* out, size_t out_capacity, size_t* out_size);
+
+/* copies the output of the last luaubeautify_format call */
+LUAUBEAUTIFY_API luaubeautify_status luaubeautify_session_output(luaubeautify_session* session, char* out, size_t out_capacity, size_t* out_size);
+
+/* the output of the last luaubeautify_format call without copying it, valid until the next call on the session */
+LUAUBEAUTIFY_API luaubeautify_status luaubeautify_session_output_view(const luaubeautify_session* session, const char** data, size_t* size);
+
+/* errors of the last luaubeautify_format call, valid until the next call on the session */
+LUAUBEAUTIFY_API size_t luaubeautify_session_error_count(const luaubeautify_session* session);
+LUAUBEAUTIFY_API const luaubeautify_error* luaubeautify_session_errors(const luaubeautify_session* session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,13 +1,51 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <optional>
+#include <vector>
 
 #include "FileUtils.h"
 
+#include "batch.hpp"
 #include "handle.hpp"
+#include "memory.hpp"
+#include "output.hpp"
+#include "shard.hpp"
+#include "stats.hpp"
+#include "stream.hpp"
+#include "trace.hpp"
+#include "watch.hpp"
+
+struct Options {
+    HandleOptions handle;
+
+    std::vector<char*> filepaths;
+    char* watch_dir = nullptr;
+    char* out_dir = nullptr;
+    bool in_place = false;
+    bool check = false;
+    bool stream = false;
+    StreamFraming framing = StreamFraming::Nul;
+    unsigned jobs = 0;
+    bool io_uring = false;
+    unsigned io_threads = 4;
+
+    ShardSpec shard;
+    char* shard_manifest = nullptr;
+    char* summary_path = nullptr;
+    char* timings_path = nullptr;
+    char* trace_path = nullptr;
+    bool stats = false;
+    bool memory = false;
+    double memory_warning = 0;
+};
 
 int displayHelp(char* path) {
-    printf("Usage: %s [options] [file]\n\n", path);
+    printf("Usage: %s [options] [file]\n", path);
+    printf("       %s [options] --stream [--framing nul|length]\n", path);
+    printf("       %s [options] --out-dir <dir> | --in-place | --check [files and directories]\n\n", path);
 
     printf("options:\n");
     printf("  --minify: switches output mode from beautify to minify\n");
@@ -15,44 +53,188 @@ int displayHelp(char* path) {
     printf("  --ignoretypes: omits Luau type expressions, keeping the important parts\n");
     printf("  --replaceifelseexpr: tries to replace if else expressions with statements\n");
     printf("  --extra1: tries to replace certain statements / expression using potentially dangerous methods\n");
+    printf("  --watch <dir>: re-beautifies .lua/.luau files under dir whenever they change (requires --out-dir)\n");
+    printf("  --out-dir <dir>: writes output to dir instead of stdout, mirroring the input directory structure\n");
+    printf("  --in-place: overwrites the input files with their output\n");
+    printf("  --check: writes nothing, reports the first difference in each file that isn't already formatted and fails if there are any.\n"
+           "           output is compared per top-level statement, so a file that is one do block or returned function is still printed whole first\n");
+    printf("  --stream: formats many documents from stdin, writing the results to stdout in the same framing and order\n");
+    printf("  --framing <nul|length>: how --stream documents are separated, NUL terminated (default) or prefixed by \"<size>\\n\".\n"
+           "           with nul, a document that didn't parse comes back empty like an empty one would. with length, it comes back\n"
+           "           as \"!<size>\\n\" and its parse errors\n");
+    printf("  --jobs <n>: number of worker threads (defaults to one per core)\n");
+    printf("  --io-uring: reads files ahead of the workers and writes behind them through io_uring (linux), falling back to I/O threads\n");
+    printf("  --io-threads <n>: number of I/O threads used when io_uring is unavailable (defaults to 4)\n");
+    printf("  --shard <i/n>: only processes the i-th (1-based) of n shards of the files, split by a stable hash of their relative path\n");
+    printf("  --shard-manifest <file>: size-balances the shards using the timings of a previous run instead\n");
+    printf("  --summary <file>: writes a one line JSON summary (counts, bytes, timings) of the run\n");
+    printf("  --timings <file>: writes one JSON line per file with its size and time, usable as a shard manifest\n");
+    printf("  --stats: prints JSON counters (nodes by class, solve calls, folds by rule, rewrites by pass, allocator pages, phase times, largest and slowest files) to stderr after the run\n");
+    printf("  --memory: counts heap allocations, adding the peak heap of every phase and file, name table entries and output buffer sizes to --stats (implies --stats)\n");
+    printf("  --memory-warning <n>: warns about files over 64KB whose peak heap is more than n times their size\n");
+    printf("  --trace <file>: records read, parse, fold, transform, emit and write spans of every file and thread in Chrome's trace format\n");
 
     return 0;
 };
 
-int parseArgs(int* argc, char** argv, char** filepath, bool* minify, bool* nosolve, bool* ignore_types, bool* replace_if_expressions, bool* extra1) {
-    bool found_file = false;
+// returns the value following an option, or nullptr when it is missing
+char* getOptionValue(int* i, int argc, char** argv) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Error: option '%s' expects a value\n\n", (char*) argv[*i] - 2);
+        return nullptr;
+    };
+
+    return argv[++*i];
+};
 
+int parseArgs(int* argc, char** argv, Options* options) {
     for (int i = 1; i < *argc; i++) {
         if (strncmp("--", argv[i], 2) == 0) {
             argv[i] += 2;
             if (strcmp(argv[i], "minify") == 0)
-                *minify = true;
+                options->handle.minify = true;
             else if (strcmp(argv[i], "nosolve") == 0)
-                *nosolve = true;
+                options->handle.nosolve = true;
             else if (strcmp(argv[i], "ignoretypes") == 0)
-                *ignore_types = true;
+                options->handle.ignore_types = true;
             else if (strcmp(argv[i], "replaceifelseexpr") == 0)
-                *replace_if_expressions = true;
+                options->handle.replace_if_expressions = true;
             else if (strcmp(argv[i], "extra1") == 0)
-                *extra1 = true;
-            else {
+                options->handle.extra1 = true;
+            else if (strcmp(argv[i], "watch") == 0) {
+                if (!(options->watch_dir = getOptionValue(&i, *argc, argv)))
+                    return 1;
+            } else if (strcmp(argv[i], "out-dir") == 0) {
+                if (!(options->out_dir = getOptionValue(&i, *argc, argv)))
+                    return 1;
+            } else if (strcmp(argv[i], "in-place") == 0)
+                options->in_place = true;
+            else if (strcmp(argv[i], "check") == 0)
+                options->check = true;
+            else if (strcmp(argv[i], "stream") == 0)
+                options->stream = true;
+            else if (strcmp(argv[i], "framing") == 0) {
+                char* value = getOptionValue(&i, *argc, argv);
+                if (!value)
+                    return 1;
+                if (strcmp(value, "nul") == 0)
+                    options->framing = StreamFraming::Nul;
+                else if (strcmp(value, "length") == 0)
+                    options->framing = StreamFraming::Length;
+                else {
+                    fprintf(stderr, "Error: expected --framing nul or length, got '%s'\n\n", value);
+                    return 1;
+                };
+            } else if (strcmp(argv[i], "jobs") == 0) {
+                char* value = getOptionValue(&i, *argc, argv);
+                if (!value)
+                    return 1;
+                options->jobs = (unsigned) strtoul(value, nullptr, 10);
+            } else if (strcmp(argv[i], "io-uring") == 0)
+                options->io_uring = true;
+            else if (strcmp(argv[i], "io-threads") == 0) {
+                char* value = getOptionValue(&i, *argc, argv);
+                if (!value)
+                    return 1;
+                options->io_threads = std::max(1u, (unsigned) strtoul(value, nullptr, 10));
+            } else if (strcmp(argv[i], "shard") == 0) {
+                char* value = getOptionValue(&i, *argc, argv);
+                if (!value)
+                    return 1;
+                if (!parseShardSpec(value, options->shard)) {
+                    fprintf(stderr, "Error: expected --shard i/n with 1 <= i <= n, got '%s'\n\n", value);
+                    return 1;
+                };
+            } else if (strcmp(argv[i], "shard-manifest") == 0) {
+                if (!(options->shard_manifest = getOptionValue(&i, *argc, argv)))
+                    return 1;
+            } else if (strcmp(argv[i], "summary") == 0) {
+                if (!(options->summary_path = getOptionValue(&i, *argc, argv)))
+                    return 1;
+            } else if (strcmp(argv[i], "timings") == 0) {
+                if (!(options->timings_path = getOptionValue(&i, *argc, argv)))
+                    return 1;
+            } else if (strcmp(argv[i], "stats") == 0)
+                options->stats = true;
+            else if (strcmp(argv[i], "memory") == 0) {
+                options->memory = true;
+                options->stats = true;
+            } else if (strcmp(argv[i], "memory-warning") == 0) {
+                char* value = getOptionValue(&i, *argc, argv);
+                if (!value)
+                    return 1;
+                options->memory_warning = atof(value);
+                if (options->memory_warning <= 0) {
+                    fprintf(stderr, "Error: expected a positive multiple for --memory-warning, got '%s'\n\n", value);
+                    return 1;
+                };
+            }
+            else if (strcmp(argv[i], "trace") == 0) {
+                if (!(options->trace_path = getOptionValue(&i, *argc, argv)))
+                    return 1;
+            } else {
                 fprintf(stderr, "Error: unrecognized option '%s'\n\n", (char*) argv[i] - 2);
                 return 1;
             };
-        } else {
-            if (found_file) {
-                fprintf(stderr, "Error: multiple files are not supported\n\n");
-                return 1;
-            };
+        } else
+            options->filepaths.push_back(argv[i]);
+    };
+
+    bool batch = options->out_dir || options->in_place || options->check;
+
+    if (options->filepaths.size() > 1 && (!batch || options->watch_dir)) {
+        fprintf(stderr, "Error: multiple files are only supported with --out-dir, --in-place or --check\n\n");
+        return 1;
+    };
 
-            found_file = true;
-            *filepath = argv[i];
-        };
+    if ((options->out_dir != nullptr) + options->in_place + options->check > 1) {
+        fprintf(stderr, "Error: only one of --out-dir, --in-place and --check can be used\n\n");
+        return 1;
+    };
+
+    if ((options->shard.count > 1 || options->io_uring || options->shard_manifest || options->summary_path || options->timings_path) && (!batch || options->watch_dir)) {
+        fprintf(stderr, "Error: --shard, --shard-manifest, --io-uring, --summary and --timings need --out-dir, --in-place or --check\n\n");
+        return 1;
+    };
+
+    if (options->stats && options->watch_dir) {
+        fprintf(stderr, "Error: --stats is printed once the run is over, which --watch never is\n\n");
+        return 1;
+    };
+
+    if (options->memory_warning > 0 && (options->watch_dir || options->stream)) {
+        fprintf(stderr, "Error: --memory-warning only works on files, not with --watch or --stream\n\n");
+        return 1;
+    };
+
+    if (options->watch_dir && !options->out_dir) {
+        fprintf(stderr, "Error: --watch requires --out-dir\n\n");
+        return 1;
+    };
+
+    if (options->stream && (batch || options->watch_dir || !options->filepaths.empty())) {
+        fprintf(stderr, "Error: --stream reads from stdin and can't be combined with files, --watch or the batch modes\n\n");
+        return 1;
+    };
+
+    if (!options->watch_dir && !options->stream && options->filepaths.empty()) {
+        fprintf(stderr, "Error: no file was provided\n\n");
+        return 1;
     };
 
     return 0;
 };
 
+// --stats for the modes without a batch report of their own
+void printStats(std::chrono::steady_clock::time_point start) {
+    char header[64];
+    snprintf(header, sizeof(header), "{\"wall_ms\":%.3f,", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    std::string json = header;
+    appendStatsJson(json);
+    json.append("}\n");
+    fwrite(json.data(), 1, json.size(), stderr);
+};
+
 int main(int argc, char** argv) {
     if (argc == 0) // what?
         return displayHelp((char*) "luau-beautifier");
@@ -60,26 +242,86 @@ int main(int argc, char** argv) {
     if (argc == 1)
         return displayHelp(argv[0]);
 
-    char* filepath;
-
-    bool minify = false;
-    bool nosolve = false;
-    bool ignore_types = false;
-    bool replace_if_expressions = false;
-    bool extra1 = false;
+    Options options;
 
-    if (parseArgs(&argc, argv, &filepath, &minify, &nosolve, &ignore_types, &replace_if_expressions, &extra1)) {
+    if (parseArgs(&argc, argv, &options)) {
         return displayHelp(argv[0]);
     };
 
-    std::optional<std::string> source = readFile(filepath);
+    // where /proc isn't there to read the umask from, it has to be set to be read, before any thread creates files
+    getNewFileMode();
+
+    if (options.trace_path && !startTrace(options.trace_path))
+        return 1;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    setStatsEnabled(options.stats);
+    setHeapCounting(options.memory || options.memory_warning > 0);
+
+    if (options.stream) {
+        int status = runStream(options.framing, options.handle);
+        if (options.stats)
+            printStats(start);
+        return status;
+    };
+
+    if (options.watch_dir) {
+        WatchOptions watch_options;
+        watch_options.dir = options.watch_dir;
+        watch_options.out_dir = options.out_dir;
+        watch_options.jobs = options.jobs;
+
+        return runWatch(watch_options, options.handle);
+    };
+
+    if (options.out_dir || options.in_place || options.check) {
+        BatchOptions batch_options;
+        batch_options.inputs.assign(options.filepaths.begin(), options.filepaths.end());
+        if (options.out_dir)
+            batch_options.out_dir = options.out_dir;
+        batch_options.in_place = options.in_place;
+        batch_options.check = options.check;
+        batch_options.jobs = options.jobs;
+        batch_options.async_io = options.io_uring;
+        batch_options.io_threads = options.io_threads;
+        batch_options.shard_index = options.shard.index;
+        batch_options.shard_count = options.shard.count;
+        if (options.shard_manifest)
+            batch_options.shard_manifest = options.shard_manifest;
+        if (options.summary_path)
+            batch_options.summary_path = options.summary_path;
+        if (options.timings_path)
+            batch_options.timings_path = options.timings_path;
+        batch_options.stats = options.stats;
+        batch_options.memory_warning = options.memory_warning;
+
+        return runBatch(batch_options, options.handle);
+    };
+
+    char* filepath = options.filepaths[0];
+    std::optional<std::string> source;
+    {
+        LUAU_TIMETRACE_SCOPE("read", "io");
+        StatsTimer timer(StatsPhase::Read);
+        // '-' reads the source from stdin
+        source = strcmp(filepath, "-") == 0 ? readStdin() : readFile(filepath);
+    };
 
     if (!source) {
         fprintf(stderr, "failed to read file %s\n", filepath);
         return 1;
     };
 
-    printf("%s", handleSource(source.value(), minify, nosolve, ignore_types, replace_if_expressions, extra1).c_str());
+    HandleOptions& handle = options.handle;
+    HeapScope heap;
+    printf("%s", handleSource(source.value(), handle.minify, handle.nosolve, handle.ignore_types, handle.replace_if_expressions, handle.extra1).c_str());
+    if (options.memory_warning > 0)
+        warnMemoryUse(filepath, source->size(), heap.end(), options.memory_warning);
+
+    if (options.stats) {
+        fflush(stdout);
+        printStats(start);
+    };
 
     return 0;
 }
@@ -0,0 +1,157 @@
+#include "output.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FileUtils.h"
+#include "Luau/TimeTrace.h"
+
+// outputs are compared and written in chunks of this size
+constexpr size_t output_chunk_size = 1024 * 1024;
+
+std::string relativePath(const std::string& input_root, const std::string& path) {
+    std::string relative = path;
+    if (path.compare(0, input_root.size(), input_root) == 0) {
+        relative = path.substr(input_root.size());
+        while (!relative.empty() && (relative[0] == '/' || relative[0] == '\\'))
+            relative.erase(0, 1);
+    }
+
+    return relative;
+};
+
+std::string mirrorPath(const std::string& input_root, const std::string& path, const std::string& output_root) {
+    return joinPaths(output_root, relativePath(input_root, path));
+};
+
+bool createDirectories(const std::string& path) {
+    if (path.empty() || isDirectory(path))
+        return true;
+
+    std::optional<std::string> parent = getParentPath(path);
+    if (parent && !createDirectories(*parent))
+        return false;
+
+    return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+};
+
+// true when the file at fd holds exactly data
+bool isFileEqual(int fd, size_t file_size, const std::string& data) {
+    if (file_size != data.size())
+        return false;
+
+    std::unique_ptr<char[]> buffer(new char[output_chunk_size]);
+    size_t offset = 0;
+
+    while (offset < data.size()) {
+        ssize_t length = read(fd, buffer.get(), output_chunk_size);
+        if (length <= 0)
+            return false;
+        if ((size_t) length > data.size() - offset || memcmp(buffer.get(), data.data() + offset, length) != 0)
+            return false;
+        offset += length;
+    }
+
+    char extra;
+    return read(fd, &extra, 1) == 0;
+};
+
+bool writeAll(int fd, const std::string& data) {
+    size_t offset = 0;
+
+    while (offset < data.size()) {
+        size_t size = std::min(output_chunk_size, data.size() - offset);
+        ssize_t written = write(fd, data.data() + offset, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        offset += written;
+    }
+
+    return true;
+};
+
+// umask can only be read by setting it, which would briefly give 0 to whatever other threads create meanwhile, so
+// linux's copy in /proc is read instead. elsewhere this relies on main asking before it starts any thread
+mode_t readUmask() {
+    if (FILE* status = fopen("/proc/self/status", "re")) {
+        char line[256];
+        while (fgets(line, sizeof(line), status)) {
+            if (strncmp(line, "Umask:", 6) == 0) {
+                fclose(status);
+                return (mode_t) strtoul(line + 6, nullptr, 8);
+            }
+        }
+        fclose(status);
+    }
+
+    mode_t mask = umask(0);
+    umask(mask);
+    return mask;
+};
+
+int getNewFileMode() {
+    static const int mode = 0666 & ~readUmask();
+    return mode;
+};
+
+bool replaceFile(const std::string& path, const std::string& data, int mode) {
+    if (mode < 0) {
+        struct stat st = {};
+        if (stat(path.c_str(), &st) == 0)
+            mode = st.st_mode & 07777;
+        else
+            mode = getNewFileMode();
+    }
+
+    std::optional<std::string> parent = getParentPath(path);
+    if (parent && !createDirectories(*parent))
+        return false;
+
+    // the temp file has to be in the same directory for rename to be atomic
+    std::string temp_path = path + ".tmpXXXXXX";
+    int fd = mkstemp(temp_path.data());
+    if (fd < 0)
+        return false;
+
+    // mkstemp creates the file as 0600
+    bool ok = writeAll(fd, data) && fchmod(fd, mode) == 0;
+    ok = close(fd) == 0 && ok;
+
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+};
+
+WriteResult writeOutput(const std::string& path, const std::string& data) {
+    LUAU_TIMETRACE_SCOPE("write", "io");
+
+    int mode = getNewFileMode();
+
+    int existing = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (existing >= 0) {
+        struct stat st = {};
+        bool equal = fstat(existing, &st) == 0 && isFileEqual(existing, st.st_size, data);
+        close(existing);
+
+        if (equal)
+            return WriteResult::Unchanged;
+
+        mode = st.st_mode & 07777;
+    }
+
+    return replaceFile(path, data, mode) ? WriteResult::Written : WriteResult::Failed;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+// path of a file under input_root relative to it
+std::string relativePath(const std::string& input_root, const std::string& path);
+// maps a file under input_root to the same relative location under output_root
+std::string mirrorPath(const std::string& input_root, const std::string& path, const std::string& output_root);
+
+bool createDirectories(const std::string& path);
+
+enum class WriteResult {
+    Written,
+    Unchanged,
+    Failed
+};
+
+// atomically replaces path with data (temp file + rename), creating any missing parent directories
+// when path already holds exactly data it is left untouched so its mtime doesn't change
+WriteResult writeOutput(const std::string& path, const std::string& data);
+
+// writeOutput without the comparison, mode < 0 keeps the mode of an existing file
+bool replaceFile(const std::string& path, const std::string& data, int mode = -1);
+// permissions a newly created file gets (0666 without the umask), read once. main asks before starting any thread
+int getNewFileMode();
@@ -0,0 +1,62 @@
+#include "pool.hpp"
+
+WorkerPool::WorkerPool(unsigned count) {
+    if (count == 0)
+        count = std::thread::hardware_concurrency();
+    if (count == 0)
+        count = 1;
+
+    for (unsigned i = 0; i < count; i++)
+        workers.emplace_back(&WorkerPool::work, this);
+};
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+};
+
+void WorkerPool::push(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    job_available.notify_one();
+};
+
+void WorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs_done.wait(lock, [this] { return jobs.empty() && running == 0; });
+};
+
+void WorkerPool::work() {
+    while (true) {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            if (jobs.empty() && running == 0)
+                jobs_done.notify_all();
+        }
+    }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of threads pulling jobs off a shared queue
+class WorkerPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::condition_variable jobs_done;
+
+    size_t running = 0;
+    bool stopping = false;
+
+    void work();
+
+    public:
+    // 0 means one worker per hardware thread
+    WorkerPool(unsigned count = 0);
+    ~WorkerPool();
+
+    void push(std::function<void()> job);
+    // blocks until every queued job has finished
+    void wait();
+
+    size_t size() const {
+        return workers.size();
+    }
+};
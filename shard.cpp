@@ -0,0 +1,213 @@
+#include "shard.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+#include "FileUtils.h"
+
+#include "hash.hpp"
+
+bool parseShardSpec(const char* text, ShardSpec& spec) {
+    char* end;
+    unsigned long index = strtoul(text, &end, 10);
+    if (end == text || *end != '/')
+        return false;
+
+    const char* count_text = end + 1;
+    unsigned long count = strtoul(count_text, &end, 10);
+    if (end == count_text || *end != '\0')
+        return false;
+
+    if (count == 0 || index == 0 || index > count)
+        return false;
+
+    spec.index = (unsigned) index;
+    spec.count = (unsigned) count;
+    return true;
+};
+
+uint64_t hashShardPath(const std::string& relative) {
+    // '\\' is folded to '/' so windows and unix nodes agree
+    uint64_t hash = fnv_offset_basis;
+    for (char ch : relative) {
+        char folded = ch == '\\' ? '/' : ch;
+        hash = hashDigest(hash, &folded, 1);
+    }
+    return hash;
+};
+
+void appendJsonString(std::string& out, const std::string& value) {
+    out += '"';
+    for (char ch : value) {
+        switch (ch) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                if ((unsigned char) ch < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char) ch);
+                    out.append(escape);
+                } else
+                    out += ch;
+        }
+    }
+    out += '"';
+};
+
+// finds "key": in a manifest line and returns a pointer to its value
+const char* findJsonValue(const std::string& line, const char* key) {
+    std::string needle = std::string("\"") + key + "\":";
+    size_t position = line.find(needle);
+    if (position == std::string::npos)
+        return nullptr;
+
+    return line.c_str() + position + needle.size();
+};
+
+bool readJsonString(const char* value, std::string& out) {
+    if (*value != '"')
+        return false;
+
+    for (value++; *value && *value != '"'; value++) {
+        if (*value != '\\') {
+            out += *value;
+            continue;
+        }
+
+        value++;
+        switch (*value) {
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+                // only control characters are ever escaped this way by appendJsonString
+                if (strlen(value) < 5)
+                    return false;
+                out += (char) strtoul(std::string(value + 1, 4).c_str(), nullptr, 16);
+                value += 4;
+                break;
+            case '\0':
+                return false;
+            default:
+                out += *value;
+        }
+    }
+
+    return *value == '"';
+};
+
+struct ShardCost {
+    size_t file;
+    double cost;
+};
+
+bool selectShard(std::vector<BatchFile>& files, const ShardSpec& spec, const std::string& manifest_path) {
+    std::vector<bool> keep(files.size(), false);
+
+    if (manifest_path.empty()) {
+        for (size_t i = 0; i < files.size(); i++)
+            keep[i] = hashShardPath(files[i].relative) % spec.count == spec.index - 1;
+    } else {
+        std::optional<std::string> manifest = readFile(manifest_path);
+        if (!manifest) {
+            fprintf(stderr, "failed to read file %s\n", manifest_path.c_str());
+            return false;
+        }
+
+        // relative path -> milliseconds it took last time
+        std::unordered_map<std::string, double> timings;
+        double total_ms = 0;
+        double total_bytes = 0;
+
+        size_t line_start = 0;
+        while (line_start < manifest->size()) {
+            size_t line_end = manifest->find('\n', line_start);
+            if (line_end == std::string::npos)
+                line_end = manifest->size();
+            std::string line = manifest->substr(line_start, line_end - line_start);
+            line_start = line_end + 1;
+
+            const char* path_value = findJsonValue(line, "path");
+            const char* ms_value = findJsonValue(line, "ms");
+            const char* bytes_value = findJsonValue(line, "bytes");
+            std::string path;
+            if (!path_value || !ms_value || !readJsonString(path_value, path))
+                continue;
+
+            double ms = strtod(ms_value, nullptr);
+            timings[path] = ms;
+            total_ms += ms;
+            if (bytes_value)
+                total_bytes += strtod(bytes_value, nullptr);
+        }
+
+        // files the manifest doesn't know about are estimated from their size
+        double ms_per_byte = total_bytes > 0 ? total_ms / total_bytes : 0;
+
+        std::vector<ShardCost> costs;
+        costs.reserve(files.size());
+        for (size_t i = 0; i < files.size(); i++) {
+            auto timing = timings.find(files[i].relative);
+            double cost;
+            if (timing != timings.end())
+                cost = timing->second;
+            else {
+                struct stat st = {};
+                stat(files[i].input.c_str(), &st);
+                cost = st.st_size * ms_per_byte;
+            }
+            costs.push_back({ i, cost });
+        }
+
+        // longest processing time first into the least loaded bin, every node computes the same bins
+        std::sort(costs.begin(), costs.end(), [&](const ShardCost& a, const ShardCost& b) {
+            if (a.cost != b.cost)
+                return a.cost > b.cost;
+            return files[a.file].relative < files[b.file].relative;
+        });
+
+        std::vector<double> loads(spec.count, 0);
+        for (const ShardCost& cost : costs) {
+            size_t bin = std::min_element(loads.begin(), loads.end()) - loads.begin();
+            // files that cost nothing still count, otherwise they would all pile into the first bin
+            loads[bin] += std::max(cost.cost, 1e-6);
+            keep[cost.file] = bin == spec.index - 1;
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!keep[i])
+            continue;
+        if (kept != i)
+            files[kept] = std::move(files[i]);
+        kept++;
+    }
+    files.resize(kept);
+
+    return true;
+};
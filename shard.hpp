@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+
+struct ShardSpec {
+    unsigned index = 1; // 1-based
+    unsigned count = 1;
+};
+
+// parses "i/n"
+bool parseShardSpec(const char* text, ShardSpec& spec);
+
+// stable across machines and runs, only depends on the relative path
+uint64_t hashShardPath(const std::string& relative);
+
+// keeps only the files that belong to spec
+// without a manifest files are split by hashShardPath, with one they are size-balanced using the
+// timings of a previous run (the concatenated --timings output of every shard)
+bool selectShard(std::vector<BatchFile>& files, const ShardSpec& spec, const std::string& manifest_path);
+
+void appendJsonString(std::string& out, const std::string& value);
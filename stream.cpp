@@ -0,0 +1,208 @@
+#include "stream.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+// how many documents each stage can get ahead of the next one
+constexpr size_t stream_queue_size = 256;
+constexpr size_t stream_block_size = 1 << 20;
+
+// stdout is fully buffered in blocks of this while streaming
+char stdout_buffer[stream_block_size];
+
+template<typename T>
+class StreamQueue {
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    bool closed = false;
+
+    public:
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return items.size() < stream_queue_size; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    // returns nullopt once the queue is closed and drained
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return std::nullopt;
+
+        T item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return item;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+};
+
+struct StreamDocument {
+    size_t index;
+    std::string source;
+};
+
+struct StreamParsed {
+    size_t index = 0;
+    std::unique_ptr<ParsedSource> parsed; // nullptr when parsing failed
+    std::string error;
+};
+
+struct StreamOutput {
+    size_t index = 0;
+    std::string output; // the parse errors when failed
+    bool failed = false;
+};
+
+// splits stdin into documents, returns false on a read error or a malformed length prefix
+bool readDocuments(StreamFraming framing, StreamQueue<StreamDocument>& documents) {
+    std::string pending;
+    std::unique_ptr<char[]> block(new char[stream_block_size]);
+    size_t index = 0;
+    bool eof = false;
+
+    // size of the document being read in length framing, once its header has been seen
+    std::optional<size_t> expected;
+
+    while (!eof) {
+        size_t length = fread(block.get(), 1, stream_block_size, stdin);
+        if (length < stream_block_size) {
+            if (ferror(stdin))
+                return false;
+            eof = true;
+        }
+
+        size_t start = 0;
+        if (framing == StreamFraming::Nul) {
+            while (const char* nul = (const char*) memchr(block.get() + start, '\0', length - start)) {
+                size_t end = nul - block.get();
+                pending.append(block.get() + start, end - start);
+                documents.push({ index++, std::move(pending) });
+                pending.clear();
+                start = end + 1;
+            }
+            pending.append(block.get() + start, length - start);
+        } else {
+            pending.append(block.get(), length);
+
+            while (true) {
+                if (!expected) {
+                    size_t newline = pending.find('\n', start);
+                    if (newline == std::string::npos)
+                        break;
+
+                    char* end;
+                    const char* header = pending.c_str() + start;
+                    expected = strtoull(header, &end, 10);
+                    if (end == header || end != pending.c_str() + newline) {
+                        fprintf(stderr, "Error: malformed length prefix for document %zu\n", index);
+                        return false;
+                    }
+                    start = newline + 1;
+                }
+
+                if (pending.size() - start < *expected)
+                    break;
+
+                documents.push({ index++, pending.substr(start, *expected) });
+                start += *expected;
+                expected.reset();
+            }
+
+            pending.erase(0, start);
+        }
+    }
+
+    if (framing == StreamFraming::Nul && !pending.empty())
+        documents.push({ index++, std::move(pending) });
+    else if (framing == StreamFraming::Length && (expected || !pending.empty())) {
+        fprintf(stderr, "Error: stdin ended in the middle of document %zu\n", index);
+        return false;
+    }
+
+    return true;
+};
+
+int runStream(StreamFraming framing, const HandleOptions& options) {
+    StreamQueue<StreamDocument> documents;
+    StreamQueue<StreamParsed> parsed_documents;
+    StreamQueue<StreamOutput> outputs;
+
+    bool read_ok = true;
+    size_t failed = 0; // only touched by the parse thread until it is joined
+
+    std::thread reader([&] {
+        read_ok = readDocuments(framing, documents);
+        documents.close();
+    });
+
+    std::thread parser([&] {
+        while (std::optional<StreamDocument> document = documents.pop()) {
+            std::string error;
+            std::unique_ptr<ParsedSource> parsed = parseSource(std::move(document->source), error);
+            if (!parsed) {
+                fprintf(stderr, "Parse errors were encountered in document %zu\n%s\n", document->index, error.c_str());
+                failed++;
+            }
+            parsed_documents.push({ document->index, std::move(parsed), std::move(error) });
+        }
+        parsed_documents.close();
+    });
+
+    std::thread formatter([&] {
+        while (std::optional<StreamParsed> parsed = parsed_documents.pop()) {
+            StreamOutput output;
+            output.index = parsed->index;
+            if (parsed->parsed)
+                formatParsed(*parsed->parsed, options, nullptr, nullptr, output.output);
+            else if (framing == StreamFraming::Length) {
+                output.failed = true;
+                output.output = std::move(parsed->error);
+            }
+            // the AST is freed here, on the formatting thread, instead of holding up the writer
+            parsed->parsed.reset();
+            outputs.push(std::move(output));
+        }
+        outputs.close();
+    });
+
+    setvbuf(stdout, stdout_buffer, _IOFBF, sizeof(stdout_buffer));
+
+    bool write_ok = true;
+    while (std::optional<StreamOutput> output = outputs.pop()) {
+        // a failed document is marked with a '!' before its size, and holds the parse errors instead
+        if (framing == StreamFraming::Length)
+            fprintf(stdout, output->failed ? "!%zu\n" : "%zu\n", output->output.size());
+
+        write_ok = fwrite(output->output.data(), 1, output->output.size(), stdout) == output->output.size() && write_ok;
+
+        if (framing == StreamFraming::Nul)
+            write_ok = fputc('\0', stdout) != EOF && write_ok;
+    }
+
+    reader.join();
+    parser.join();
+    formatter.join();
+
+    write_ok = fflush(stdout) == 0 && write_ok;
+
+    if (!write_ok)
+        fprintf(stderr, "Error: failed to write to stdout\n");
+
+    return read_ok && write_ok && failed == 0 ? 0 : 1;
+};
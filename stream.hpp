@@ -0,0 +1,16 @@
+#pragma once
+
+#include "handle.hpp"
+
+enum class StreamFraming {
+    Nul, // every document is terminated by a NUL byte
+    // every document is preceded by its size in decimal and a newline, "<size>\n<bytes>". on output a document
+    // that failed to parse is "!<size>\n<parse errors>"
+    Length
+};
+
+// formats every document on stdin and writes the results to stdout in the same framing and order
+// reading, parsing, formatting and writing each run on their own thread
+// a document that fails to parse is reported on stderr. with nul framing it is written back empty, which can't be
+// told apart from an empty document. length framing marks it instead
+int runStream(StreamFraming framing, const HandleOptions& options);
@@ -0,0 +1,18 @@
+#include "trace.hpp"
+
+#include <cstdio>
+
+bool startTrace(const char* path) {
+#if defined(LUAU_ENABLE_TIME_TRACE)
+    if (!Luau::TimeTrace::openTraceFile(*Luau::TimeTrace::getGlobalContext(), path)) {
+        fprintf(stderr, "failed to write file %s\n", path);
+        return false;
+    };
+
+    FFlag::DebugLuauTimeTracing.value = true;
+    return true;
+#else
+    fprintf(stderr, "Error: --trace needs a build with LUAU_ENABLE_TIME_TRACE defined\n");
+    return false;
+#endif
+};
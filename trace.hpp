@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Luau/TimeTrace.h"
+
+// --trace: records the LUAU_TIMETRACE_SCOPE spans (read, parse, fold, transforms, emit, write) of every
+// thread into path in Chrome's trace event format, for chrome://tracing or Perfetto. the spans compile
+// to nothing unless the build defines LUAU_ENABLE_TIME_TRACE, and only check a flag until this is called
+// returns false (after printing why) when the file can't be opened or tracing isn't compiled in
+bool startTrace(const char* path);
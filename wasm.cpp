@@ -0,0 +1,178 @@
+// the web assembly API used by wasm_api.js. documents are written straight into linear memory
+// buffers that are kept (and only ever grown) between calls, parsed and formatted in place, and
+// the output is read back out of the session without another copy. nothing here can exit the module,
+// parse errors come back as luaubeautify_error records
+//
+// there is a buffer and session per slot so several documents can be formatted by one call, which
+// happens on a thread pool in the pthreads build. that call only starts the batch, the browser's main
+// thread is never blocked waiting for it
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "luaubeautify.h"
+
+#if defined(__EMSCRIPTEN__)
+#include <emscripten/emscripten.h>
+#define WASM_EXPORT EMSCRIPTEN_KEEPALIVE
+#else
+#define WASM_EXPORT
+#endif
+
+#if defined(__EMSCRIPTEN_PTHREADS__)
+#include <atomic>
+
+#include "pool.hpp"
+#endif
+
+enum WasmFlags {
+    WASM_MINIFY = 1,
+    WASM_NOSOLVE = 2,
+    WASM_IGNORE_TYPES = 4,
+    WASM_REPLACE_IF_EXPRESSIONS = 8,
+    WASM_EXTRA1 = 16
+};
+
+struct WasmSlot {
+    std::vector<char> input;
+    size_t input_size = 0;
+
+    luaubeautify_session* session = nullptr;
+    luaubeautify_status status = LUAUBEAUTIFY_OK;
+
+    ~WasmSlot() {
+        luaubeautify_session_destroy(session);
+    }
+};
+
+std::vector<std::unique_ptr<WasmSlot>> wasm_slots;
+
+WasmSlot* getSlot(unsigned slot) {
+    while (wasm_slots.size() <= slot)
+        wasm_slots.push_back(std::make_unique<WasmSlot>());
+
+    WasmSlot* wasm_slot = wasm_slots[slot].get();
+    if (wasm_slot->session == nullptr)
+        wasm_slot->session = luaubeautify_session_create(nullptr);
+
+    return wasm_slot;
+};
+
+void formatSlot(WasmSlot* wasm_slot, int flags) {
+    luaubeautify_options options;
+    luaubeautify_options_init(&options);
+    options.minify = (flags & WASM_MINIFY) != 0;
+    options.nosolve = (flags & WASM_NOSOLVE) != 0;
+    options.ignore_types = (flags & WASM_IGNORE_TYPES) != 0;
+    options.replace_if_expressions = (flags & WASM_REPLACE_IF_EXPRESSIONS) != 0;
+    options.extra1 = (flags & WASM_EXTRA1) != 0;
+
+    if (wasm_slot->session == nullptr) {
+        wasm_slot->status = LUAUBEAUTIFY_INTERNAL_ERROR;
+        return;
+    }
+
+    luaubeautify_session_set_options(wasm_slot->session, &options);
+
+    // no output buffer, the output is read through luaubeautify_session_output_view instead
+    size_t size;
+    luaubeautify_status status = luaubeautify_format(wasm_slot->session, wasm_slot->input.data(), wasm_slot->input_size, nullptr, 0, &size);
+    wasm_slot->status = status == LUAUBEAUTIFY_BUFFER_TOO_SMALL ? LUAUBEAUTIFY_OK : status;
+};
+
+extern "C" {
+
+// returns a buffer of at least capacity bytes to write the document into, valid until the next call for this slot
+WASM_EXPORT char* wasm_input(unsigned slot, size_t capacity) {
+    WasmSlot* wasm_slot = getSlot(slot);
+    if (wasm_slot->input.size() < capacity)
+        wasm_slot->input.resize(std::max(capacity, wasm_slot->input.size() * 2));
+
+    return wasm_slot->input.data();
+};
+
+// how many bytes of the buffer wasm_input returned are the document
+WASM_EXPORT void wasm_set_input_size(unsigned slot, size_t size) {
+    WasmSlot* wasm_slot = getSlot(slot);
+    wasm_slot->input_size = std::min(size, wasm_slot->input.size());
+};
+
+WASM_EXPORT int wasm_format(unsigned slot, int flags) {
+    WasmSlot* wasm_slot = getSlot(slot);
+    formatSlot(wasm_slot, flags);
+    return wasm_slot->status;
+};
+
+// starts formatting slots first up to first + count and returns. once all of them are done
+// Module.onFormatAllDone(failed) is called on the main thread, until then those slots must not be touched
+WASM_EXPORT void wasm_format_all(unsigned first, unsigned count, int flags) {
+    if (count > 0)
+        getSlot(first + count - 1);
+
+    auto done = [first, count] {
+        unsigned failed = 0;
+        for (unsigned slot = first; slot < first + count; slot++)
+            failed += wasm_slots[slot]->status != LUAUBEAUTIFY_OK;
+#if defined(__EMSCRIPTEN__)
+        MAIN_THREAD_ASYNC_EM_ASM({ Module["onFormatAllDone"]($0); }, failed);
+#endif
+    };
+
+#if defined(__EMSCRIPTEN_PTHREADS__)
+    if (count == 0)
+        return done();
+
+    // the workers are started once, the pthread pool has to be big enough to create them up front.
+    // whichever job finishes last reports the batch
+    static WorkerPool pool;
+    std::shared_ptr<std::atomic<unsigned>> remaining = std::make_shared<std::atomic<unsigned>>(count);
+    for (unsigned slot = first; slot < first + count; slot++) {
+        WasmSlot* wasm_slot = wasm_slots[slot].get();
+        pool.push([wasm_slot, flags, remaining, done] {
+            formatSlot(wasm_slot, flags);
+            if (remaining->fetch_sub(1) == 1)
+                done();
+        });
+    }
+#else
+    for (unsigned slot = first; slot < first + count; slot++)
+        formatSlot(wasm_slots[slot].get(), flags);
+    done();
+#endif
+};
+
+WASM_EXPORT int wasm_status(unsigned slot) {
+    return getSlot(slot)->status;
+};
+
+WASM_EXPORT const char* wasm_output(unsigned slot) {
+    const char* data = nullptr;
+    size_t size = 0;
+    luaubeautify_session_output_view(getSlot(slot)->session, &data, &size);
+    return data;
+};
+
+WASM_EXPORT size_t wasm_output_size(unsigned slot) {
+    const char* data = nullptr;
+    size_t size = 0;
+    luaubeautify_session_output_view(getSlot(slot)->session, &data, &size);
+    return size;
+};
+
+WASM_EXPORT size_t wasm_error_count(unsigned slot) {
+    return luaubeautify_session_error_count(getSlot(slot)->session);
+};
+
+WASM_EXPORT const luaubeautify_error* wasm_errors(unsigned slot) {
+    return luaubeautify_session_errors(getSlot(slot)->session);
+};
+
+// drops the buffers and sessions of every slot from first on, after formatting something unusually big
+WASM_EXPORT void wasm_release(unsigned first) {
+    if (first < wasm_slots.size())
+        wasm_slots.resize(first);
+};
+
+}
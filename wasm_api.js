@@ -0,0 +1,117 @@
+// appended to luau-beautifier.js (--post-js), wraps the wasm_* exports of wasm.cpp.
+// text is encoded straight into the module's input buffers and decoded straight out of its output
+//
+//   Module.format(source, { minify: true }) -> { ok, output, errors: [{ line, column, endLine, endColumn, message }] }
+//   Module.formatAll([source, ...], options) -> Promise of [result, ...]  (in parallel with the pthreads build)
+(function () {
+    var encoder = new TextEncoder();
+    var decoder = new TextDecoder();
+
+    var FLAGS = {
+        minify: 1,
+        nosolve: 2,
+        ignore_types: 4,
+        replace_if_expressions: 8,
+        extra1: 16
+    };
+    var STATUS_OK = 0;
+    var ERROR_SIZE = 20; // four uint32 positions and a message pointer
+
+    function getFlags(options) {
+        var flags = 0;
+        if (options) {
+            for (var name in FLAGS) {
+                if (options[name])
+                    flags |= FLAGS[name];
+            }
+        }
+        return flags;
+    }
+
+    function decode(pointer, size) {
+        var view = HEAPU8.subarray(pointer, pointer + size);
+        // TextDecoder refuses views of a SharedArrayBuffer, which is what the pthreads build uses
+        return decoder.decode(HEAPU8.buffer instanceof ArrayBuffer ? view : view.slice());
+    }
+
+    function writeInput(slot, source) {
+        if (typeof source !== "string") {
+            // already utf-8 bytes
+            HEAPU8.set(source, _wasm_input(slot, source.length));
+            _wasm_set_input_size(slot, source.length);
+            return;
+        }
+
+        // utf-8 never needs more than 3 bytes per utf-16 code unit
+        var capacity = source.length * 3;
+        var pointer = _wasm_input(slot, capacity);
+        var written = encoder.encodeInto(source, HEAPU8.subarray(pointer, pointer + capacity)).written;
+        _wasm_set_input_size(slot, written);
+    }
+
+    function readResult(slot) {
+        if (_wasm_status(slot) === STATUS_OK)
+            return { ok: true, output: decode(_wasm_output(slot), _wasm_output_size(slot)), errors: [] };
+
+        var errors = [];
+        var count = _wasm_error_count(slot);
+        var base = _wasm_errors(slot);
+        for (var i = 0; i < count; i++) {
+            var words = (base + i * ERROR_SIZE) >> 2;
+            var message = HEAPU32[words + 4];
+            errors.push({
+                line: HEAPU32[words],
+                column: HEAPU32[words + 1],
+                endLine: HEAPU32[words + 2],
+                endColumn: HEAPU32[words + 3],
+                message: decode(message, HEAPU8.indexOf(0, message) - message)
+            });
+        }
+        return { ok: false, output: null, errors: errors };
+    }
+
+    Module["format"] = function (source, options) {
+        writeInput(0, source);
+        _wasm_format(0, getFlags(options));
+        return readResult(0);
+    };
+
+    // batches use slots 1 and up, so Module.format (slot 0) can run while one is in progress.
+    // they run one after another, batch is the end of the last one queued
+    var batch = Promise.resolve();
+    var batchDone = null;
+
+    Module["onFormatAllDone"] = function () {
+        var done = batchDone;
+        batchDone = null;
+        done();
+    };
+
+    Module["formatAll"] = function (sources, options) {
+        var run = batch.then(function () {
+            return new Promise(function (resolve) {
+                for (var i = 0; i < sources.length; i++)
+                    writeInput(i + 1, sources[i]);
+
+                batchDone = function () {
+                    var results = [];
+                    for (var i = 0; i < sources.length; i++)
+                        results.push(readResult(i + 1));
+                    resolve(results);
+                };
+                // without pthreads this formats everything and calls onFormatAllDone before returning
+                _wasm_format_all(1, sources.length, getFlags(options));
+            });
+        });
+        batch = run.catch(function () {});
+        return run;
+    };
+
+    // frees the buffers kept around for slot and up, e.g. after formatting a very large paste.
+    // waits for the batches queued so far, their slots are still in use
+    Module["release"] = function (slot) {
+        batch = batch.then(function () {
+            _wasm_release(slot || 0);
+        });
+    };
+})();
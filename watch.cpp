@@ -0,0 +1,231 @@
+#include "watch.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "FileUtils.h"
+
+#include "cache.hpp"
+#include "output.hpp"
+#include "pool.hpp"
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#if !defined(__linux__)
+int runWatch(const WatchOptions& watch_options, const HandleOptions& options) {
+    fprintf(stderr, "Error: --watch is only supported on linux\n");
+    return 1;
+};
+#else
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+std::string getRealPath(const std::string& path) {
+    char buffer[PATH_MAX];
+    if (!realpath(path.c_str(), buffer))
+        return path;
+
+    return buffer;
+};
+
+struct Watcher {
+    int fd = -1;
+    std::string root;
+    std::string out_dir;
+    std::unordered_map<int, std::string> directories; // watch descriptor -> directory
+
+    // adds a watch to dir and every directory below it; files that already exist
+    // below a directory that appeared after startup are handed to on_file
+    void addDirectory(const std::string& dir, std::unordered_map<std::string, Clock::time_point>* on_file, Clock::time_point when) {
+        if (dir == out_dir)
+            return;
+
+        int wd = inotify_add_watch(fd, dir.c_str(), watch_mask);
+        if (wd < 0) {
+            fprintf(stderr, "failed to watch %s: %s\n", dir.c_str(), strerror(errno));
+            return;
+        }
+        directories[wd] = dir;
+
+        DIR* handle = opendir(dir.c_str());
+        if (!handle)
+            return;
+
+        while (dirent* entry = readdir(handle)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            std::string path = joinPaths(dir, entry->d_name);
+            if (isDirectory(path))
+                addDirectory(path, on_file, when);
+            else if (on_file && hasSourceExtension(path))
+                (*on_file)[path] = when;
+        }
+
+        closedir(handle);
+    };
+};
+
+int runWatch(const WatchOptions& watch_options, const HandleOptions& options) {
+    if (!createDirectories(watch_options.out_dir)) {
+        fprintf(stderr, "Error: failed to create %s\n", watch_options.out_dir.c_str());
+        return 1;
+    }
+
+    Watcher watcher;
+    watcher.root = getRealPath(watch_options.dir);
+    watcher.out_dir = getRealPath(watch_options.out_dir);
+
+    if (!isDirectory(watcher.root)) {
+        fprintf(stderr, "Error: %s is not a directory\n", watch_options.dir.c_str());
+        return 1;
+    }
+
+    watcher.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher.fd < 0) {
+        fprintf(stderr, "Error: failed to initialize inotify: %s\n", strerror(errno));
+        return 1;
+    }
+
+    watcher.addDirectory(watcher.root, nullptr, Clock::now());
+
+    // unchanged functions and statements are reused between runs on the same file
+    setIncremental(true);
+
+    WorkerPool pool(watch_options.jobs);
+    std::mutex in_flight_mutex;
+    std::unordered_set<std::string> in_flight;
+
+    auto debounce = std::chrono::milliseconds(watch_options.debounce_ms);
+    // path -> time to format it at; pushed back by every new event on the same path
+    std::unordered_map<std::string, Clock::time_point> pending;
+
+    auto format = [&](const std::string& path) {
+        std::string output_path = mirrorPath(watcher.root, path, watcher.out_dir);
+
+        std::optional<std::string> source = readFile(path);
+        if (!source)
+            fprintf(stderr, "failed to read file %s\n", path.c_str());
+        else {
+            std::string result;
+            std::string error;
+            if (!handleSource(*source, options, result, error))
+                fprintf(stderr, "Parse errors were encountered in %s\n%s\n", path.c_str(), error.c_str());
+            else {
+                switch (writeOutput(output_path, result)) {
+                    case WriteResult::Written:
+                        fprintf(stderr, "formatted %s\n", path.c_str());
+                        break;
+                    case WriteResult::Unchanged:
+                        fprintf(stderr, "unchanged %s\n", path.c_str());
+                        break;
+                    case WriteResult::Failed:
+                        fprintf(stderr, "failed to write file %s\n", output_path.c_str());
+                        break;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(in_flight_mutex);
+        in_flight.erase(path);
+    };
+
+    fprintf(stderr, "watching %s\n", watcher.root.c_str());
+
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (true) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            Clock::time_point next = Clock::time_point::max();
+            for (auto& [path, when] : pending)
+                next = std::min(next, when);
+
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count();
+            timeout = wait < 0 ? 0 : (int) wait + 1;
+        }
+
+        pollfd poll_fd = { watcher.fd, POLLIN, 0 };
+        int ready = poll(&poll_fd, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            fprintf(stderr, "Error: poll failed: %s\n", strerror(errno));
+            return 1;
+        }
+
+        Clock::time_point now = Clock::now();
+
+        while (ready > 0) {
+            ssize_t length = read(watcher.fd, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;
+
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                inotify_event* event = reinterpret_cast<inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // the kernel dropped events, the only way to not miss a change is to look at everything again
+                    fprintf(stderr, "warning: inotify queue overflowed, rescanning %s\n", watcher.root.c_str());
+                    for (auto& [wd, dir] : watcher.directories)
+                        inotify_rm_watch(watcher.fd, wd);
+                    watcher.directories.clear();
+                    watcher.addDirectory(watcher.root, &pending, now + debounce);
+                    continue;
+                }
+
+                if (event->mask & IN_IGNORED) {
+                    watcher.directories.erase(event->wd);
+                    continue;
+                }
+
+                auto dir = watcher.directories.find(event->wd);
+                if (dir == watcher.directories.end() || event->len == 0)
+                    continue;
+
+                std::string path = joinPaths(dir->second, event->name);
+
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                        watcher.addDirectory(path, &pending, now + debounce);
+                } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && hasSourceExtension(path))
+                    pending[path] = now + debounce;
+            }
+        }
+
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->second > now) {
+                it++;
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(in_flight_mutex);
+                if (!in_flight.insert(it->first).second) {
+                    // still formatting the previous version, try again once the debounce passes
+                    it->second = now + debounce;
+                    it++;
+                    continue;
+                }
+            }
+
+            std::string path = it->first;
+            pool.push([&format, path] { format(path); });
+            it = pending.erase(it);
+        }
+    }
+};
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "handle.hpp"
+
+struct WatchOptions {
+    std::string dir;
+    std::string out_dir;
+    unsigned jobs = 0;
+    int debounce_ms = 100;
+};
+
+// re-beautifies source files under dir into the mirrored out_dir whenever they change
+// runs until interrupted; only supported on linux (inotify)
+int runWatch(const WatchOptions& watch_options, const HandleOptions& options);